@@ -0,0 +1,80 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/assign.h"
+
+using namespace std;
+
+/*
+    Assignment kernel benchmark
+
+    Runs one assignment sweep with every SIMD level supported by this CPU, for SoA and AoS
+    data, and checks that the labels are identical to the scalar path.
+
+    Usage: bench_assign <num_points> <num_clusters> <dims> <repetitions>
+*/
+
+static double sweep(const DatasetView& data, const CentroidTable& table, int* labels, int reps) {
+    double start = omp_get_wtime();
+    for (int r = 0; r < reps; r++) {
+        for (long long int i = 0; i < data.numPoints; i++) labels[i] = -1;
+        assign_block(data, 0, data.numPoints, table, labels);
+    }
+    return (omp_get_wtime() - start) / reps;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <repetitions>\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int reps = atoi(argv[4]);
+
+    srand(1);
+    double* centroids = new double[k * dims];
+    for (int j = 0; j < k * dims; j++) centroids[j] = rand() / (double)RAND_MAX;
+    CentroidTable table(k, dims);
+    table.load(centroids);
+
+    int* reference = new int[n];
+    int* labels = new int[n];
+    const SimdLevel supported = detect_simd_level();
+    cout << "Detected: " << simd_level_name(supported) << "\n";
+
+    Layout layouts[2] = {LAYOUT_SOA, LAYOUT_AOS};
+    string names[2] = {"SoA", "AoS"};
+    bool ok = true;
+    for (int l = 0; l < 2; l++) {
+        Dataset data(n, dims, layouts[l]);
+        for (long long int i = 0; i < n; i++) {
+            for (int d = 0; d < dims; d++) data.at(i, d) = rand() / (double)RAND_MAX;
+        }
+
+        double scalarTime = 0.0;
+        for (int level = SIMD_SCALAR; level <= supported; level++) {
+            set_simd_level((SimdLevel)level);
+            double t = sweep(data, table, level == SIMD_SCALAR ? reference : labels, reps);
+            if (level == SIMD_SCALAR) scalarTime = t;
+
+            long long int mismatches = 0;
+            if (level != SIMD_SCALAR) {
+                for (long long int i = 0; i < n; i++) mismatches += labels[i] != reference[i];
+            }
+            ok = ok && mismatches == 0;
+            cout << names[l] << " " << simd_level_name((SimdLevel)level) << ": " << t << " s ("
+                 << scalarTime / t << "x), label mismatches: " << mismatches << "\n";
+        }
+    }
+    set_simd_level(supported);
+
+    delete[] labels;
+    delete[] reference;
+    delete[] centroids;
+    return ok ? 0 : 1;
+}
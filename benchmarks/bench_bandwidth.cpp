@@ -0,0 +1,104 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+
+using namespace std;
+
+/*
+    Bandwidth benchmark of one Lloyd iteration
+
+    Runs the same iterations (same starting centroids) with the two-pass step, an assignment
+    sweep followed by update_centroids_paralelo, and with the fused step lloyd_step_fused.
+    Reports time per iteration, the bytes of the data set and labels each step streams per
+    iteration and the resulting effective bandwidth. The data set should be much larger than
+    the last level cache, otherwise both steps run out of cache.
+        two-pass: coordinates twice, labels read + written, labels read again
+        fused:    coordinates once, labels read + written
+    Both steps must end with the same labels.
+
+    Usage: bench_bandwidth <num_points> <num_clusters> <dims> [iterations]
+*/
+
+template <int D>
+static void run(const DatasetView& data, int k, int iterations, const double* start, int* labels, bool fused,
+                double& seconds) {
+    const int dims = data.dims;
+    const long long int numPoints = data.numPoints;
+    double* centroids = new double[dims * k];
+    ReductionWorkspace workspace(k, dims);
+    memcpy(centroids, start, sizeof(double) * dims * k);
+    for (long long int i = 0; i < numPoints; i++) labels[i] = -1;
+    CentroidTable table(k, dims);
+
+    double begin = omp_get_wtime();
+    for (int it = 0; it < iterations; it++) {
+        table.load(centroids);
+        if (fused) {
+            lloyd_step_fused<D>(data, table, labels, centroids, workspace);
+            continue;
+        }
+        const long long int numBlocks = (numPoints + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+        #pragma omp parallel for schedule(static)
+        for (long long int b = 0; b < numBlocks; b++) {
+            long long int first = b * ASSIGN_BLOCK;
+            long long int last = first + ASSIGN_BLOCK < numPoints ? first + ASSIGN_BLOCK : numPoints;
+            assign_block<D>(data, first, last, table, labels);
+        }
+        update_centroids_paralelo<D>(data, labels, centroids, workspace);
+    }
+    seconds = (omp_get_wtime() - begin) / iterations;
+
+    delete[] centroids;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> [iterations]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int iterations = argc > 4 ? atoi(argv[4]) : 10;
+
+    srand(1);
+    Dataset data(n, dims, LAYOUT_SOA);
+    for (long long int i = 0; i < n; i++) {
+        for (int d = 0; d < dims; d++) data.at(i, d) = rand() / (double)RAND_MAX;
+    }
+    double* start = new double[dims * k];
+    for (int j = 0; j < k * dims; j++) start[j] = rand() / (double)RAND_MAX;
+
+    int* twoPassLabels = new int[n];
+    int* fusedLabels = new int[n];
+    double twoPassTime = 0.0, fusedTime = 0.0;
+    dispatch_dims(dims, [&](auto dim) {
+        run<decltype(dim)::value>(data, k, iterations, start, twoPassLabels, false, twoPassTime);
+        run<decltype(dim)::value>(data, k, iterations, start, fusedLabels, true, fusedTime);
+    });
+
+    long long int mismatches = 0;
+    for (long long int i = 0; i < n; i++) mismatches += twoPassLabels[i] != fusedLabels[i];
+
+    const double coordinateBytes = (double)n * dims * sizeof(double);
+    const double labelBytes = (double)n * sizeof(int);
+    const double twoPassBytes = 2.0 * coordinateBytes + 3.0 * labelBytes;
+    const double fusedBytes = coordinateBytes + 2.0 * labelBytes;
+
+    cout << "Threads: " << omp_get_max_threads() << ", data set: " << coordinateBytes / 1e6 << " MB\n";
+    cout << "Step,SecondsPerIteration,MBPerIteration,GBPerSecond\n";
+    cout << "two-pass," << twoPassTime << "," << twoPassBytes / 1e6 << "," << twoPassBytes / twoPassTime / 1e9 << "\n";
+    cout << "fused," << fusedTime << "," << fusedBytes / 1e6 << "," << fusedBytes / fusedTime / 1e9 << "\n";
+    cout << "Speedup: " << twoPassTime / fusedTime << "x, bytes per iteration: " << fusedBytes / twoPassBytes
+         << "x, label mismatches: " << mismatches << "\n";
+
+    delete[] fusedLabels;
+    delete[] twoPassLabels;
+    delete[] start;
+    return mismatches == 0 ? 0 : 1;
+}
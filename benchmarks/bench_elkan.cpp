@@ -0,0 +1,73 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/elkan.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Elkan benchmark
+
+    Runs kmeans_paralelo (Lloyd) and kmeans_elkan from the same seed on Gaussian blobs,
+    reports both times, the label mismatches between them and the fraction of distance
+    computations Elkan skipped on every iteration.
+    With one thread both engines sum the centroid updates in the same order, so the labels
+    must match exactly (the exit status is nonzero otherwise). With more threads the partial
+    sums of the late, incremental updates are split among the threads by Elkan's per-point
+    schedule, so rounding can flip near ties: mismatches are reported but not an error.
+
+    Usage: bench_elkan <num_points> <num_clusters> <dims> <max_iterations> [seed]
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations> [seed]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+    const int seed = argc > 5 ? atoi(argv[5]) : 1;
+
+    // k blobs with centers in [0, 10)^dims
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, seed);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+
+    int* lloydLabels = new int[n];
+    int* elkanLabels = new int[n];
+    for (long long int i = 0; i < n; i++) lloydLabels[i] = elkanLabels[i] = -1;
+
+    srand(seed);
+    double start = omp_get_wtime();
+    kmeans_paralelo(data, k, maxIterations, lloydLabels);
+    double lloydTime = omp_get_wtime() - start;
+
+    srand(seed);
+    PruningStats stats;
+    start = omp_get_wtime();
+    kmeans_elkan(data, k, maxIterations, elkanLabels, &stats);
+    double elkanTime = omp_get_wtime() - start;
+
+    long long int mismatches = 0;
+    for (long long int i = 0; i < n; i++) mismatches += lloydLabels[i] != elkanLabels[i];
+
+    cout << "Threads: " << omp_get_max_threads() << ", iterations: " << stats.iterations << "\n";
+    cout << "Lloyd: " << lloydTime << " s\n";
+    cout << "Elkan: " << elkanTime << " s (" << lloydTime / elkanTime << "x), label mismatches: " << mismatches << "\n";
+    cout << "Skipped distance computations per iteration:\n";
+    for (size_t it = 0; it < stats.skippedFraction.size(); it++) {
+        cout << "  " << it + 1 << ": " << 100.0 * stats.skippedFraction[it] << " %\n";
+    }
+    cout << "Mean skipped: " << 100.0 * stats.meanSkipped() << " %\n";
+
+    delete[] elkanLabels;
+    delete[] lloydLabels;
+    return mismatches == 0 || omp_get_max_threads() > 1 ? 0 : 1;
+}
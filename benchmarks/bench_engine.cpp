@@ -0,0 +1,111 @@
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/engine.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Engine benchmark
+
+    Many small fits of the same shape, the workload of a service that clusters a new batch
+    thousands of times a minute: kmeans_paralelo (every call allocates its centroids,
+    workspaces and initialization buffers) against one KMeans engine reused for every fit.
+    Reports the time per fit, fits per second and the heap allocations per fit, counted with a
+    replaced operator new (std::vector and new[]) plus the buffers the engine reports
+    (aligned_malloc). After the first fit the engine must not allocate, and with the same seed
+    both must produce the same labels.
+
+    Usage: bench_engine <num_points> <num_clusters> <dims> <fits>
+*/
+
+static atomic<long long int> heapAllocations(0);
+
+void* operator new(size_t bytes) {
+    heapAllocations++;
+    void* ptr = malloc(bytes == 0 ? 1 : bytes);
+    if (ptr == nullptr) throw bad_alloc();
+    return ptr;
+}
+
+// GCC flags free() in a replaced operator delete as a mismatch with new
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <fits>\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int fits = atoi(argv[4]);
+
+    // A batch of k blobs with centers in [0, 10)^dims
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, 1);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+    const int maxIterations = 300;
+
+    // Free function: fresh buffers on every call
+    vector<int> labels(n);
+    srand(7);
+    const uint64_t seed = (uint64_t)rand();
+    long long int before = heapAllocations;
+    double start = omp_get_wtime();
+    for (int f = 0; f < fits; f++) {
+        for (long long int i = 0; i < n; i++) labels[i] = -1;
+        srand(7);
+        kmeans_paralelo(data, k, maxIterations, labels.data());
+    }
+    const double functionTime = (omp_get_wtime() - start) / fits;
+    const double functionAllocations = (double)(heapAllocations - before) / fits;
+
+    // Engine: the first fit sizes the buffers, the rest reuse them
+    KMeansOptions options;
+    options.k = k;
+    options.maxIterations = maxIterations;
+    options.seed = seed;
+    KMeans engine(options);
+    vector<int> engineLabels(n);
+    before = heapAllocations;
+    engine.fit(data.view(), engineLabels.data());
+    const long long int firstAllocations = heapAllocations - before + engine.result().allocations;
+
+    long long int repeatedAllocations = 0;
+    before = heapAllocations;
+    start = omp_get_wtime();
+    for (int f = 0; f < fits; f++) {
+        engine.fit(data.view(), engineLabels.data());
+        repeatedAllocations += engine.result().allocations;
+    }
+    const double engineTime = (omp_get_wtime() - start) / fits;
+    repeatedAllocations += heapAllocations - before;
+
+    const KMeansResult& result = engine.result();
+    const bool same = engineLabels == labels;
+    cout << "Threads: " << omp_get_max_threads() << ", " << n << " points, k = " << k << ", " << dims
+         << " dimensions, " << result.iterations << " iterations per fit, inertia " << result.inertia << "\n";
+    cout << "Mode,TimePerFit,FitsPerSecond,AllocationsPerFit\n";
+    cout << "kmeans_paralelo," << functionTime << "," << 1.0 / functionTime << "," << functionAllocations << "\n";
+    cout << "engine first fit,,," << firstAllocations << "\n";
+    cout << "engine," << engineTime << "," << 1.0 / engineTime << "," << (double)repeatedAllocations / fits << "\n";
+    cout << "Same labels: " << (same ? "yes" : "no") << "\n";
+    return same && repeatedAllocations == 0 ? 0 : 1;
+}
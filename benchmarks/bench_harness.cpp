@@ -0,0 +1,546 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/csv.h"
+#include "../kmeans/input.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/elkan.h"
+#include "../kmeans/yinyang.h"
+#include "../kmeans/kdtree.h"
+#include "../kmeans/minibatch.h"
+#include "../kmeans/reorder.h"
+#include "../kmeans/perf.h"
+#include "../kmeans/numa.h"
+
+using namespace std;
+
+/*
+    Benchmark harness
+
+    Replaces the hand-written experiment loop of kmeans_final.cpp. Reads a matrix of data sizes,
+    thread counts, values of k and engines from a config file (see harness.conf) and, for every
+    combination, does the warm-up runs and then the measured repetitions, each one with fresh
+    labels (-1) and srand(seed), so every repetition clusters from the same initial centroids.
+    The serial Lloyd engine is the baseline of every size and k.
+
+    Phases of a repetition:
+        load     opening data/N_data (mapped .bin or parsed .csv), repeated like the runs
+        init     centroid initialization, timed by running the engine's initializer from the
+                 same seed (plus the tree build for kdtree; 0 for minibatch, which seeds from
+                 its own sample inside the run)
+        iterate  time of the engine call minus its initialization
+        write    save_results of all the points and labels to <output>_results.csv
+    The run time (init + iterate) is what SerialTime / ParallelTime report.
+
+    For every configuration the median, 95th percentile (nearest rank) and standard deviation of
+    the run time and the median of every phase are written to <output>.csv, whose first five
+    columns are the output/speedups.csv schema (serial rows have NumThreads = 0), and to
+    <output>.json together with every sample. When the data set comes from tools/generate_data
+    (data/N_data_labels.bin or .csv next to it) the adjusted Rand index of the final labels
+    against the ground truth blobs is reported too (noise points excluded).
+
+    Built with -DKMEANS_PERF, the serial and lloyd rows also get the hardware counters of the
+    assign and accumulate phases (see kmeans/perf.h) per repetition, summed over threads, with
+    the derived IPC and bytes per point (LLC misses times the line size per point visited). The
+    columns stay empty, and the JSON says why, when the counters are unavailable.
+
+    With affinity = compact or scatter the threads of every configuration are pinned (see
+    kmeans/numa.h) and the data set is copied with the parallel first touch of that thread
+    count before its runs, outside the timings, so the pages sit on the nodes of the threads
+    that sweep them and the reduction is done per node.
+
+    Usage: bench_harness [config file (benchmarks/harness.conf)]   (from the repository root)
+*/
+
+struct HarnessConfig {
+    vector<long long int> sizes = {100000};
+    vector<string> threads = {"max"};
+    vector<int> ks = {5};
+    vector<string> algorithms = {"lloyd"};
+    string initName = "kmeans||";
+    InitMethod init = INIT_KMEANS_PARALLEL;
+    string curveName = "none";
+    SpatialCurve curve = CURVE_NONE;
+    string affinityName = "none";
+    ThreadAffinity affinity = AFFINITY_NONE;
+    int maxIterations = 100;
+    int seed = 1;
+    int warmup = 1;
+    int repetitions = 10;
+    string output = "output/benchmark";
+};
+
+static bool read_config(const string& file_name, HarnessConfig& config) {
+    ifstream in(file_name);
+    if (!in.is_open()) {
+        cerr << "Couldn't open config file: " << file_name << "\n";
+        return false;
+    }
+    string line;
+    int lineNumber = 0;
+    while (getline(in, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        size_t equals = line.find('=');
+        istringstream keyStream(line.substr(0, equals));
+        string key;
+        if (!(keyStream >> key)) continue;
+        if (equals == string::npos) {
+            cerr << file_name << ":" << lineNumber << ": expected key = value\n";
+            return false;
+        }
+        istringstream values(line.substr(equals + 1));
+        vector<string> tokens;
+        for (string token; values >> token;) tokens.push_back(token);
+        if (tokens.empty()) {
+            cerr << file_name << ":" << lineNumber << ": no value for " << key << "\n";
+            return false;
+        }
+
+        if (key == "sizes") {
+            config.sizes.clear();
+            for (const string& t : tokens) config.sizes.push_back(atoll(t.c_str()));
+        } else if (key == "threads") {
+            config.threads = tokens;
+        } else if (key == "k") {
+            config.ks.clear();
+            for (const string& t : tokens) config.ks.push_back(atoi(t.c_str()));
+        } else if (key == "algorithms") {
+            config.algorithms = tokens;
+        } else if (key == "init") {
+            config.initName = tokens[0];
+            if (!parse_init_method(tokens[0], config.init)) {
+                cerr << file_name << ":" << lineNumber << ": unknown initialization " << tokens[0] << "\n";
+                return false;
+            }
+        } else if (key == "curve") {
+            config.curveName = tokens[0];
+            if (!parse_spatial_curve(tokens[0], config.curve)) {
+                cerr << file_name << ":" << lineNumber << ": unknown curve " << tokens[0] << "\n";
+                return false;
+            }
+        } else if (key == "affinity") {
+            config.affinityName = tokens[0];
+            if (!parse_thread_affinity(tokens[0], config.affinity)) {
+                cerr << file_name << ":" << lineNumber << ": unknown affinity " << tokens[0] << "\n";
+                return false;
+            }
+        } else if (key == "max_iterations") {
+            config.maxIterations = atoi(tokens[0].c_str());
+        } else if (key == "seed") {
+            config.seed = atoi(tokens[0].c_str());
+        } else if (key == "warmup") {
+            config.warmup = atoi(tokens[0].c_str());
+        } else if (key == "repetitions") {
+            config.repetitions = atoi(tokens[0].c_str());
+        } else if (key == "output") {
+            config.output = tokens[0];
+        } else {
+            cerr << file_name << ":" << lineNumber << ": unknown key " << key << "\n";
+            return false;
+        }
+    }
+
+    for (const string& a : config.algorithms) {
+        if (a != "lloyd" && a != "elkan" && a != "yinyang" && a != "kdtree" && a != "minibatch") {
+            cerr << "Unknown algorithm: " << a << "\n";
+            return false;
+        }
+    }
+    if (config.repetitions < 1) config.repetitions = 1;
+    return true;
+}
+
+// Thread count of a "threads" entry: a number, half, max or double
+static int thread_count(const string& name) {
+    const int maxThreads = omp_get_max_threads();
+    if (name == "max") return maxThreads;
+    if (name == "half") return maxThreads / 2 > 0 ? maxThreads / 2 : 1;
+    if (name == "double") return 2 * maxThreads;
+    return atoi(name.c_str());
+}
+
+struct Summary {
+    double median = 0.0, p95 = 0.0, stddev = 0.0, min = 0.0, max = 0.0;
+};
+
+static Summary summarize(vector<double> samples) {
+    Summary s;
+    if (samples.empty()) return s;
+    sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    s.median = n % 2 == 1 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    s.p95 = samples[(size_t)ceil(0.95 * n) - 1];
+    s.min = samples.front();
+    s.max = samples.back();
+    double mean = 0.0;
+    for (double x : samples) mean += x;
+    mean /= n;
+    double squares = 0.0;
+    for (double x : samples) squares += (x - mean) * (x - mean);
+    s.stddev = n > 1 ? sqrt(squares / (n - 1)) : 0.0;
+    return s;
+}
+
+// Timings of the repetitions of one configuration
+struct Measurement {
+    string algorithm;
+    long long int size = 0;
+    int dims = 0;
+    int threads = 0;
+    int k = 0;
+    vector<double> load, init, iterate, write, run;
+    double inertia = 0.0;
+    // Adjusted Rand index against the ground truth, NAN without one
+    double ari = NAN;
+    // Hardware counters per repetition (built with -DKMEANS_PERF)
+    bool counted = false;
+    string counterNote = "built without KMEANS_PERF";
+    PerfValues counters[PERF_PHASES];
+    double pointsVisited = 0.0;
+};
+
+// Sum of squared distances from every point to the mean of its cluster
+static double labels_inertia(const DatasetView& data, int k, const int* labels) {
+    const int dims = data.dims;
+    vector<double> means(k * dims, 0.0);
+    vector<long long int> sizes(k, 0);
+    for (long long int i = 0; i < data.numPoints; i++) {
+        sizes[labels[i]]++;
+        for (int d = 0; d < dims; d++) means[labels[i] * dims + d] += data.at(i, d);
+    }
+    for (int j = 0; j < k; j++) {
+        for (int d = 0; d < dims; d++) means[j * dims + d] /= sizes[j] > 0 ? sizes[j] : 1;
+    }
+    double total = 0.0;
+    #pragma omp parallel for reduction(+:total) schedule(static)
+    for (long long int i = 0; i < data.numPoints; i++) {
+        for (int d = 0; d < dims; d++) {
+            double diff = data.at(i, d) - means[labels[i] * dims + d];
+            total += diff * diff;
+        }
+    }
+    return total;
+}
+
+/*
+    Ground truth labels of the first numPoints points written by tools/generate_data, from
+    base_labels.bin (raw 32-bit integers) or base_labels.csv. Empty when there is none.
+*/
+static vector<int> read_ground_truth(const string& base_name, long long int numPoints) {
+    vector<int> truth;
+    ifstream binary(base_name + "_labels.bin", ios::binary);
+    if (binary.is_open()) {
+        truth.resize(numPoints);
+        binary.read((char*)truth.data(), sizeof(int) * numPoints);
+        if (binary.gcount() != (streamsize)(sizeof(int) * numPoints)) truth.clear();
+        return truth;
+    }
+    ifstream text(base_name + "_labels.csv");
+    for (int label; (long long int)truth.size() < numPoints && text >> label;) truth.push_back(label);
+    if ((long long int)truth.size() < numPoints) truth.clear();
+    return truth;
+}
+
+/*
+    Adjusted Rand index between the labels (in data order, position maps file order to it) and
+    the ground truth (file order), skipping points whose true label is negative (noise).
+*/
+static double adjusted_rand_index(const vector<int>& truth, const int* labels, const long long int* position, int k) {
+    const int numTrue = truth.empty() ? 0 : *max_element(truth.begin(), truth.end()) + 1;
+    vector<double> table((size_t)k * numTrue, 0.0), rows(k, 0.0), columns(numTrue, 0.0);
+    double n = 0.0;
+    for (long long int i = 0; i < (long long int)truth.size(); i++) {
+        if (truth[i] < 0) continue;
+        int label = labels[position != nullptr ? position[i] : i];
+        table[(size_t)label * numTrue + truth[i]]++;
+        rows[label]++;
+        columns[truth[i]]++;
+        n++;
+    }
+    auto pairs = [](double x) { return 0.5 * x * (x - 1.0); };
+    double index = 0.0, rowPairs = 0.0, columnPairs = 0.0;
+    for (double x : table) index += pairs(x);
+    for (double x : rows) rowPairs += pairs(x);
+    for (double x : columns) columnPairs += pairs(x);
+    const double expected = rowPairs * columnPairs / pairs(n);
+    const double maximum = 0.5 * (rowPairs + columnPairs);
+    return maximum > expected ? (index - expected) / (maximum - expected) : 1.0;
+}
+
+/*
+    One repetition: initialization timed on its own, then the engine from the same seed, then
+    the write. Adds the phase times to m when measured is set.
+*/
+static void run_once(const string& algorithm, const DatasetView& data, const HarnessConfig& config, int k,
+                     const long long int* position, int* labels, double* centroids, Measurement& m, bool measured) {
+    for (long long int i = 0; i < data.numPoints; i++) labels[i] = -1;
+
+    // The tree is built outside the engine call; the seeding happens inside it
+    double buildTime = 0.0, seedTime = 0.0;
+    unique_ptr<KdTree> tree;
+    if (algorithm == "kdtree") {
+        double start = omp_get_wtime();
+        tree.reset(new KdTree(data));
+        buildTime = omp_get_wtime() - start;
+    }
+    if (algorithm != "minibatch") {
+        const bool parallel = algorithm != "serial";
+        srand(config.seed);
+        double start = omp_get_wtime();
+        dispatch_dims(data.dims, [&](auto dim) {
+            init_centroids<decltype(dim)::value>(data, k, centroids, config.init, parallel);
+        });
+        seedTime = omp_get_wtime() - start;
+    }
+
+    srand(config.seed);
+    double start = omp_get_wtime();
+    if (algorithm == "serial") {
+        kmeans_serial(data, k, config.maxIterations, labels, config.init);
+    } else if (algorithm == "elkan") {
+        kmeans_elkan(data, k, config.maxIterations, labels, nullptr, config.init);
+    } else if (algorithm == "yinyang") {
+        kmeans_yinyang(data, k, config.maxIterations, labels, 0, nullptr, config.init);
+    } else if (algorithm == "kdtree") {
+        kmeans_kdtree(*tree, k, config.maxIterations, labels, config.init);
+    } else if (algorithm == "minibatch") {
+        kmeans_minibatch(data, k, config.maxIterations, labels, MiniBatchOptions(), nullptr, config.init);
+    } else {
+        kmeans_paralelo(data, k, config.maxIterations, labels, config.init);
+    }
+    double engineTime = omp_get_wtime() - start;
+    double initTime = buildTime + seedTime;
+    double iterateTime = engineTime > seedTime ? engineTime - seedTime : 0.0;
+
+    start = omp_get_wtime();
+    save_results(config.output + "_results.csv", data, labels, RESULTS_CSV, position);
+    double writeTime = omp_get_wtime() - start;
+
+    if (!measured) return;
+    m.init.push_back(initTime);
+    m.iterate.push_back(iterateTime);
+    m.write.push_back(writeTime);
+    m.run.push_back(initTime + iterateTime);
+}
+
+static void write_summary_json(ostream& out, const char* name, const vector<double>& samples, bool last) {
+    Summary s = summarize(samples);
+    out << "        \"" << name << "\": {\"median\": " << s.median << ", \"p95\": " << s.p95 << ", \"stddev\": "
+        << s.stddev << ", \"min\": " << s.min << ", \"max\": " << s.max << "}" << (last ? "\n" : ",\n");
+}
+
+static void write_samples_json(ostream& out, const vector<double>& samples) {
+    out << "[";
+    for (size_t i = 0; i < samples.size(); i++) out << (i > 0 ? ", " : "") << samples[i];
+    out << "]";
+}
+
+static void write_counters_csv(ostream& out, const Measurement& m) {
+    out << (m.counted ? "yes" : "no");
+    for (int p = 0; p < PERF_PHASES; p++) {
+        const PerfValues& v = m.counters[p];
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            out << ",";
+            if (m.counted && v.counted[e]) out << v.count[e];
+        }
+        out << ",";
+        if (m.counted && v.counted[PERF_CYCLES] && v.counted[PERF_INSTRUCTIONS]) out << v.ipc();
+        out << ",";
+        if (m.counted && v.counted[PERF_LLC_MISSES]) out << v.bytes_per_point(m.pointsVisited);
+    }
+}
+
+static void write_counters_json(ostream& out, const Measurement& m) {
+    if (!m.counted) {
+        out << "{\"available\": false, \"reason\": \"" << m.counterNote << "\"}";
+        return;
+    }
+    out << "{\"available\": true, \"points_visited\": " << m.pointsVisited;
+    for (int p = 0; p < PERF_PHASES; p++) {
+        const PerfValues& v = m.counters[p];
+        out << ", \"" << perf_phase_name((PerfPhase)p) << "\": {";
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            out << "\"" << perf_event_name((PerfEvent)e) << "\": ";
+            if (v.counted[e]) out << v.count[e];
+            else out << "null";
+            out << ", ";
+        }
+        out << "\"ipc\": " << v.ipc() << ", \"bytes_per_point\": " << v.bytes_per_point(m.pointsVisited) << "}";
+    }
+    out << "}";
+}
+
+static bool write_results(const HarnessConfig& config, const vector<Measurement>& results) {
+    ofstream csv(config.output + ".csv");
+    ofstream json(config.output + ".json");
+    if (!csv.is_open() || !json.is_open()) {
+        cerr << "Couldn't write to " << config.output << ".csv / .json\n";
+        return false;
+    }
+    csv.precision(10);
+    json.precision(10);
+
+    csv << "DataSize,NumThreads,SerialTime,ParallelTime,Speedup,Algorithm,K,Dims,Init,Curve,Repetitions,"
+           "P95Time,StdDevTime,LoadTime,InitTime,IterateTime,WriteTime,Inertia,ARI,Counters";
+    for (const char* phase : {"Assign", "Accumulate"}) {
+        for (const char* value : {"Cycles", "Instructions", "LLCMisses", "BranchMisses", "IPC", "BytesPerPoint"}) {
+            csv << "," << phase << value;
+        }
+    }
+    csv << "\n";
+    json << "{\n  \"config\": {\"init\": \"" << config.initName << "\", \"curve\": \"" << config.curveName
+         << "\", \"affinity\": \"" << config.affinityName
+         << "\", \"max_iterations\": " << config.maxIterations << ", \"seed\": " << config.seed
+         << ", \"warmup\": " << config.warmup << ", \"repetitions\": " << config.repetitions
+         << ", \"max_threads\": " << omp_get_max_threads() << "},\n  \"results\": [\n";
+
+    double serialTime = 0.0;
+    for (size_t r = 0; r < results.size(); r++) {
+        const Measurement& m = results[r];
+        Summary run = summarize(m.run);
+        if (m.algorithm == "serial") serialTime = run.median;
+        const int numThreads = m.algorithm == "serial" ? 0 : m.threads;
+        const double speedup = serialTime / run.median;
+
+        csv << m.size << "," << numThreads << "," << serialTime << "," << run.median << "," << speedup << ","
+            << m.algorithm << "," << m.k << "," << m.dims << "," << config.initName << "," << config.curveName << ","
+            << m.run.size() << "," << run.p95 << "," << run.stddev << "," << summarize(m.load).median << ","
+            << summarize(m.init).median << "," << summarize(m.iterate).median << "," << summarize(m.write).median
+            << "," << m.inertia << ",";
+        if (!std::isnan(m.ari)) csv << m.ari;
+        csv << ",";
+        write_counters_csv(csv, m);
+        csv << "\n";
+
+        json << "    {\n      \"data_size\": " << m.size << ", \"num_threads\": " << numThreads << ", \"algorithm\": \""
+             << m.algorithm << "\", \"k\": " << m.k << ", \"dims\": " << m.dims << ",\n      \"serial_time\": "
+             << serialTime << ", \"parallel_time\": " << run.median << ", \"speedup\": " << speedup
+             << ", \"inertia\": " << m.inertia << ", \"ari\": ";
+        if (std::isnan(m.ari)) json << "null";
+        else json << m.ari;
+        json << ",\n      \"counters\": ";
+        write_counters_json(json, m);
+        json << ",\n      \"phases\": {\n";
+        write_summary_json(json, "run", m.run, false);
+        write_summary_json(json, "load", m.load, false);
+        write_summary_json(json, "init", m.init, false);
+        write_summary_json(json, "iterate", m.iterate, false);
+        write_summary_json(json, "write", m.write, true);
+        json << "      },\n      \"run_samples\": ";
+        write_samples_json(json, m.run);
+        json << "\n    }" << (r + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const string config_name = argc > 1 ? argv[1] : "benchmarks/harness.conf";
+    HarnessConfig config;
+    if (!read_config(config_name, config)) return 1;
+
+    const int maxThreads = omp_get_max_threads();
+    vector<Measurement> results;
+
+    for (long long int size : config.sizes) {
+        // Load phase, repeated like the runs; the last data set opened is the one clustered
+        const string input = "data/" + to_string(size) + "_data";
+        vector<double> loadTimes;
+        unique_ptr<InputDataset> input_data;
+        for (int rep = 0; rep < config.warmup + config.repetitions; rep++) {
+            input_data.reset(new InputDataset());
+            double start = omp_get_wtime();
+            if (!input_data->open(input, size)) break;
+            if (rep >= config.warmup) loadTimes.push_back(omp_get_wtime() - start);
+        }
+        if (loadTimes.empty()) {
+            cerr << "Skipping " << input << ": no .bin or .csv file\n";
+            continue;
+        }
+        DatasetView data = input_data->view();
+        const vector<int> truth = read_ground_truth(input, data.numPoints);
+
+        SpatialOrder reordered;
+        const long long int* position = nullptr;
+        if (config.curve != CURVE_NONE) {
+            reordered.build(data, config.curve);
+            data = reordered.view();
+            position = reordered.position();
+        }
+
+        int* labels = new int[data.numPoints];
+        for (int k : config.ks) {
+            double* centroids = new double[k * data.dims];
+
+            vector<pair<string, int>> runs = {{"serial", 1}};
+            for (const string& t : config.threads) {
+                for (const string& a : config.algorithms) runs.push_back({a, thread_count(t)});
+            }
+
+            for (const pair<string, int>& r : runs) {
+                Measurement m;
+                m.algorithm = r.first;
+                m.size = data.numPoints;
+                m.dims = data.dims;
+                m.threads = r.second;
+                m.k = k;
+                m.load = loadTimes;
+
+                omp_set_num_threads(r.second);
+                // Pinned threads and a copy placed for them, outside the timings
+                DatasetView runData = data;
+                unique_ptr<Dataset> placed;
+                if (config.affinity != AFFINITY_NONE) {
+                    pin_threads(config.affinity, r.second);
+                    placed.reset(new Dataset(place_dataset(data)));
+                    runData = placed->view();
+                }
+#ifdef KMEANS_PERF
+                PerfCounters counters(r.second);
+#endif
+                for (int rep = 0; rep < config.warmup + config.repetitions; rep++) {
+                    const bool measured = rep >= config.warmup;
+#ifdef KMEANS_PERF
+                    // Only the measured repetitions are counted
+                    unique_ptr<PerfScope> scope(measured ? new PerfScope(counters) : nullptr);
+#endif
+                    run_once(r.first, runData, config, k, position, labels, centroids, m, measured);
+                }
+#ifdef KMEANS_PERF
+                m.counted = counters.available();
+                m.counterNote = counters.reason();
+                for (int p = 0; p < PERF_PHASES; p++) {
+                    m.counters[p] = counters.totals((PerfPhase)p);
+                    for (int e = 0; e < PERF_EVENTS; e++) m.counters[p].count[e] /= config.repetitions;
+                }
+                m.pointsVisited = counters.points_visited() / config.repetitions;
+#endif
+                m.inertia = labels_inertia(data, k, labels);
+                if (!truth.empty()) m.ari = adjusted_rand_index(truth, labels, position, k);
+                omp_set_num_threads(maxThreads);
+
+                Summary run = summarize(m.run);
+                cout << size << " puntos, k = " << k << ", " << r.first << " con " << r.second
+                     << " threads: mediana " << run.median << " s, p95 " << run.p95 << " s, desviacion "
+                     << run.stddev << " s\n";
+                results.push_back(m);
+            }
+            delete[] centroids;
+        }
+        delete[] labels;
+    }
+
+    if (!write_results(config, results)) return 1;
+    cout << "Resultados en " << config.output << ".csv y " << config.output << ".json\n";
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/incremental.h"
+
+using namespace std;
+
+/*
+    Incremental update benchmark
+
+    Compares the full centroid update (update_centroids_paralelo) with the incremental one
+    (IncrementalCentroids::apply) for several fractions of reassigned points. Every round moves
+    that fraction of random points to a random cluster, recording the changes, and times both
+    updates on the new labels. After all the rounds the largest difference between the two sets
+    of centroids shows the rounding drift of the incremental sums (without the periodic refresh
+    the engines use).
+
+    Usage: bench_incremental <num_points> <num_clusters> <dims> [rounds] [fraction ...]
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> [rounds] [fraction ...]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int rounds = argc > 4 ? atoi(argv[4]) : 10;
+    vector<double> fractions;
+    for (int a = 5; a < argc; a++) fractions.push_back(atof(argv[a]));
+    if (fractions.empty()) fractions = {0.0001, 0.001, 0.01, 0.1};
+
+    srand(1);
+    Dataset data(n, dims, LAYOUT_SOA);
+    for (long long int i = 0; i < n; i++) {
+        for (int d = 0; d < dims; d++) data.at(i, d) = rand() / (double)RAND_MAX;
+    }
+    int* labels = new int[n];
+    vector<double> full(k * dims), incremental(k * dims);
+
+    cout << "Threads: " << omp_get_max_threads() << "\n";
+    cout << "Fraction,Changes,FullTime,IncrementalTime,Speedup,MaxDifference\n";
+    for (double fraction : fractions) {
+        for (long long int i = 0; i < n; i++) labels[i] = rand() % k;
+        const long long int changes = (long long int)(fraction * n);
+
+        ReductionWorkspace workspace(k, dims);
+        IncrementalCentroids sums(k, dims, workspace.numThreads());
+        dispatch_dims(dims, [&](auto dim) {
+            update_centroids_paralelo<decltype(dim)::value>(data.view(), labels, full.data(), workspace);
+        });
+        sums.set(workspace.totalSums(), workspace.totalSizes());
+
+        double fullTime = 0.0, incrementalTime = 0.0;
+        for (int r = 0; r < rounds; r++) {
+            // Spread the changes over the lists like an engine with a static schedule would
+            for (long long int c = 0; c < changes; c++) {
+                long long int i = ((long long int)rand() * RAND_MAX + rand()) % n;
+                int to = rand() % k;
+                if (to == labels[i]) continue;
+                sums.record((int)(i * sums.numThreads() / n), i, labels[i], to);
+                labels[i] = to;
+            }
+
+            double start = omp_get_wtime();
+            dispatch_dims(dims, [&](auto dim) {
+                update_centroids_paralelo<decltype(dim)::value>(data.view(), labels, full.data(), workspace);
+            });
+            fullTime += omp_get_wtime() - start;
+
+            start = omp_get_wtime();
+            dispatch_dims(dims, [&](auto dim) { sums.apply<decltype(dim)::value>(data.view(), &workspace); });
+            sums.move_to_means(incremental.data());
+            incrementalTime += omp_get_wtime() - start;
+            sums.end_iteration(changes);
+        }
+
+        double maxDifference = 0.0;
+        for (int j = 0; j < k * dims; j++) maxDifference = fmax(maxDifference, fabs(full[j] - incremental[j]));
+        cout << fraction << "," << changes << "," << fullTime / rounds << "," << incrementalTime / rounds << ","
+             << fullTime / incrementalTime << "," << maxDifference << "\n";
+    }
+
+    delete[] labels;
+    return 0;
+}
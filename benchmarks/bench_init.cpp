@@ -0,0 +1,132 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/elkan.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Initialization benchmark
+
+    For random seeding, k-means++ and k-means|| on Gaussian blobs: time of the initialization
+    alone, inertia of the initial centroids, Lloyd iterations to convergence, total time of
+    kmeans_paralelo and final inertia. The iterations are counted with kmeans_elkan, which
+    produces the Lloyd labels. The D^2 initializers are also run with 1 thread and with all
+    threads from the same seed and must give bit-identical centroids.
+
+    Usage: bench_init <num_points> <num_clusters> <dims> <max_iterations> [seed]
+*/
+
+// Sum of squared distances from every point to the closest centroid
+static double inertia_of(const DatasetView& data, int k, const double* centroids) {
+    double total = 0.0;
+    #pragma omp parallel for reduction(+:total) schedule(static)
+    for (long long int i = 0; i < data.numPoints; i++) {
+        double best = INFINITY;
+        for (int j = 0; j < k; j++) {
+            double dist = 0.0;
+            for (int d = 0; d < data.dims; d++) {
+                double diff = data.at(i, d) - centroids[j * data.dims + d];
+                dist += diff * diff;
+            }
+            if (dist < best) best = dist;
+        }
+        total += best;
+    }
+    return total;
+}
+
+// Inertia of a labeling, with every cluster at the mean of its points
+static double labels_inertia(const DatasetView& data, int k, const int* labels) {
+    const int dims = data.dims;
+    vector<double> means(k * dims, 0.0);
+    vector<long long int> sizes(k, 0);
+    for (long long int i = 0; i < data.numPoints; i++) {
+        sizes[labels[i]]++;
+        for (int d = 0; d < dims; d++) means[labels[i] * dims + d] += data.at(i, d);
+    }
+    for (int j = 0; j < k; j++) {
+        for (int d = 0; d < dims; d++) means[j * dims + d] /= sizes[j] > 0 ? sizes[j] : 1;
+    }
+    double total = 0.0;
+    for (long long int i = 0; i < data.numPoints; i++) {
+        for (int d = 0; d < dims; d++) {
+            double diff = data.at(i, d) - means[labels[i] * dims + d];
+            total += diff * diff;
+        }
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations> [seed]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+    const int seed = argc > 5 ? atoi(argv[5]) : 1;
+    const int maxThreads = omp_get_max_threads();
+
+    // k blobs with centers in [0, 10)^dims
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, seed);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+
+    const InitMethod methods[3] = {INIT_RANDOM, INIT_KMEANS_PLUS_PLUS, INIT_KMEANS_PARALLEL};
+    const char* names[3] = {"random", "kmeans++", "kmeans||"};
+    double* centroids = new double[k * dims];
+    double* serialCentroids = new double[k * dims];
+    int* labels = new int[n];
+    bool reproducible = true;
+
+    cout << "Threads: " << maxThreads << "\n";
+    cout << "Init,InitTime,InitInertia,Iterations,LloydTime,FinalInertia,SameWith1Thread\n";
+    for (int m = 0; m < 3; m++) {
+        srand(seed);
+        double start = omp_get_wtime();
+        dispatch_dims(dims, [&](auto dim) {
+            init_centroids<decltype(dim)::value>(data.view(), k, centroids, methods[m]);
+        });
+        double initTime = omp_get_wtime() - start;
+
+        bool same = true;
+        if (methods[m] != INIT_RANDOM) {
+            omp_set_num_threads(1);
+            srand(seed);
+            dispatch_dims(dims, [&](auto dim) {
+                init_centroids<decltype(dim)::value>(data.view(), k, serialCentroids, methods[m]);
+            });
+            omp_set_num_threads(maxThreads);
+            same = memcmp(centroids, serialCentroids, sizeof(double) * k * dims) == 0;
+            reproducible = reproducible && same;
+        }
+
+        srand(seed);
+        PruningStats stats;
+        kmeans_elkan(data, k, maxIterations, labels, &stats, methods[m]);
+
+        srand(seed);
+        start = omp_get_wtime();
+        kmeans_paralelo(data, k, maxIterations, labels, methods[m]);
+        double lloydTime = omp_get_wtime() - start;
+
+        cout << names[m] << "," << initTime << "," << inertia_of(data, k, centroids) << "," << stats.iterations << ","
+             << lloydTime << "," << labels_inertia(data, k, labels) << "," << (same ? "yes" : "no") << "\n";
+    }
+
+    delete[] labels;
+    delete[] serialCentroids;
+    delete[] centroids;
+    return reproducible ? 0 : 1;
+}
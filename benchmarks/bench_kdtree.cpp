@@ -0,0 +1,75 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/kdtree.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Kd-tree filtering benchmark
+
+    Builds one kd-tree over Gaussian blobs and reuses it for every k in the list (5, 20 and 100
+    by default), comparing kmeans_paralelo (Lloyd) against kmeans_kdtree from the same seed.
+    Reports the build time once, then per k both times and the label mismatches (which can only
+    come from the different order of the centroid sums).
+
+    Usage: bench_kdtree <num_points> <dims> <max_iterations> [seed] [k ...]
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <num_points> <dims> <max_iterations> [seed] [k ...]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int dims = atoi(argv[2]);
+    const int maxIterations = atoi(argv[3]);
+    const int seed = argc > 4 ? atoi(argv[4]) : 1;
+    vector<int> ks = {5, 20, 100};
+    if (argc > 5) {
+        ks.clear();
+        for (int a = 5; a < argc; a++) ks.push_back(atoi(argv[a]));
+    }
+
+    // 20 blobs with centers in [0, 10)^dims
+    const int blobs = 20;
+    const BlobMixture mixture(n, dims, blobs, 0.5, 10.0, seed);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+
+    double start = omp_get_wtime();
+    KdTree tree(data);
+    cout << "Threads: " << omp_get_max_threads() << ", tree build: " << omp_get_wtime() - start << " s ("
+         << tree.numNodes() << " nodes)\n";
+
+    int* lloydLabels = new int[n];
+    int* treeLabels = new int[n];
+    cout << "k,LloydTime,KdTreeTime,Speedup,Mismatches\n";
+    for (int k : ks) {
+        for (long long int i = 0; i < n; i++) lloydLabels[i] = treeLabels[i] = -1;
+
+        srand(seed);
+        start = omp_get_wtime();
+        kmeans_paralelo(data, k, maxIterations, lloydLabels);
+        double lloydTime = omp_get_wtime() - start;
+
+        srand(seed);
+        start = omp_get_wtime();
+        kmeans_kdtree(tree, k, maxIterations, treeLabels);
+        double treeTime = omp_get_wtime() - start;
+
+        long long int mismatches = 0;
+        for (long long int i = 0; i < n; i++) mismatches += lloydLabels[i] != treeLabels[i];
+        cout << k << "," << lloydTime << "," << treeTime << "," << lloydTime / treeTime << "," << mismatches << "\n";
+    }
+
+    delete[] treeLabels;
+    delete[] lloydLabels;
+    return 0;
+}
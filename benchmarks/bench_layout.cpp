@@ -0,0 +1,138 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+
+using namespace std;
+
+/*
+    Data layout benchmark
+
+    Compares the legacy pointer-per-point layout (double** with one new double[3] per point)
+    against the contiguous Dataset container in SoA and AoS layouts. For each layout it
+    measures allocation + fill time, one assignment sweep against k centroids and one
+    accumulation sweep, i.e. the two passes of a Lloyd iteration.
+
+    Usage: bench_layout <num_points> <num_clusters> <repetitions>
+*/
+
+static double assign_legacy(double** data, long long int n, const double* centroids, int k, int* labels) {
+    double start = omp_get_wtime();
+    #pragma omp parallel for schedule(static)
+    for (long long int i = 0; i < n; i++) {
+        int best = 0;
+        double bestDist = 1e300;
+        for (int j = 0; j < k; j++) {
+            double dx = data[i][0] - centroids[2 * j];
+            double dy = data[i][1] - centroids[2 * j + 1];
+            double dist = dx * dx + dy * dy;
+            if (dist < bestDist) { bestDist = dist; best = j; }
+        }
+        labels[i] = best;
+    }
+    return omp_get_wtime() - start;
+}
+
+static double accumulate_legacy(double** data, long long int n, const int* labels, int k, double* sums) {
+    double start = omp_get_wtime();
+    for (int j = 0; j < 2 * k; j++) sums[j] = 0.0;
+    for (long long int i = 0; i < n; i++) {
+        sums[2 * labels[i]] += data[i][0];
+        sums[2 * labels[i] + 1] += data[i][1];
+    }
+    return omp_get_wtime() - start;
+}
+
+static double assign_dataset(const DatasetView& data, const double* centroids, int k, int* labels) {
+    double start = omp_get_wtime();
+    #pragma omp parallel for schedule(static)
+    for (long long int i = 0; i < data.numPoints; i++) {
+        int best = 0;
+        double bestDist = 1e300;
+        for (int j = 0; j < k; j++) {
+            double dx = data.at(i, 0) - centroids[2 * j];
+            double dy = data.at(i, 1) - centroids[2 * j + 1];
+            double dist = dx * dx + dy * dy;
+            if (dist < bestDist) { bestDist = dist; best = j; }
+        }
+        labels[i] = best;
+    }
+    return omp_get_wtime() - start;
+}
+
+static double accumulate_dataset(const DatasetView& data, const int* labels, int k, double* sums) {
+    double start = omp_get_wtime();
+    for (int j = 0; j < 2 * k; j++) sums[j] = 0.0;
+    for (long long int i = 0; i < data.numPoints; i++) {
+        sums[2 * labels[i]] += data.at(i, 0);
+        sums[2 * labels[i] + 1] += data.at(i, 1);
+    }
+    return omp_get_wtime() - start;
+}
+
+static void report(string name, double alloc, double assign, double accumulate, int reps) {
+    cout << name << ": alloc+fill " << alloc << " s, assignment " << assign / reps
+         << " s, accumulation " << accumulate / reps << " s\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <repetitions>\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int reps = atoi(argv[3]);
+
+    srand(1);
+    double* centroids = new double[2 * k];
+    for (int j = 0; j < 2 * k; j++) centroids[j] = rand() / (double)RAND_MAX;
+    double* sums = new double[2 * k];
+    int* labels = new int[n];
+
+    // Legacy layout
+    double start = omp_get_wtime();
+    double** legacy = new double*[n];
+    for (long long int i = 0; i < n; i++) {
+        legacy[i] = new double[3]{(i % 1000) / 1000.0, (i % 997) / 997.0, -1};
+    }
+    double alloc = omp_get_wtime() - start;
+    double assign = 0.0, accumulate = 0.0;
+    for (int r = 0; r < reps; r++) {
+        assign += assign_legacy(legacy, n, centroids, k, labels);
+        accumulate += accumulate_legacy(legacy, n, labels, k, sums);
+    }
+    report("double** (legacy)", alloc, assign, accumulate, reps);
+    double checksum = sums[0];
+    start = omp_get_wtime();
+    for (long long int i = 0; i < n; i++) delete[] legacy[i];
+    delete[] legacy;
+    cout << "  legacy free: " << omp_get_wtime() - start << " s\n";
+
+    // Contiguous layouts
+    Layout layouts[2] = {LAYOUT_SOA, LAYOUT_AOS};
+    string names[2] = {"Dataset SoA", "Dataset AoS"};
+    for (int l = 0; l < 2; l++) {
+        start = omp_get_wtime();
+        Dataset data(n, 2, layouts[l]);
+        for (long long int i = 0; i < n; i++) {
+            data.at(i, 0) = (i % 1000) / 1000.0;
+            data.at(i, 1) = (i % 997) / 997.0;
+        }
+        alloc = omp_get_wtime() - start;
+        assign = accumulate = 0.0;
+        for (int r = 0; r < reps; r++) {
+            assign += assign_dataset(data, centroids, k, labels);
+            accumulate += accumulate_dataset(data, labels, k, sums);
+        }
+        report(names[l], alloc, assign, accumulate, reps);
+        if (sums[0] != checksum) cerr << "  warning: checksum mismatch against legacy layout\n";
+    }
+
+    delete[] labels;
+    delete[] sums;
+    delete[] centroids;
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/minibatch.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Mini-batch benchmark
+
+    Runs kmeans_paralelo (Lloyd) and kmeans_minibatch with several batch sizes from the same
+    seed on Gaussian blobs. Reports time, iterations, whether the smoothed centroid shift
+    converged and the inertia of the final labels relative to Lloyd's.
+
+    Usage: bench_minibatch <num_points> <num_clusters> <dims> <max_iterations> [seed] [batch_size ...]
+*/
+
+// Inertia of a labeling, with every cluster at the mean of its points
+static double labels_inertia(const DatasetView& data, int k, const int* labels) {
+    const int dims = data.dims;
+    vector<double> means(k * dims, 0.0);
+    vector<long long int> sizes(k, 0);
+    for (long long int i = 0; i < data.numPoints; i++) {
+        sizes[labels[i]]++;
+        for (int d = 0; d < dims; d++) means[labels[i] * dims + d] += data.at(i, d);
+    }
+    for (int j = 0; j < k; j++) {
+        for (int d = 0; d < dims; d++) means[j * dims + d] /= sizes[j] > 0 ? sizes[j] : 1;
+    }
+    double total = 0.0;
+    for (long long int i = 0; i < data.numPoints; i++) {
+        for (int d = 0; d < dims; d++) {
+            double diff = data.at(i, d) - means[labels[i] * dims + d];
+            total += diff * diff;
+        }
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations> [seed] [batch_size ...]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+    const int seed = argc > 5 ? atoi(argv[5]) : 1;
+    vector<long long int> batchSizes;
+    for (int a = 6; a < argc; a++) batchSizes.push_back(atoll(argv[a]));
+    if (batchSizes.empty()) batchSizes = {256, 1024, 4096, 16384};
+
+    // k blobs with centers in [0, 10)^dims
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, seed);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+
+    int* labels = new int[n];
+
+    srand(seed);
+    double start = omp_get_wtime();
+    kmeans_paralelo(data, k, maxIterations, labels);
+    double lloydTime = omp_get_wtime() - start;
+    double lloydInertia = labels_inertia(data, k, labels);
+
+    cout << "Threads: " << omp_get_max_threads() << "\n";
+    cout << "Lloyd: " << lloydTime << " s, inertia " << lloydInertia << "\n";
+    cout << "BatchSize,Iterations,Converged,Time,Speedup,InertiaRatio\n";
+    for (long long int batchSize : batchSizes) {
+        MiniBatchOptions options;
+        options.batchSize = batchSize;
+        MiniBatchStats stats;
+        srand(seed);
+        start = omp_get_wtime();
+        kmeans_minibatch(data, k, maxIterations, labels, options, &stats);
+        double time = omp_get_wtime() - start;
+        cout << batchSize << "," << stats.iterations << "," << (stats.converged ? "yes" : "no") << "," << time << ","
+             << lloydTime / time << "," << labels_inertia(data, k, labels) / lloydInertia << "\n";
+    }
+
+    delete[] labels;
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <mpi.h>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/distributed.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Distributed benchmark
+
+    Strong and weak scaling of kmeans_distributed over 1, 2, 4, ... up to all the ranks of the
+    job (sub-communicators of the first p ranks). Every rank generates its own shard of Gaussian
+    blobs with the counter-based generator (kmeans/synthetic.h), so point i is the same whatever the number of ranks
+    and nothing goes through the file system: strong scaling clusters num_points points in
+    total, weak scaling num_points points per rank. Reports the time of the slowest rank, the
+    time per iteration, speedup and efficiency against p = 1 and the fraction of the time spent
+    in MPI_Allreduce. In strong scaling every p must produce the same labels as p = 1
+    (compared through a checksum of the labels by global index).
+
+    Usage: mpirun -np <ranks> ./bench_mpi <num_points> <num_clusters> <dims> <max_iterations>
+*/
+
+static const uint64_t BENCH_SEED = 1;
+
+struct ScalingRun {
+    int iterations = 0;
+    double time = 0.0;
+    double communication = 0.0;
+    double checksum = 0.0;
+};
+
+// Clusters numPoints points split among the ranks of comm; times are those of the slowest rank
+static ScalingRun run(MPI_Comm comm, long long int numPoints, int k, int dims, int maxIterations) {
+    int rank, numRanks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &numRanks);
+    long long int first, count;
+    shard_rows(numPoints, rank, numRanks, first, count);
+
+    // k blobs with centers in [0, 10)^dims and standard deviation 0.5; this rank's rows
+    const BlobMixture mixture(numPoints, dims, k, 0.5, 10.0, BENCH_SEED);
+    Dataset data(count, dims, LAYOUT_SOA);
+    mixture.fill(data, first);
+
+    vector<int> labels(count, -1);
+    vector<double> centroids((size_t)k * dims);
+    DistributedStats stats;
+    srand(7);
+    MPI_Barrier(comm);
+    kmeans_distributed(data.view(), k, maxIterations, labels.data(), centroids.data(), comm, &stats);
+
+    ScalingRun result;
+    result.iterations = stats.iterations;
+    double times[2] = {stats.totalSeconds, stats.communicationSeconds};
+    MPI_Allreduce(MPI_IN_PLACE, times, 2, MPI_DOUBLE, MPI_MAX, comm);
+    result.time = times[0];
+    result.communication = times[1];
+    double checksum = 0.0;
+    for (long long int i = 0; i < count; i++) checksum += (double)labels[i] * ((first + i) % 1000003 + 1);
+    MPI_Allreduce(&checksum, &result.checksum, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, numRanks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+    if (argc < 5) {
+        if (rank == 0) cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations>\n";
+        MPI_Finalize();
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+
+    vector<int> counts;
+    for (int p = 1; p < numRanks; p *= 2) counts.push_back(p);
+    counts.push_back(numRanks);
+
+    if (rank == 0) {
+        cout << "Ranks: " << numRanks << ", threads per rank: " << omp_get_max_threads() << "\n";
+        cout << "Scaling,Ranks,Points,Iterations,Time,TimePerIteration,Speedup,Efficiency,CommFraction,SameLabels\n";
+    }
+    bool same = true;
+    for (int weak = 0; weak < 2; weak++) {
+        ScalingRun reference;
+        for (int p : counts) {
+            MPI_Comm comm;
+            MPI_Comm_split(MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &comm);
+            const long long int numPoints = weak ? n * p : n;
+            ScalingRun result;
+            if (comm != MPI_COMM_NULL) {
+                result = run(comm, numPoints, k, dims, maxIterations);
+                MPI_Comm_free(&comm);
+            }
+            if (p == 1) reference = result;
+            if (rank == 0) {
+                // Per iteration, so a different number of iterations doesn't skew weak scaling
+                const double perIteration = result.time / result.iterations;
+                const double referencePerIteration = reference.time / reference.iterations;
+                const double speedup = weak ? referencePerIteration * p / perIteration : referencePerIteration / perIteration;
+                const bool sameLabels = result.checksum == reference.checksum && result.iterations == reference.iterations;
+                if (!weak) same = same && sameLabels;
+                cout << (weak ? "weak," : "strong,") << p << "," << numPoints << "," << result.iterations << ","
+                     << result.time << "," << perIteration << "," << speedup << "," << speedup / p << ","
+                     << result.communication / result.time << "," << (weak ? "" : sameLabels ? "yes" : "no") << "\n";
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+    }
+
+    MPI_Bcast(&same, 1, MPI_CXX_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Finalize();
+    return same ? 0 : 1;
+}
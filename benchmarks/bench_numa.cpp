@@ -0,0 +1,102 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/numa.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    NUMA benchmark
+
+    Scaling of kmeans_paralelo at 1, half and all of omp_get_max_threads() threads (the axes of
+    the speedups experiment of kmeans_final.cpp) with the data placed two ways:
+        master       the data set created by one thread, so every page sits on its node (what
+                     a single-threaded loader does)
+        first touch  a copy placed by place_dataset with the threads of the run, matching the
+                     static block schedule of the assignment loop
+    and the threads unpinned, pinned compact or pinned scatter (see kmeans/numa.h); pinned runs
+    over several nodes reduce the per-thread sums per node. Reports the best time of the
+    repetitions, the speedup over one thread with the same placement and affinity, the nodes
+    the reduction was split over and the share of labels equal to the one-thread run. On a
+    single node all placements should be on par; only the reduction order changes with the
+    placement, so the labels must agree up to points on the border of two clusters.
+
+    Usage: bench_numa <num_points> <num_clusters> <dims> <max_iterations> [repetitions]
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations> [repetitions]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+    const int repetitions = argc > 5 ? atoi(argv[5]) : 3;
+    const int maxThreads = omp_get_max_threads();
+
+    // k blobs with centers in [0, 10)^dims, created and filled by a single thread
+    omp_set_num_threads(1);
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, 1);
+    Dataset master(n, dims, LAYOUT_SOA);
+    mixture.fill(master);
+
+    const NumaTopology topology = numa_topology();
+    cout << "Threads: " << maxThreads << ", " << topology.numNodes() << " NUMA nodes, " << topology.numCpus()
+         << " CPUs, " << n << " points, k = " << k << ", " << dims << " dimensions\n";
+
+    vector<int> threadCounts = {1};
+    if (maxThreads / 2 > 1) threadCounts.push_back(maxThreads / 2);
+    if (maxThreads > 1) threadCounts.push_back(maxThreads);
+
+    vector<int> reference(n), labels(n);
+    bool haveReference = false, same = true;
+    cout << "Affinity,Placement,NumThreads,Time,Speedup,ReductionNodes,SameLabels\n";
+    for (ThreadAffinity affinity : {AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SCATTER}) {
+        for (int placement = 0; placement < 2; placement++) {
+            const string placementName = placement == 0 ? "master" : "first touch";
+            double oneThread = 0.0;
+            for (int threads : threadCounts) {
+                omp_set_num_threads(threads);
+                if (!pin_threads(affinity, threads)) return 1;
+                Dataset placed;
+                if (placement == 1) placed = place_dataset(master.view());
+                const DatasetView data = placement == 1 ? placed.view() : master.view();
+                const int nodes = ReductionWorkspace(k, dims, threads).numNodes();
+
+                double best = 0.0;
+                for (int rep = 0; rep < repetitions; rep++) {
+                    for (long long int i = 0; i < n; i++) labels[i] = -1;
+                    srand(7);
+                    double start = omp_get_wtime();
+                    kmeans_paralelo(data, k, maxIterations, labels.data());
+                    const double time = omp_get_wtime() - start;
+                    best = rep == 0 || time < best ? time : best;
+                }
+                if (threads == 1) oneThread = best;
+
+                if (!haveReference) {
+                    reference = labels;
+                    haveReference = true;
+                }
+                long long int equal = 0;
+                for (long long int i = 0; i < n; i++) equal += labels[i] == reference[i];
+                const double share = n > 0 ? (double)equal / n : 1.0;
+                same = same && share >= 0.999;
+                cout << thread_affinity_name(affinity) << "," << placementName << "," << threads << "," << best << ","
+                     << oneThread / best << "," << nodes << "," << share << "\n";
+            }
+        }
+    }
+    omp_set_num_threads(maxThreads);
+    pin_threads(AFFINITY_NONE, maxThreads);
+    cout << "Same labels in every configuration: " << (same ? "yes" : "no") << "\n";
+    return same ? 0 : 1;
+}
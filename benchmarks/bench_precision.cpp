@@ -0,0 +1,152 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Precision benchmark
+
+    Compares the double engine against the float32 (mixed precision) one on the same points:
+        step:  time per fused Lloyd iteration from the same starting centroids, bytes of
+               coordinates streamed per iteration and effective bandwidth
+        run:   complete kmeans_paralelo runs with the same seed; labels that differ, largest
+               distance between the centroids (means of the labels, computed in double) of the
+               two runs relative to the spread of the data, and relative inertia
+        drift: mean of all the float points accumulated in a float, in a double (what the
+               engine does) and in long double as the reference, to show why the sums stay in
+               double at large n
+    The float step must label the same points as the double step except for near ties.
+
+    Usage: bench_precision <num_points> <num_clusters> <dims> <max_iterations> [step_iterations]
+*/
+
+// Means of the clusters of labels (computed in double from the double points) and their inertia
+static double label_means(const DatasetView& data, int k, const int* labels, vector<double>& means) {
+    const int dims = data.dims;
+    means.assign((size_t)k * dims, 0.0);
+    vector<long long int> sizes(k, 0);
+    for (long long int i = 0; i < data.numPoints; i++) {
+        sizes[labels[i]]++;
+        for (int d = 0; d < dims; d++) means[labels[i] * dims + d] += data.at(i, d);
+    }
+    for (int j = 0; j < k; j++) {
+        for (int d = 0; d < dims; d++) means[j * dims + d] /= sizes[j] > 0 ? sizes[j] : 1;
+    }
+    double total = 0.0;
+    for (long long int i = 0; i < data.numPoints; i++) {
+        for (int d = 0; d < dims; d++) {
+            double diff = data.at(i, d) - means[labels[i] * dims + d];
+            total += diff * diff;
+        }
+    }
+    return total;
+}
+
+template <int D, typename T>
+static double time_steps(const BasicDatasetView<T>& data, int k, int iterations, const double* start, int* labels) {
+    const int dims = data.dims;
+    vector<double> centroids(start, start + (size_t)k * dims);
+    ReductionWorkspace workspace(k, dims);
+    BasicCentroidTable<T> table(k, dims);
+    for (long long int i = 0; i < data.numPoints; i++) labels[i] = -1;
+
+    double begin = omp_get_wtime();
+    for (int it = 0; it < iterations; it++) {
+        table.load(centroids.data());
+        lloyd_step_fused<D>(data, table, labels, centroids.data(), workspace);
+    }
+    return (omp_get_wtime() - begin) / iterations;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations> [step_iterations]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+    const int stepIterations = argc > 5 ? atoi(argv[5]) : 10;
+
+    // k blobs with centers in [0, 10)^dims
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, 1);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+    FloatDataset single = convert_dataset<float>(data.view());
+
+    cout << "Threads: " << omp_get_max_threads() << ", SIMD: " << simd_level_name(active_simd_level()) << "\n";
+
+    // Fused steps from the same starting centroids (the blob centers shifted)
+    vector<double> start(mixture.centers);
+    for (double& c : start) c += 0.25;
+    vector<int> doubleLabels(n), floatLabels(n);
+    double doubleStep = 0.0, floatStep = 0.0;
+    dispatch_dims(dims, [&](auto dim) {
+        doubleStep = time_steps<decltype(dim)::value>(data.view(), k, stepIterations, start.data(), doubleLabels.data());
+        floatStep = time_steps<decltype(dim)::value>(single.view(), k, stepIterations, start.data(), floatLabels.data());
+    });
+    long long int stepDifferent = 0;
+    for (long long int i = 0; i < n; i++) stepDifferent += doubleLabels[i] != floatLabels[i];
+    const double doubleBytes = (double)sizeof(double) * n * dims, floatBytes = (double)sizeof(float) * n * dims;
+    cout << "Step,Precision,TimePerIteration,Speedup,CoordinateMB,BandwidthGBs,DifferentLabels\n";
+    cout << "step,double," << doubleStep << ",1," << doubleBytes / 1e6 << "," << doubleBytes / doubleStep / 1e9 << ",0\n";
+    cout << "step,float," << floatStep << "," << doubleStep / floatStep << "," << floatBytes / 1e6 << ","
+         << floatBytes / floatStep / 1e9 << "," << stepDifferent << "\n";
+
+    // Complete runs with the same seed
+    for (long long int i = 0; i < n; i++) doubleLabels[i] = floatLabels[i] = -1;
+    srand(7);
+    double begin = omp_get_wtime();
+    kmeans_paralelo(data, k, maxIterations, doubleLabels.data());
+    const double doubleTime = omp_get_wtime() - begin;
+    srand(7);
+    begin = omp_get_wtime();
+    kmeans_paralelo(single, k, maxIterations, floatLabels.data());
+    const double floatTime = omp_get_wtime() - begin;
+
+    vector<double> doubleMeans, floatMeans;
+    const double doubleInertia = label_means(data, k, doubleLabels.data(), doubleMeans);
+    const double floatInertia = label_means(data, k, floatLabels.data(), floatMeans);
+    double maxError = 0.0;
+    for (int j = 0; j < k; j++) {
+        double dist = 0.0;
+        for (int d = 0; d < dims; d++) {
+            double diff = doubleMeans[j * dims + d] - floatMeans[j * dims + d];
+            dist += diff * diff;
+        }
+        maxError = sqrt(dist) > maxError ? sqrt(dist) : maxError;
+    }
+    long long int runDifferent = 0;
+    for (long long int i = 0; i < n; i++) runDifferent += doubleLabels[i] != floatLabels[i];
+    cout << "Run,Precision,Time,Speedup,DifferentLabels,MaxCentroidError,RelativeInertia\n";
+    cout << "run,double," << doubleTime << ",1,0,0,1\n";
+    cout << "run,float," << floatTime << "," << doubleTime / floatTime << "," << runDifferent << ","
+         << maxError / 0.5 << "," << floatInertia / doubleInertia << "\n";
+
+    // Accumulator drift over all the points of the first dimension
+    float floatSum = 0.0f;
+    double doubleSum = 0.0;
+    long double exactSum = 0.0L;
+    for (long long int i = 0; i < n; i++) {
+        floatSum += single.at(i, 0);
+        doubleSum += single.at(i, 0);
+        exactSum += single.at(i, 0);
+    }
+    const double exactMean = (double)(exactSum / n);
+    cout << "Drift,Accumulator,Mean,AbsoluteError\n";
+    cout << "drift,float," << floatSum / n << "," << fabs(floatSum / n - exactMean) << "\n";
+    cout << "drift,double," << doubleSum / n << "," << fabs(doubleSum / n - exactMean) << "\n";
+
+    // Near ties aside, both precisions must agree
+    return stepDifferent * 1000 > n ? 1 : 0;
+}
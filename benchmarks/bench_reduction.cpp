@@ -0,0 +1,111 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/reduction.h"
+
+using namespace std;
+
+/*
+    Centroid reduction benchmark
+
+    Times the centroid update of one Lloyd iteration (fixed labels) with the previous scheme,
+    thread-local arrays allocated on every call and merged in a critical section, and with
+    update_centroids_paralelo, which uses a ReductionWorkspace allocated once: cache-line
+    padded per-thread slots and a parallel merge split over the k * dims sums.
+    The merge is O(threads * k * dims), so the difference grows with k and the thread count.
+    Both updates must produce the same centroids up to rounding.
+
+    Usage: bench_reduction <num_points> <dims> [iterations] [k ...]
+*/
+
+// Previous update: per-call allocations, critical-section merge
+static void update_critical(const DatasetView& data, int k, const int* labels, double* centroids) {
+    const int dims = data.dims;
+    int* clusterSizes = new int[k]();
+    double* newCentroids = new double[dims * k]();
+
+    #pragma omp parallel
+    {
+        int* localSizes = new int[k]();
+        double* localSums = new double[dims * k]();
+
+        #pragma omp for schedule(dynamic, 1000)
+        for (long long int i = 0; i < data.numPoints; i++) {
+            int cluster = labels[i];
+            localSizes[cluster]++;
+            for (int d = 0; d < dims; d++) localSums[dims * cluster + d] += data.at(i, d);
+        }
+
+        #pragma omp critical
+        {
+            for (int i = 0; i < k; i++) clusterSizes[i] += localSizes[i];
+            for (int i = 0; i < dims * k; i++) newCentroids[i] += localSums[i];
+        }
+
+        delete[] localSums;
+        delete[] localSizes;
+    }
+
+    for (int i = 0; i < k; i++) {
+        if (clusterSizes[i] == 0) continue;
+        for (int d = 0; d < dims; d++) centroids[dims * i + d] = newCentroids[dims * i + d] / clusterSizes[i];
+    }
+    delete[] newCentroids;
+    delete[] clusterSizes;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <num_points> <dims> [iterations] [k ...]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int dims = atoi(argv[2]);
+    const int iterations = argc > 3 ? atoi(argv[3]) : 10;
+    vector<int> ks;
+    for (int a = 4; a < argc; a++) ks.push_back(atoi(argv[a]));
+    if (ks.empty()) ks = {10, 100, 1000, 5000};
+
+    srand(1);
+    Dataset data(n, dims, LAYOUT_SOA);
+    for (long long int i = 0; i < n; i++) {
+        for (int d = 0; d < dims; d++) data.at(i, d) = rand() / (double)RAND_MAX;
+    }
+    int* labels = new int[n];
+
+    cout << "Threads: " << omp_get_max_threads() << "\n";
+    cout << "k,CriticalTime,WorkspaceTime,Speedup,MaxDifference\n";
+    for (int k : ks) {
+        for (long long int i = 0; i < n; i++) labels[i] = rand() % k;
+        vector<double> critical(k * dims, 0.0), padded(k * dims, 0.0);
+
+        double start = omp_get_wtime();
+        for (int it = 0; it < iterations; it++) update_critical(data, k, labels, critical.data());
+        double criticalTime = (omp_get_wtime() - start) / iterations;
+
+        start = omp_get_wtime();
+        ReductionWorkspace workspace(k, dims);
+        for (int it = 0; it < iterations; it++) {
+            dispatch_dims(dims, [&](auto dim) {
+                update_centroids_paralelo<decltype(dim)::value>(data.view(), labels, padded.data(), workspace);
+            });
+        }
+        double workspaceTime = (omp_get_wtime() - start) / iterations;
+
+        double maxDifference = 0.0;
+        for (int j = 0; j < k * dims; j++) {
+            double diff = critical[j] > padded[j] ? critical[j] - padded[j] : padded[j] - critical[j];
+            if (diff > maxDifference) maxDifference = diff;
+        }
+        cout << k << "," << criticalTime << "," << workspaceTime << "," << criticalTime / workspaceTime << ","
+             << maxDifference << "\n";
+    }
+
+    delete[] labels;
+    return 0;
+}
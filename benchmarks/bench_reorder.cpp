@@ -0,0 +1,112 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/elkan.h"
+#include "../kmeans/yinyang.h"
+#include "../kmeans/reorder.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Reordering benchmark
+
+    Gaussian blobs generated in random order, clustered as they are and after sorting them
+    along a Morton and a Hilbert curve. For every order: time of the reordering, time of Lloyd
+    (kmeans_paralelo), Elkan and Yinyang from the same seed, Lloyd iterations, mean fraction of
+    distances Elkan skipped and inertia of the Lloyd labels. The initial centroids depend on the
+    point order, so iterations and inertia can differ slightly between orders.
+    Also checks that the permutation is consistent: every original point must be found at its
+    position() in the reordered copy and restore_labels must undo the reordering.
+
+    Usage: bench_reorder <num_points> <num_clusters> <dims> <max_iterations> [seed]
+*/
+
+// Sum of squared distances from every point to the mean of its cluster
+static double labels_inertia(const DatasetView& data, int k, const int* labels) {
+    const int dims = data.dims;
+    vector<double> means(k * dims, 0.0);
+    vector<long long int> sizes(k, 0);
+    for (long long int i = 0; i < data.numPoints; i++) {
+        sizes[labels[i]]++;
+        for (int d = 0; d < dims; d++) means[labels[i] * dims + d] += data.at(i, d);
+    }
+    for (int j = 0; j < k; j++) {
+        for (int d = 0; d < dims; d++) means[j * dims + d] /= sizes[j] > 0 ? sizes[j] : 1;
+    }
+    double total = 0.0;
+    for (long long int i = 0; i < data.numPoints; i++) {
+        for (int d = 0; d < dims; d++) {
+            double diff = data.at(i, d) - means[labels[i] * dims + d];
+            total += diff * diff;
+        }
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations> [seed]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+    const int seed = argc > 5 ? atoi(argv[5]) : 1;
+
+    // k blobs with centers in [0, 10)^dims, points in random blob order
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, seed);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+
+    const SpatialCurve curves[3] = {CURVE_NONE, CURVE_MORTON, CURVE_HILBERT};
+    const char* names[3] = {"none", "morton", "hilbert"};
+    int* labels = new int[n];
+    int* restored = new int[n];
+    bool consistent = true;
+
+    cout << "Threads: " << omp_get_max_threads() << "\n";
+    cout << "Curve,ReorderTime,LloydTime,ElkanTime,YinyangTime,Iterations,ElkanSkipped,Inertia\n";
+    for (int c = 0; c < 3; c++) {
+        double start = omp_get_wtime();
+        SpatialOrder reordered(data, curves[c]);
+        double reorderTime = omp_get_wtime() - start;
+        const DatasetView sorted = reordered.view();
+
+        for (long long int i = 0; i < n && consistent; i++) {
+            for (int d = 0; d < dims; d++) consistent = consistent && sorted.at(reordered.position()[i], d) == data.at(i, d);
+        }
+
+        srand(seed);
+        start = omp_get_wtime();
+        kmeans_paralelo(sorted, k, maxIterations, labels);
+        double lloydTime = omp_get_wtime() - start;
+        reordered.restore_labels(labels, restored);
+        for (long long int s = 0; s < n && consistent; s++) consistent = restored[reordered.order()[s]] == labels[s];
+        double inertia = labels_inertia(data, k, restored);
+
+        PruningStats stats;
+        srand(seed);
+        start = omp_get_wtime();
+        kmeans_elkan(sorted, k, maxIterations, labels, &stats);
+        double elkanTime = omp_get_wtime() - start;
+
+        srand(seed);
+        start = omp_get_wtime();
+        kmeans_yinyang(sorted, k, maxIterations, labels);
+        double yinyangTime = omp_get_wtime() - start;
+
+        cout << names[c] << "," << reorderTime << "," << lloydTime << "," << elkanTime << "," << yinyangTime << ","
+             << stats.iterations << "," << stats.meanSkipped() << "," << inertia << "\n";
+    }
+    cout << "Permutation consistent: " << (consistent ? "yes" : "no") << "\n";
+
+    delete[] restored;
+    delete[] labels;
+    return consistent ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/engine.h"
+#include "../kmeans/restarts.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Restarts benchmark
+
+    n_init runs of k-means on the same points, the way scripts used to call kmeans_paralelo in a
+    loop (here without reloading the data): one engine fit after another with the whole team,
+    against kmeans_restarts with one restart at a time, one thread per restart
+    (restart-level), the automatic grouping, and the last two with early abandonment.
+    Reports the grouping, time, speedup over the sequential fits, restarts abandoned and the
+    best inertia. Without abandonment every mode must find the same best inertia as the
+    sequential fits (up to the rounding of sums reduced by other thread counts); with it, a
+    best inertia within the abandonment margin.
+
+    Usage: bench_restarts <num_points> <num_clusters> <dims> <n_init> [max_iterations]
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <n_init> [max_iterations]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int nInit = atoi(argv[4]);
+    const int maxIterations = argc > 5 ? atoi(argv[5]) : 300;
+
+    // k overlapping blobs with centers in [0, 10)^dims: enough local optima to make restarts pay
+    const BlobMixture mixture(n, dims, k, 1.0, 10.0, 1);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+    const int threads = omp_get_max_threads();
+
+    KMeansOptions options;
+    options.k = k;
+    options.maxIterations = maxIterations;
+    options.seed = 7;
+
+    // Sequential fits with the seeds kmeans_restarts uses
+    vector<int> labels(n);
+    KMeans engine(options);
+    double sequentialBest = 0.0;
+    int sequentialWinner = -1;
+    double start = omp_get_wtime();
+    for (int r = 0; r < nInit; r++) {
+        KMeansOptions runOptions = options;
+        runOptions.seed = r == 0 ? options.seed : counter_random(options.seed, RESTART_STREAM_SEED, r);
+        engine.set_options(runOptions);
+        engine.fit(data.view(), labels.data());
+        if (sequentialWinner < 0 || engine.result().inertia < sequentialBest) {
+            sequentialBest = engine.result().inertia;
+            sequentialWinner = r;
+        }
+    }
+    const double sequentialTime = omp_get_wtime() - start;
+
+    cout << "Threads: " << threads << ", " << n << " points, k = " << k << ", " << dims << " dimensions, "
+         << nInit << " restarts\n";
+    cout << "Mode,Concurrent,ThreadsPerRestart,Time,Speedup,Abandoned,Best,BestInertia\n";
+    cout << "sequential fits,1," << threads << "," << sequentialTime << ",1,0," << sequentialWinner << ","
+         << sequentialBest << "\n";
+
+    struct Mode {
+        string name;
+        int concurrent;
+        bool abandon;
+    };
+    const Mode modes[] = {{"one at a time", 1, false},
+                          {"restart-level", threads, false},
+                          {"automatic", 0, false},
+                          {"restart-level abandon", threads, true},
+                          {"automatic abandon", 0, true}};
+    vector<double> centroids((size_t)k * dims);
+    bool same = true;
+    for (const Mode& mode : modes) {
+        RestartOptions restartOptions;
+        restartOptions.nInit = nInit;
+        restartOptions.concurrent = mode.concurrent;
+        restartOptions.abandon = mode.abandon;
+        RestartStats stats;
+        if (!kmeans_restarts(data.view(), options, restartOptions, labels.data(), centroids.data(), &stats)) return 1;
+
+        const double best = stats.inertia[stats.best];
+        const double tolerance = mode.abandon ? restartOptions.abandonMargin : 1e-9;
+        same = same && best <= sequentialBest * (1.0 + tolerance);
+        cout << mode.name << "," << stats.concurrent << "," << stats.threadsPerRestart << "," << stats.seconds << ","
+             << sequentialTime / stats.seconds << "," << stats.abandoned << "," << stats.best << "," << best << "\n";
+    }
+    cout << "Best inertia found by every mode: " << (same ? "yes" : "no") << "\n";
+    return same ? 0 : 1;
+}
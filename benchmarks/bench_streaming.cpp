@@ -0,0 +1,123 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/binary.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/streaming.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Streaming benchmark
+
+    Writes Gaussian blobs to a binary file and clusters it out of core with several memory
+    budgets (32-bit and packed labels), next to the in-memory kmeans_paralelo on the same
+    points. Reports time per iteration, bytes read, read and effective throughput, the time the
+    threads waited for I/O and the inertia of the labels. The raw throughput of one sequential
+    pass over the file with the same reader is the reference for what the disk (or the page
+    cache, for files that fit in it) can deliver. Every streaming run must produce the same
+    labels whatever the budget or the label packing.
+
+    Usage: bench_streaming <num_points> <num_clusters> <dims> <max_iterations> <file> [budget_MB ...]
+*/
+
+// Sum of squared distances from every point to the mean of its cluster
+static double labels_inertia(const DatasetView& data, int k, const int* labels) {
+    const int dims = data.dims;
+    vector<double> means(k * dims, 0.0);
+    vector<long long int> sizes(k, 0);
+    for (long long int i = 0; i < data.numPoints; i++) {
+        sizes[labels[i]]++;
+        for (int d = 0; d < dims; d++) means[labels[i] * dims + d] += data.at(i, d);
+    }
+    for (int j = 0; j < k; j++) {
+        for (int d = 0; d < dims; d++) means[j * dims + d] /= sizes[j] > 0 ? sizes[j] : 1;
+    }
+    double total = 0.0;
+    for (long long int i = 0; i < data.numPoints; i++) {
+        for (int d = 0; d < dims; d++) {
+            double diff = data.at(i, d) - means[labels[i] * dims + d];
+            total += diff * diff;
+        }
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 6) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations> <file> [budget_MB ...]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+    const string file_name = argv[5];
+    vector<double> budgets;
+    for (int a = 6; a < argc; a++) budgets.push_back(atof(argv[a]));
+    if (budgets.empty()) budgets = {1e6, 64, 16};
+
+    // k blobs with centers in [0, 10)^dims
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, 1);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+    if (!save_binary(file_name, data)) return 1;
+
+    // Reference: one sequential pass with the same reader and block size as the smallest budget
+    BlockStream stream;
+    if (!stream.open(file_name)) return 1;
+    const long long int rawBlock = 1 << 20 < n ? 1 << 20 : n;
+    Dataset buffer(rawBlock, dims, LAYOUT_SOA);
+    double start = omp_get_wtime();
+    for (long long int begin = 0; begin < n; begin += rawBlock) {
+        stream.read(begin, begin + rawBlock < n ? rawBlock : n - begin, buffer);
+    }
+    const double rawSeconds = omp_get_wtime() - start;
+    const double fileMegabytes = sizeof(double) * n * dims / 1e6;
+    stream.close();
+
+    int* labels = new int[n];
+    for (long long int i = 0; i < n; i++) labels[i] = -1;
+    srand(7);
+    start = omp_get_wtime();
+    kmeans_paralelo(data, k, maxIterations, labels);
+    const double memoryTime = omp_get_wtime() - start;
+
+    cout << "Threads: " << omp_get_max_threads() << ", file " << fileMegabytes << " MB, sequential read "
+         << fileMegabytes / rawSeconds << " MB/s\n";
+    cout << "Mode,BudgetMB,LabelBits,Blocks,ResidentMB,Iterations,Time,ReadMBs,EffectiveMBs,WaitTime,Inertia\n";
+    cout << "memory,,32,,," << "," << memoryTime << ",,,," << labels_inertia(data, k, labels) << "\n";
+
+    vector<int> reference, current(n);
+    vector<double> centroids((size_t)k * dims);
+    bool same = true;
+    for (double budget : budgets) {
+        for (int packed = 0; packed < 2; packed++) {
+            StreamingOptions options;
+            options.memoryBudget = (size_t)(budget * (1 << 20));
+            options.compressLabels = packed == 1;
+            LabelStore store;
+            StreamingStats stats;
+            srand(7);
+            if (!kmeans_streaming(file_name, k, maxIterations, centroids.data(), store, options, &stats)) continue;
+
+            store.unpack(0, n, current.data());
+            if (reference.empty()) reference = current;
+            same = same && current == reference;
+            cout << "streaming," << budget << "," << store.bits() << "," << stats.numBlocks << ","
+                 << stats.residentBytes / 1e6 << "," << stats.iterations << "," << stats.totalSeconds << ","
+                 << stats.readMegabytesPerSecond() << "," << stats.effectiveMegabytesPerSecond() << ","
+                 << stats.waitSeconds << "," << labels_inertia(data, k, current.data()) << "\n";
+        }
+    }
+    cout << "Same labels for every budget: " << (same ? "yes" : "no") << "\n";
+
+    remove(file_name.c_str());
+    delete[] labels;
+    return same ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/trace.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Tracing benchmark
+
+    Runs kmeans_paralelo and kmeans_serial on the same points untraced and inside a
+    TraceScope, reports the time of each run and the phase totals of the trace (assignment,
+    reduction, update, mean and worst load imbalance), and writes the trace of both engines as
+    <prefix>.csv, <prefix>.json and <prefix>.trace.json (Chrome trace format). Build it twice
+    to see the cost of the hooks:
+        without -DKMEANS_TRACE the hooks are compiled out (nothing is recorded or written),
+        with -DKMEANS_TRACE the untraced run pays only for the checks of an inactive recorder.
+    Tracing must not change the labels.
+
+    Usage: bench_trace <num_points> <num_clusters> <dims> <max_iterations> <prefix>
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 6) {
+        cerr << "Usage: " << argv[0] << " <num_points> <num_clusters> <dims> <max_iterations> <prefix>\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int k = atoi(argv[2]);
+    const int dims = atoi(argv[3]);
+    const int maxIterations = atoi(argv[4]);
+    const string prefix = argv[5];
+
+    // k blobs with centers in [0, 10)^dims
+    const BlobMixture mixture(n, dims, k, 0.5, 10.0, 1);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+
+#ifdef KMEANS_TRACE
+    const bool compiled = true;
+#else
+    const bool compiled = false;
+#endif
+    cout << "Threads: " << omp_get_max_threads() << ", hooks " << (compiled ? "compiled in" : "compiled out") << "\n";
+
+    TraceRecorder trace;
+    vector<int> plain(n), traced(n);
+    bool same = true;
+    cout << "Engine,Mode,Time,Iterations,AssignSeconds,ReductionSeconds,UpdateSeconds,MeanImbalance,MaxImbalance\n";
+    for (int parallel = 1; parallel >= 0; parallel--) {
+        const string engine = parallel ? "parallel" : "serial";
+        auto run = [&](int* labels) {
+            for (long long int i = 0; i < n; i++) labels[i] = -1;
+            srand(7);
+            double start = omp_get_wtime();
+            if (parallel) {
+                kmeans_paralelo(data, k, maxIterations, labels);
+            } else {
+                kmeans_serial(data, k, maxIterations, labels);
+            }
+            return omp_get_wtime() - start;
+        };
+        const double plainTime = run(plain.data());
+        cout << engine << ",untraced," << plainTime << ",,,,,,\n";
+
+        const size_t first = trace.iterations().size();
+        double tracedTime;
+        {
+            TraceScope scope(trace);
+            tracedTime = run(traced.data());
+        }
+        same = same && plain == traced;
+
+        double assign = 0.0, reduction = 0.0, update = 0.0, imbalance = 0.0, worst = 0.0;
+        const size_t last = trace.iterations().size();
+        for (size_t i = first; i < last; i++) {
+            const TraceIteration& it = trace.iterations()[i];
+            assign += it.assignSeconds;
+            reduction += it.reductionSeconds;
+            update += it.updateSeconds;
+            imbalance += it.imbalance;
+            worst = it.imbalance > worst ? it.imbalance : worst;
+        }
+        const size_t iterations = last - first;
+        cout << engine << ",traced," << tracedTime << "," << iterations << "," << assign << "," << reduction << ","
+             << update << "," << (iterations > 0 ? imbalance / iterations : 0.0) << "," << worst << "\n";
+    }
+
+    if (compiled) {
+        if (!trace.write_csv(prefix + ".csv") || !trace.write_json(prefix + ".json") ||
+            !trace.write_chrome_trace(prefix + ".trace.json")) {
+            return 1;
+        }
+        cout << "Trace: " << prefix << ".csv, " << prefix << ".json, " << prefix << ".trace.json\n";
+    }
+    cout << "Same labels traced and untraced: " << (same ? "yes" : "no") << "\n";
+    return same ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/kmeans.h"
+#include "../kmeans/yinyang.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Yinyang benchmark
+
+    For every k in the list (10, 100, 1000 and 5000 by default) runs kmeans_paralelo (Lloyd) and
+    kmeans_yinyang from the same seed on Gaussian blobs, and reports both times, the label
+    mismatches, the mean fraction of distance computations skipped and the bound memory.
+    With one thread both engines sum the centroid updates in the same order, so the labels
+    must match exactly (the exit status is nonzero otherwise). With more threads the partial
+    sums of the late, incremental updates are split among the threads by Yinyang's per-point
+    schedule, so rounding can flip near ties: mismatches are reported but not an error.
+
+    Usage: bench_yinyang <num_points> <dims> <max_iterations> [groups (0 = k/10)] [seed] [k ...]
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <num_points> <dims> <max_iterations> [groups] [seed] [k ...]\n";
+        return 1;
+    }
+    const long long int n = atoll(argv[1]);
+    const int dims = atoi(argv[2]);
+    const int maxIterations = atoi(argv[3]);
+    const int groups = argc > 4 ? atoi(argv[4]) : 0;
+    const int seed = argc > 5 ? atoi(argv[5]) : 1;
+    vector<int> ks = {10, 100, 1000, 5000};
+    if (argc > 6) {
+        ks.clear();
+        for (int a = 6; a < argc; a++) ks.push_back(atoi(argv[a]));
+    }
+
+    // 100 blobs with centers in [0, 10)^dims
+    const int blobs = 100;
+    const BlobMixture mixture(n, dims, blobs, 0.5, 10.0, seed);
+    Dataset data(n, dims, LAYOUT_SOA);
+    mixture.fill(data);
+
+    int* lloydLabels = new int[n];
+    int* yinyangLabels = new int[n];
+    bool ok = true;
+    cout << "Threads: " << omp_get_max_threads() << "\n";
+    cout << "k,groups,iterations,LloydTime,YinyangTime,Speedup,Skipped,BoundMB,Mismatches\n";
+    for (int k : ks) {
+        if (k > n) continue;
+        const int t = groups > 0 ? groups : yinyang_default_groups(k);
+        for (long long int i = 0; i < n; i++) lloydLabels[i] = yinyangLabels[i] = -1;
+
+        srand(seed);
+        double start = omp_get_wtime();
+        kmeans_paralelo(data, k, maxIterations, lloydLabels);
+        double lloydTime = omp_get_wtime() - start;
+
+        srand(seed);
+        PruningStats stats;
+        start = omp_get_wtime();
+        kmeans_yinyang(data, k, maxIterations, yinyangLabels, t, &stats);
+        double yinyangTime = omp_get_wtime() - start;
+
+        long long int mismatches = 0;
+        for (long long int i = 0; i < n; i++) mismatches += lloydLabels[i] != yinyangLabels[i];
+        ok = ok && mismatches == 0;
+
+        cout << k << "," << t << "," << stats.iterations << "," << lloydTime << "," << yinyangTime << ","
+             << lloydTime / yinyangTime << "," << stats.meanSkipped() << "," << n * (t + 1) * 8 / 1e6 << ","
+             << mismatches << "\n";
+    }
+
+    delete[] yinyangLabels;
+    delete[] lloydLabels;
+    return ok || omp_get_max_threads() > 1 ? 0 : 1;
+}
@@ -0,0 +1,454 @@
+#ifndef KMEANS_ASSIGN_H
+#define KMEANS_ASSIGN_H
+
+#include <cmath>
+#include <limits>
+
+#include "dataset.h"
+#include "dims.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define KMEANS_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/*
+    Assignment kernels
+
+    Every kernel finds, for each point in [begin, end), the nearest centroid by comparing
+    squared distances (the sqrt does not change the argmin). The squared distance is always
+    evaluated in the same order, sum = d0*d0, sum = sum + d1*d1, ..., and ties keep the lowest
+    centroid id, so the AVX2 and AVX-512 paths produce exactly the same labels as the scalar
+    path. Contraction into FMA would break that, so it is disabled for this file.
+    Kernels are templated on the dimension (see dims.h) so the inner loop over coordinates
+    is fully unrolled for the common small dimensions.
+
+    Two vector strategies are used:
+        SoA data: 4 (AVX2) or 8 (AVX-512) points per register, centroids broadcast one by one
+                  (8 or 16 for float32 data, see dataset.h)
+        AoS data: 4 or 8 centroids per register, the point broadcast (only for k >= 2 registers)
+*/
+
+#if defined(__clang__)
+#define KMEANS_NO_CONTRACT _Pragma("clang fp contract(off)")
+#else
+#define KMEANS_NO_CONTRACT
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+enum SimdLevel { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512 };
+
+inline const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX512: return "avx512";
+        case SIMD_AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+// Best instruction set supported by the running CPU
+inline SimdLevel detect_simd_level() {
+#ifdef KMEANS_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+#endif
+    return SIMD_SCALAR;
+}
+
+// Level used by assign_block; detected once, can be forced lower (e.g. to compare paths)
+inline SimdLevel& active_simd_level() {
+    static SimdLevel level = detect_simd_level();
+    return level;
+}
+
+inline void set_simd_level(SimdLevel level) {
+    SimdLevel supported = detect_simd_level();
+    active_simd_level() = level > supported ? supported : level;
+}
+
+/*
+    Centroids in SoA form: coordinate d of centroid j is coords[d * stride + j], in the
+    coordinate type of the data. stride is k rounded up to a full 64-byte register (8 doubles or
+    16 floats) and the padding is NaN, so padded lanes never win a comparison.
+*/
+template <typename T>
+struct BasicCentroidTable {
+    static const int LANES = 64 / sizeof(T);
+
+    T* coords = nullptr;
+    int k = 0;
+    int dims = 0;
+    int stride = 0;
+
+    BasicCentroidTable(int k, int dims) : k(k), dims(dims), stride((k + LANES - 1) / LANES * LANES) {
+        coords = static_cast<T*>(aligned_malloc(sizeof(T) * stride * dims));
+        for (int i = 0; i < stride * dims; i++) coords[i] = std::numeric_limits<T>::quiet_NaN();
+    }
+    ~BasicCentroidTable() { aligned_free(coords); }
+
+    BasicCentroidTable(const BasicCentroidTable&) = delete;
+    BasicCentroidTable& operator=(const BasicCentroidTable&) = delete;
+
+    // Copies centroids stored point by point (centroid j at centroids[j * dims])
+    void load(const double* centroids) {
+        for (int j = 0; j < k; j++) {
+            for (int d = 0; d < dims; d++) {
+                coords[d * stride + j] = (T)centroids[j * dims + d];
+            }
+        }
+    }
+
+    T at(int j, int d) const { return coords[d * stride + j]; }
+};
+
+using CentroidTable = BasicCentroidTable<double>;
+using FloatCentroidTable = BasicCentroidTable<float>;
+
+/*
+    Scalar reference path, distances in the coordinate type. Returns the number of points whose
+    label changed.
+*/
+template <int D, typename T>
+inline long long int assign_block_scalar(const BasicDatasetView<T>& data, long long int begin, long long int end,
+                                         const BasicCentroidTable<T>& c, int* clusterAssignment) {
+    KMEANS_NO_CONTRACT
+    const int dims = dimensions<D>(c.dims);
+    long long int changed = 0;
+    for (long long int i = begin; i < end; i++) {
+        T minDist = 0;
+        int bestCluster = 0;
+        for (int j = 0; j < c.k; j++) {
+            T diff = data.at(i, 0) - c.at(j, 0);
+            T dist = diff * diff;
+            for (int d = 1; d < dims; d++) {
+                diff = data.at(i, d) - c.at(j, d);
+                dist = dist + diff * diff;
+            }
+            if (j == 0 || dist < minDist) {
+                minDist = dist;
+                bestCluster = j;
+            }
+        }
+        if (clusterAssignment[i] != bestCluster) {
+            clusterAssignment[i] = bestCluster;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+#ifdef KMEANS_X86_SIMD
+
+// Picks the lowest id among the lanes holding the minimum distance
+inline void reduce_lanes(const double* dist, const double* idx, int lanes, double& minDist, int& bestCluster) {
+    minDist = dist[0];
+    bestCluster = (int)idx[0];
+    for (int l = 1; l < lanes; l++) {
+        if (dist[l] < minDist || (dist[l] == minDist && (int)idx[l] < bestCluster)) {
+            minDist = dist[l];
+            bestCluster = (int)idx[l];
+        }
+    }
+}
+
+template <int D>
+__attribute__((target("avx2")))
+inline long long int assign_block_soa_avx2(const DatasetView& data, long long int begin, long long int end,
+                                           const CentroidTable& c, int* clusterAssignment) {
+    KMEANS_NO_CONTRACT
+    const int dims = dimensions<D>(c.dims);
+    long long int changed = 0;
+    long long int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m256d minDist = _mm256_setzero_pd();
+        __m256d bestCluster = _mm256_setzero_pd();
+        for (int j = 0; j < c.k; j++) {
+            __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(data.column(0) + i), _mm256_set1_pd(c.at(j, 0)));
+            __m256d dist = _mm256_mul_pd(diff, diff);
+            for (int d = 1; d < dims; d++) {
+                diff = _mm256_sub_pd(_mm256_loadu_pd(data.column(d) + i), _mm256_set1_pd(c.at(j, d)));
+                dist = _mm256_add_pd(dist, _mm256_mul_pd(diff, diff));
+            }
+            if (j == 0) {
+                minDist = dist;
+                continue;
+            }
+            __m256d closer = _mm256_cmp_pd(dist, minDist, _CMP_LT_OQ);
+            minDist = _mm256_blendv_pd(minDist, dist, closer);
+            bestCluster = _mm256_blendv_pd(bestCluster, _mm256_set1_pd((double)j), closer);
+        }
+        int labels[4];
+        _mm_storeu_si128((__m128i*)labels, _mm256_cvtpd_epi32(bestCluster));
+        for (int l = 0; l < 4; l++) {
+            if (clusterAssignment[i + l] != labels[l]) {
+                clusterAssignment[i + l] = labels[l];
+                changed++;
+            }
+        }
+    }
+    return changed + assign_block_scalar<D>(data, i, end, c, clusterAssignment);
+}
+
+template <int D>
+__attribute__((target("avx2")))
+inline long long int assign_block_aos_avx2(const DatasetView& data, long long int begin, long long int end,
+                                           const CentroidTable& c, int* clusterAssignment) {
+    KMEANS_NO_CONTRACT
+    const int dims = dimensions<D>(c.dims);
+    long long int changed = 0;
+    const __m256d step = _mm256_set1_pd(4.0);
+    for (long long int i = begin; i < end; i++) {
+        __m256d minDist = _mm256_setzero_pd();
+        __m256d bestCluster = _mm256_setzero_pd();
+        __m256d ids = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+        for (int j = 0; j < c.k; j += 4) {
+            __m256d diff = _mm256_sub_pd(_mm256_set1_pd(data.at(i, 0)), _mm256_load_pd(c.coords + j));
+            __m256d dist = _mm256_mul_pd(diff, diff);
+            for (int d = 1; d < dims; d++) {
+                diff = _mm256_sub_pd(_mm256_set1_pd(data.at(i, d)), _mm256_load_pd(c.coords + d * c.stride + j));
+                dist = _mm256_add_pd(dist, _mm256_mul_pd(diff, diff));
+            }
+            if (j == 0) {
+                minDist = dist;
+                bestCluster = ids;
+            } else {
+                __m256d closer = _mm256_cmp_pd(dist, minDist, _CMP_LT_OQ);
+                minDist = _mm256_blendv_pd(minDist, dist, closer);
+                bestCluster = _mm256_blendv_pd(bestCluster, ids, closer);
+            }
+            ids = _mm256_add_pd(ids, step);
+        }
+        double dists[4], idx[4];
+        _mm256_storeu_pd(dists, minDist);
+        _mm256_storeu_pd(idx, bestCluster);
+        double best;
+        int label;
+        reduce_lanes(dists, idx, 4, best, label);
+        if (clusterAssignment[i] != label) {
+            clusterAssignment[i] = label;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+template <int D>
+__attribute__((target("avx512f")))
+inline long long int assign_block_soa_avx512(const DatasetView& data, long long int begin, long long int end,
+                                             const CentroidTable& c, int* clusterAssignment) {
+    KMEANS_NO_CONTRACT
+    const int dims = dimensions<D>(c.dims);
+    long long int changed = 0;
+    long long int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m512d minDist = _mm512_setzero_pd();
+        __m512d bestCluster = _mm512_setzero_pd();
+        for (int j = 0; j < c.k; j++) {
+            __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(data.column(0) + i), _mm512_set1_pd(c.at(j, 0)));
+            __m512d dist = _mm512_mul_pd(diff, diff);
+            for (int d = 1; d < dims; d++) {
+                diff = _mm512_sub_pd(_mm512_loadu_pd(data.column(d) + i), _mm512_set1_pd(c.at(j, d)));
+                dist = _mm512_add_pd(dist, _mm512_mul_pd(diff, diff));
+            }
+            if (j == 0) {
+                minDist = dist;
+                continue;
+            }
+            __mmask8 closer = _mm512_cmp_pd_mask(dist, minDist, _CMP_LT_OQ);
+            minDist = _mm512_mask_blend_pd(closer, minDist, dist);
+            bestCluster = _mm512_mask_blend_pd(closer, bestCluster, _mm512_set1_pd((double)j));
+        }
+        double labels[8];
+        _mm512_storeu_pd(labels, bestCluster);
+        for (int l = 0; l < 8; l++) {
+            if (clusterAssignment[i + l] != (int)labels[l]) {
+                clusterAssignment[i + l] = (int)labels[l];
+                changed++;
+            }
+        }
+    }
+    return changed + assign_block_scalar<D>(data, i, end, c, clusterAssignment);
+}
+
+template <int D>
+__attribute__((target("avx512f")))
+inline long long int assign_block_aos_avx512(const DatasetView& data, long long int begin, long long int end,
+                                             const CentroidTable& c, int* clusterAssignment) {
+    KMEANS_NO_CONTRACT
+    const int dims = dimensions<D>(c.dims);
+    long long int changed = 0;
+    const __m512d step = _mm512_set1_pd(8.0);
+    for (long long int i = begin; i < end; i++) {
+        __m512d minDist = _mm512_setzero_pd();
+        __m512d bestCluster = _mm512_setzero_pd();
+        __m512d ids = _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0);
+        for (int j = 0; j < c.k; j += 8) {
+            __m512d diff = _mm512_sub_pd(_mm512_set1_pd(data.at(i, 0)), _mm512_load_pd(c.coords + j));
+            __m512d dist = _mm512_mul_pd(diff, diff);
+            for (int d = 1; d < dims; d++) {
+                diff = _mm512_sub_pd(_mm512_set1_pd(data.at(i, d)), _mm512_load_pd(c.coords + d * c.stride + j));
+                dist = _mm512_add_pd(dist, _mm512_mul_pd(diff, diff));
+            }
+            if (j == 0) {
+                minDist = dist;
+                bestCluster = ids;
+            } else {
+                __mmask8 closer = _mm512_cmp_pd_mask(dist, minDist, _CMP_LT_OQ);
+                minDist = _mm512_mask_blend_pd(closer, minDist, dist);
+                bestCluster = _mm512_mask_blend_pd(closer, bestCluster, ids);
+            }
+            ids = _mm512_add_pd(ids, step);
+        }
+        double dists[8], idx[8];
+        _mm512_storeu_pd(dists, minDist);
+        _mm512_storeu_pd(idx, bestCluster);
+        double best;
+        int label;
+        reduce_lanes(dists, idx, 8, best, label);
+        if (clusterAssignment[i] != label) {
+            clusterAssignment[i] = label;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+/*
+    float32 SoA paths: 8 (AVX2) or 16 (AVX-512) points per register. Labels are carried as
+    floats, exact for any k below 2^24. AoS float data uses the scalar path.
+*/
+template <int D>
+__attribute__((target("avx2")))
+inline long long int assign_block_soa_avx2(const FloatDatasetView& data, long long int begin, long long int end,
+                                           const FloatCentroidTable& c, int* clusterAssignment) {
+    KMEANS_NO_CONTRACT
+    const int dims = dimensions<D>(c.dims);
+    long long int changed = 0;
+    long long int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 minDist = _mm256_setzero_ps();
+        __m256 bestCluster = _mm256_setzero_ps();
+        for (int j = 0; j < c.k; j++) {
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(data.column(0) + i), _mm256_set1_ps(c.at(j, 0)));
+            __m256 dist = _mm256_mul_ps(diff, diff);
+            for (int d = 1; d < dims; d++) {
+                diff = _mm256_sub_ps(_mm256_loadu_ps(data.column(d) + i), _mm256_set1_ps(c.at(j, d)));
+                dist = _mm256_add_ps(dist, _mm256_mul_ps(diff, diff));
+            }
+            if (j == 0) {
+                minDist = dist;
+                continue;
+            }
+            __m256 closer = _mm256_cmp_ps(dist, minDist, _CMP_LT_OQ);
+            minDist = _mm256_blendv_ps(minDist, dist, closer);
+            bestCluster = _mm256_blendv_ps(bestCluster, _mm256_set1_ps((float)j), closer);
+        }
+        int labels[8];
+        _mm256_storeu_si256((__m256i*)labels, _mm256_cvtps_epi32(bestCluster));
+        for (int l = 0; l < 8; l++) {
+            if (clusterAssignment[i + l] != labels[l]) {
+                clusterAssignment[i + l] = labels[l];
+                changed++;
+            }
+        }
+    }
+    return changed + assign_block_scalar<D>(data, i, end, c, clusterAssignment);
+}
+
+template <int D>
+__attribute__((target("avx512f")))
+inline long long int assign_block_soa_avx512(const FloatDatasetView& data, long long int begin, long long int end,
+                                             const FloatCentroidTable& c, int* clusterAssignment) {
+    KMEANS_NO_CONTRACT
+    const int dims = dimensions<D>(c.dims);
+    long long int changed = 0;
+    long long int i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m512 minDist = _mm512_setzero_ps();
+        __m512 bestCluster = _mm512_setzero_ps();
+        for (int j = 0; j < c.k; j++) {
+            __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(data.column(0) + i), _mm512_set1_ps(c.at(j, 0)));
+            __m512 dist = _mm512_mul_ps(diff, diff);
+            for (int d = 1; d < dims; d++) {
+                diff = _mm512_sub_ps(_mm512_loadu_ps(data.column(d) + i), _mm512_set1_ps(c.at(j, d)));
+                dist = _mm512_add_ps(dist, _mm512_mul_ps(diff, diff));
+            }
+            if (j == 0) {
+                minDist = dist;
+                continue;
+            }
+            __mmask16 closer = _mm512_cmp_ps_mask(dist, minDist, _CMP_LT_OQ);
+            minDist = _mm512_mask_blend_ps(closer, minDist, dist);
+            bestCluster = _mm512_mask_blend_ps(closer, bestCluster, _mm512_set1_ps((float)j));
+        }
+        float labels[16];
+        _mm512_storeu_ps(labels, bestCluster);
+        for (int l = 0; l < 16; l++) {
+            if (clusterAssignment[i + l] != (int)labels[l]) {
+                clusterAssignment[i + l] = (int)labels[l];
+                changed++;
+            }
+        }
+    }
+    return changed + assign_block_scalar<D>(data, i, end, c, clusterAssignment);
+}
+
+#endif
+
+/*
+    Assigns points [begin, end) with the best available kernel.
+    Returns the number of points whose label changed.
+*/
+template <int D>
+inline long long int assign_block(const DatasetView& data, long long int begin, long long int end,
+                                  const CentroidTable& c, int* clusterAssignment) {
+#ifdef KMEANS_X86_SIMD
+    // With AoS data the per-point lane reduction only pays off for enough centroids
+    const bool soa = data.pointStride == 1;
+    switch (active_simd_level()) {
+        case SIMD_AVX512:
+            if (soa) return assign_block_soa_avx512<D>(data, begin, end, c, clusterAssignment);
+            if (c.k >= 16) return assign_block_aos_avx512<D>(data, begin, end, c, clusterAssignment);
+            break;
+        case SIMD_AVX2:
+            if (soa) return assign_block_soa_avx2<D>(data, begin, end, c, clusterAssignment);
+            if (c.k >= 8) return assign_block_aos_avx2<D>(data, begin, end, c, clusterAssignment);
+            break;
+        default:
+            break;
+    }
+#endif
+    return assign_block_scalar<D>(data, begin, end, c, clusterAssignment);
+}
+
+template <int D>
+inline long long int assign_block(const FloatDatasetView& data, long long int begin, long long int end,
+                                  const FloatCentroidTable& c, int* clusterAssignment) {
+#ifdef KMEANS_X86_SIMD
+    if (data.pointStride == 1) {
+        switch (active_simd_level()) {
+            case SIMD_AVX512: return assign_block_soa_avx512<D>(data, begin, end, c, clusterAssignment);
+            case SIMD_AVX2: return assign_block_soa_avx2<D>(data, begin, end, c, clusterAssignment);
+            default: break;
+        }
+    }
+#endif
+    return assign_block_scalar<D>(data, begin, end, c, clusterAssignment);
+}
+
+// Same as above, picking the dimension specialization at runtime (one switch per call)
+template <typename T>
+inline long long int assign_block(const BasicDatasetView<T>& data, long long int begin, long long int end,
+                                  const BasicCentroidTable<T>& c, int* clusterAssignment) {
+    return dispatch_dims(c.dims, [&](auto dim) {
+        return assign_block<decltype(dim)::value>(data, begin, end, c, clusterAssignment);
+    });
+}
+
+#if !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
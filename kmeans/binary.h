@@ -0,0 +1,183 @@
+#ifndef KMEANS_BINARY_H
+#define KMEANS_BINARY_H
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "dataset.h"
+#include "mapped_file.h"
+
+/*
+    Binary columnar data set format
+
+    A fixed header followed by one block per dimension (SoA), the same layout as a
+    LAYOUT_SOA Dataset:
+
+        offset 0            BinaryHeader (padded with zeros up to dataOffset)
+        dataOffset          column 0: numPoints values, zero padded up to columnStride values
+        + columnStride*8    column 1
+        ...
+
+    dataOffset and the column size in bytes are multiples of the alignment, and a mapping
+    always starts on a page boundary, so every column of a mapped file is aligned and can
+    be handed to the engines as a DatasetView with no copy.
+    All fields are little endian.
+*/
+
+const char BINARY_MAGIC[8] = {'K', 'M', 'E', 'A', 'N', 'S', 'B', '\0'};
+const uint32_t BINARY_VERSION = 1;
+
+enum BinaryDtype : uint32_t { DTYPE_FLOAT64 = 1 };
+
+struct BinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint64_t numPoints;
+    uint32_t dims;
+    uint32_t alignment;
+    uint64_t dataOffset;    // bytes from the start of the file to column 0
+    uint64_t columnStride;  // values between the start of two consecutive columns
+};
+
+/*
+    Writes the header (padded up to dataOffset) of a file with numPoints points of dims
+    dimensions and returns it; the columns follow, each padded to header.columnStride values.
+    Used by save_binary and by writers that produce the columns without a Dataset.
+*/
+inline BinaryHeader write_binary_header(std::ostream& out, long long int numPoints, int dims,
+                                        uint32_t alignment = DATASET_ALIGNMENT) {
+    const uint64_t perLine = alignment / sizeof(double);
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_VERSION;
+    header.dtype = DTYPE_FLOAT64;
+    header.numPoints = numPoints;
+    header.dims = dims;
+    header.alignment = alignment;
+    header.dataOffset = (sizeof(BinaryHeader) + alignment - 1) / alignment * alignment;
+    header.columnStride = (numPoints + perLine - 1) / perLine * perLine;
+
+    std::vector<char> padding(header.dataOffset, 0);
+    memcpy(padding.data(), &header, sizeof(header));
+    out.write(padding.data(), padding.size());
+    return header;
+}
+
+/*
+    Writing a data set (any layout) to a binary file
+*/
+inline bool save_binary(std::string file_name, const DatasetView& data, uint32_t alignment = DATASET_ALIGNMENT) {
+    std::ofstream out(file_name, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+
+    const BinaryHeader header = write_binary_header(out, data.numPoints, data.dims, alignment);
+
+    // Columns are written in blocks so AoS data doesn't need a full transposed copy
+    const long long int block = 1 << 16;
+    std::vector<double> buffer(block);
+    for (int d = 0; d < data.dims; d++) {
+        if (data.pointStride == 1) {
+            out.write((const char*)data.column(d), sizeof(double) * data.numPoints);
+        } else {
+            for (long long int begin = 0; begin < data.numPoints; begin += block) {
+                long long int end = begin + block < data.numPoints ? begin + block : data.numPoints;
+                for (long long int i = begin; i < end; i++) buffer[i - begin] = data.at(i, d);
+                out.write((const char*)buffer.data(), sizeof(double) * (end - begin));
+            }
+        }
+        std::vector<double> tail(header.columnStride - data.numPoints, 0.0);
+        out.write((const char*)tail.data(), sizeof(double) * tail.size());
+    }
+
+    if (!out) {
+        std::cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    return true;
+}
+
+/*
+    Validates a header read from a file of fileSize bytes. Returns nullptr when it is valid
+    and the reason otherwise.
+*/
+inline const char* check_binary_header(const BinaryHeader& header, uint64_t fileSize) {
+    if (memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) return "bad magic";
+    if (header.version != BINARY_VERSION) return "unsupported version";
+    if (header.dtype != DTYPE_FLOAT64) return "unsupported dtype";
+    if (header.dims == 0 || header.dims > INT_MAX || header.columnStride < header.numPoints) return "bad shape";
+    if (header.alignment == 0 || header.dataOffset % sizeof(double) != 0) return "bad alignment";
+    // dataOffset + columnStride * dims * sizeof(double) <= fileSize, without overflowing
+    if (header.dataOffset > fileSize) return "truncated data";
+    const uint64_t dataBytes = fileSize - header.dataOffset;
+    if (header.columnStride > dataBytes / sizeof(double) / header.dims) return "truncated data";
+    return nullptr;
+}
+
+/*
+    Read-only data set backed by a memory mapped binary file. view() points straight into
+    the mapping, so opening costs the same regardless of the number of points; pages are
+    read from disk (or the page cache) the first time the engines touch them.
+*/
+class BinaryDataset {
+public:
+    BinaryDataset() {}
+
+    BinaryDataset(const BinaryDataset&) = delete;
+    BinaryDataset& operator=(const BinaryDataset&) = delete;
+
+    // Returns false (after reporting it) if the file is missing or not a valid binary data set
+    bool open(std::string file_name) {
+        view_ = DatasetView();
+        if (!file_.open(file_name)) {
+            std::cerr << "Couldn't read file: " << file_name << "\n";
+            return false;
+        }
+
+        BinaryHeader header;
+        if (file_.size() < sizeof(header)) return invalid(file_name, "truncated header");
+        memcpy(&header, file_.data(), sizeof(header));
+        const char* reason = check_binary_header(header, file_.size());
+        if (reason != nullptr) return invalid(file_name, reason);
+
+        view_.values = reinterpret_cast<const double*>(file_.data() + header.dataOffset);
+        view_.numPoints = header.numPoints;
+        view_.dims = header.dims;
+        view_.pointStride = 1;
+        view_.dimStride = header.columnStride;
+        view_.layout = LAYOUT_SOA;
+        return true;
+    }
+
+    void close() {
+        file_.close();
+        view_ = DatasetView();
+    }
+
+    long long int size() const { return view_.numPoints; }
+    int dims() const { return view_.dims; }
+
+    const DatasetView& view() const { return view_; }
+    operator DatasetView() const { return view_; }
+
+private:
+    bool invalid(const std::string& file_name, const char* reason) {
+        std::cerr << "Invalid binary data set (" << reason << "): " << file_name << "\n";
+        close();
+        return false;
+    }
+
+    MappedFile file_;
+    DatasetView view_;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef KMEANS_CSV_H
+#define KMEANS_CSV_H
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "mapped_file.h"
+
+/*
+    CSV management functions
+
+    Number of comma separated columns in the first line of the file (0 if it can't be read).
+    Used to size the Dataset and to pick the dimension specialization of the engines.
+*/
+inline int CSV_dimensions(std::string file_name) {
+    std::ifstream in(file_name);
+    std::string line;
+    if (!in || !getline(in, line)) {
+        std::cerr << "Couldn't read file: " << file_name << "\n";
+        return 0;
+    }
+    int dims = 1;
+    for (char c : line) {
+        if (c == ',') dims++;
+    }
+    return dims;
+}
+
+/*
+    Number of lines of the file (a last line without newline also counts), -1 if it can't be
+    read. Used to size the Dataset when the number of points isn't known in advance.
+*/
+inline long long int CSV_rows(std::string file_name) {
+    MappedFile file;
+    if (!file.open(file_name)) {
+        std::cerr << "Couldn't read file: " << file_name << "\n";
+        return -1;
+    }
+    const char* p = file.data();
+    const char* end = p + file.size();
+    long long int rows = 0;
+    while (p < end) {
+        const char* nl = (const char*)memchr(p, '\n', end - p);
+        rows++;
+        p = nl ? nl + 1 : end;
+    }
+    return rows;
+}
+
+/*
+    Parse statistics reported by load_CSV
+*/
+struct CSVLoadStats {
+    long long int rows = 0;
+    size_t bytes = 0;
+    double seconds = 0.0;
+
+    double megabytesPerSecond() const { return seconds > 0.0 ? bytes / 1e6 / seconds : 0.0; }
+};
+
+// Parses one line [p, end) with dims comma separated numbers. Returns false if malformed.
+inline bool parse_CSV_line(const char* p, const char* end, int dims, double* values, long long int stride) {
+    for (int d = 0; d < dims; d++) {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (d > 0) {
+            if (p == end || *p != ',') return false;
+            p++;
+            while (p < end && (*p == ' ' || *p == '\t')) p++;
+        }
+        if (p < end && *p == '+') p++;
+        std::from_chars_result result = std::from_chars(p, end, values[d * stride]);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+    }
+    // Extra columns are ignored, as with the stream based reader
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p == end || *p == ',';
+}
+
+/*
+    Parses the CSV text [text, text + size) into a contiguous data set. Reads at most
+    points.size() rows of points.dims() columns each.
+
+    The text is split into newline-aligned chunks. A first parallel pass counts the lines of
+    every chunk so each one knows the row it starts at, and a second pass parses the chunks in
+    parallel with std::from_chars straight into the data set.
+    Returns the number of rows in the text, or -1 (after reporting it) if a line is malformed.
+*/
+inline long long int parse_CSV_text(const char* text, size_t size, Dataset& points, const std::string& file_name) {
+    const int dims = points.dims();
+
+    // Newline-aligned chunk boundaries
+    const size_t minChunk = 1 << 20;
+    long long int numChunks = (long long int)omp_get_max_threads() * 8;
+    if ((long long int)(size / minChunk) < numChunks) numChunks = size / minChunk;
+    if (numChunks < 1) numChunks = 1;
+    std::vector<size_t> bounds(numChunks + 1);
+    bounds[0] = 0;
+    bounds[numChunks] = size;
+    for (long long int c = 1; c < numChunks; c++) {
+        size_t pos = size * c / numChunks;
+        if (pos < bounds[c - 1]) pos = bounds[c - 1];
+        const void* nl = pos < size ? memchr(text + pos, '\n', size - pos) : nullptr;
+        bounds[c] = nl ? (const char*)nl - text + 1 : size;
+    }
+
+    // Pass 1: lines per chunk, turned into the first row of each chunk
+    std::vector<long long int> firstRow(numChunks + 1, 0);
+    #pragma omp parallel for schedule(static)
+    for (long long int c = 0; c < numChunks; c++) {
+        long long int lines = 0;
+        const char* p = text + bounds[c];
+        const char* end = text + bounds[c + 1];
+        while (p < end) {
+            const char* nl = (const char*)memchr(p, '\n', end - p);
+            lines++;
+            p = nl ? nl + 1 : end;
+        }
+        firstRow[c + 1] = lines;
+    }
+    for (long long int c = 0; c < numChunks; c++) firstRow[c + 1] += firstRow[c];
+
+    // Pass 2: parse every chunk into its rows
+    long long int malformedLine = -1;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long int c = 0; c < numChunks; c++) {
+        long long int row = firstRow[c];
+        const char* p = text + bounds[c];
+        const char* end = text + bounds[c + 1];
+        while (p < end && row < points.size()) {
+            const char* nl = (const char*)memchr(p, '\n', end - p);
+            const char* lineEnd = nl ? nl : end;
+            if (!parse_CSV_line(p, lineEnd, dims, &points.at(row, 0), points.dimStride())) {
+                #pragma omp critical
+                {
+                    if (malformedLine < 0 || row < malformedLine) malformedLine = row;
+                }
+                break;
+            }
+            row++;
+            p = nl ? nl + 1 : end;
+        }
+    }
+
+    if (malformedLine >= 0) {
+        std::cerr << "Malformed line " << malformedLine + 1 << " in file: " << file_name << "\n";
+        return -1;
+    }
+    return firstRow[numChunks];
+}
+
+/*
+    Reading data from a CSV file into a contiguous data set. Reads at most points.size() rows
+    of points.dims() columns each. The file is memory mapped and parsed with parse_CSV_text.
+    Returns false (after reporting it) if the file is missing or a line is malformed.
+*/
+inline bool load_CSV(std::string file_name, Dataset& points, CSVLoadStats* stats = nullptr) {
+    double start = omp_get_wtime();
+    MappedFile file;
+    if (!file.open(file_name)) {
+        std::cerr << "Couldn't read file: " << file_name << "\n";
+        return false;
+    }
+
+    long long int rows = parse_CSV_text(file.data(), file.size(), points, file_name);
+    if (rows < 0) return false;
+
+    if (stats != nullptr) {
+        stats->rows = rows < points.size() ? rows : points.size();
+        stats->bytes = file.size();
+        stats->seconds = omp_get_wtime() - start;
+    }
+    return true;
+}
+
+/*
+    Writing results
+
+    RESULTS_CSV            the coordinates of every point followed by its cluster id (x,y,...,label)
+    RESULTS_LABELS         one cluster id per line
+    RESULTS_BINARY_LABELS  the cluster ids as raw 32-bit integers (n * 4 bytes, native byte order)
+*/
+enum ResultFormat { RESULTS_CSV, RESULTS_LABELS, RESULTS_BINARY_LABELS };
+
+// Points formatted per chunk; each thread formats whole chunks into its own buffer
+const long long int WRITE_CHUNK = 1 << 15;
+
+/*
+    Formats points [begin, end) as text into out (cleared first). With a position array (see
+    reorder.h) row i is point position[i] of data, so reordered results come out in file order.
+*/
+inline void format_results(const DatasetView& data, const int* clusterAssignment, long long int begin,
+                           long long int end, bool coordinates, std::vector<char>& out,
+                           const long long int* position = nullptr) {
+    // Shortest round trip double is at most 24 characters, an int at most 11
+    const size_t perPoint = (coordinates ? data.dims * 25 : 0) + 12;
+    out.resize((end - begin) * perPoint);
+    char* p = out.data();
+    char* last = out.data() + out.size();
+    for (long long int row = begin; row < end; row++) {
+        const long long int i = position != nullptr ? position[row] : row;
+        if (coordinates) {
+            for (int d = 0; d < data.dims; d++) {
+                p = std::to_chars(p, last, data.at(i, d)).ptr;
+                *p++ = ',';
+            }
+        }
+        p = std::to_chars(p, last, clusterAssignment[i]).ptr;
+        *p++ = '\n';
+    }
+    out.resize(p - out.data());
+}
+
+/*
+    Writes the result of a run. Text formats are produced with std::to_chars in parallel,
+    one chunk per thread at a time, and the formatted chunks are written in order with one
+    large sequential write per round. position, when given, maps every original point to its
+    index in data (SpatialOrder::position()) so the rows keep the original order. Returns false
+    (after reporting it) if the file can't be written.
+*/
+inline bool save_results(std::string file_name, const DatasetView& data, const int* clusterAssignment,
+                         ResultFormat format = RESULTS_CSV, const long long int* position = nullptr) {
+    std::ofstream out(file_name, std::ios::binary);
+
+    if (!out.is_open()){
+        // Priting message of unsucessful open file
+        std::cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+
+    if (format == RESULTS_BINARY_LABELS && position == nullptr) {
+        out.write((const char*)clusterAssignment, sizeof(int) * data.numPoints);
+    } else if (format == RESULTS_BINARY_LABELS) {
+        std::vector<int> labels(WRITE_CHUNK);
+        for (long long int begin = 0; begin < data.numPoints; begin += WRITE_CHUNK) {
+            const long long int end = begin + WRITE_CHUNK < data.numPoints ? begin + WRITE_CHUNK : data.numPoints;
+            #pragma omp parallel for schedule(static)
+            for (long long int row = begin; row < end; row++) labels[row - begin] = clusterAssignment[position[row]];
+            out.write((const char*)labels.data(), sizeof(int) * (end - begin));
+        }
+    } else {
+        const bool coordinates = format == RESULTS_CSV;
+        const long long int numChunks = (data.numPoints + WRITE_CHUNK - 1) / WRITE_CHUNK;
+        const long long int perRound = omp_get_max_threads();
+        std::vector<std::vector<char>> buffers(perRound);
+
+        for (long long int first = 0; first < numChunks; first += perRound) {
+            const long long int count = first + perRound < numChunks ? perRound : numChunks - first;
+
+            #pragma omp parallel for schedule(static, 1)
+            for (long long int c = 0; c < count; c++) {
+                long long int begin = (first + c) * WRITE_CHUNK;
+                long long int end = begin + WRITE_CHUNK < data.numPoints ? begin + WRITE_CHUNK : data.numPoints;
+                format_results(data, clusterAssignment, begin, end, coordinates, buffers[c], position);
+            }
+
+            for (long long int c = 0; c < count; c++) {
+                out.write(buffers[c].data(), buffers[c].size());
+            }
+        }
+    }
+
+    out.close();
+    if (!out) {
+        std::cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    return true;
+}
+
+/*
+    Writing data to a CSV file (in the original order when given the position of a reordering)
+*/
+inline void save_to_CSV(std::string file_name, const DatasetView& data, const int* clusterAssignment,
+                        const long long int* position = nullptr) {
+    save_results(file_name, data, clusterAssignment, RESULTS_CSV, position);
+}
+
+#endif
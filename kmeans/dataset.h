@@ -0,0 +1,211 @@
+#ifndef KMEANS_DATASET_H
+#define KMEANS_DATASET_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+/*
+    Contiguous point storage
+
+    Every coordinate of a data set lives in a single aligned block instead of one heap
+    allocation per point. Two layouts are available:
+        LAYOUT_SOA  structure of arrays, one column per dimension   x0 x1 ... | y0 y1 ...
+        LAYOUT_AOS  interleaved array of structures                 x0 y0 | x1 y1 | ...
+    Coordinate (i, j) is always at values[i * pointStride + j * dimStride], so the k-means
+    kernels are written once and work with either layout.
+
+    The containers are templated on the coordinate type. Dataset / DatasetView hold doubles;
+    FloatDataset / FloatDatasetView store float32 coordinates, half the memory traffic and twice
+    the SIMD lanes, for data that doesn't need more than ~7 significant digits (the engines
+    still accumulate the centroid sums in double, see kmeans.h).
+
+    A new data set is zeroed in parallel, DATASET_BLOCK points at a time with the static
+    schedule the engines use for their point loops, so on a NUMA machine every page is first
+    touched, and placed, by the thread that will read it (as long as the data set is created
+    with the same number of OMP threads as the runs, see numa.h).
+*/
+
+const size_t DATASET_ALIGNMENT = 64;
+
+// Points per block of the first touch; the engines hand the same blocks to their threads
+const long long int DATASET_BLOCK = 1024;
+
+enum Layout { LAYOUT_SOA, LAYOUT_AOS };
+
+// alignment must be a power of two multiple of sizeof(void*)
+inline void* aligned_malloc(size_t bytes, size_t alignment = DATASET_ALIGNMENT) {
+    if (bytes == 0) bytes = alignment;
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(bytes, alignment);
+    if (ptr == nullptr) throw std::bad_alloc();
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, bytes) != 0) throw std::bad_alloc();
+#endif
+    return ptr;
+}
+
+inline void aligned_free(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+/*
+    Non-owning, read-only view over a data set. This is what the k-means engines receive.
+*/
+template <typename T>
+struct BasicDatasetView {
+    using value_type = T;
+
+    const T* values = nullptr;
+    long long int numPoints = 0;
+    int dims = 0;
+    long long int pointStride = 0;
+    long long int dimStride = 0;
+    Layout layout = LAYOUT_SOA;
+
+    T at(long long int i, int j) const { return values[i * pointStride + j * dimStride]; }
+
+    // Only meaningful for LAYOUT_SOA: pointer to the j-th coordinate column
+    const T* column(int j) const { return values + j * dimStride; }
+
+    // Only meaningful for LAYOUT_AOS: pointer to the coordinates of point i
+    const T* point(long long int i) const { return values + i * pointStride; }
+};
+
+/*
+    Owning data set. Columns (SoA) are padded to a multiple of the alignment so every
+    column starts on a cache line boundary.
+*/
+template <typename T>
+class BasicDataset {
+public:
+    BasicDataset() {}
+
+    BasicDataset(long long int numPoints, int dims, Layout layout = LAYOUT_SOA)
+        : numPoints_(numPoints), dims_(dims), layout_(layout) {
+        const long long int perLine = DATASET_ALIGNMENT / sizeof(T);
+        if (layout == LAYOUT_SOA) {
+            capacity_ = (numPoints + perLine - 1) / perLine * perLine;
+            pointStride_ = 1;
+            dimStride_ = capacity_;
+            valueCount_ = capacity_ * dims;
+        } else {
+            capacity_ = numPoints;
+            pointStride_ = dims;
+            dimStride_ = 1;
+            valueCount_ = numPoints * dims;
+        }
+        values_ = static_cast<T*>(aligned_malloc(valueCount_ * sizeof(T)));
+        first_touch();
+    }
+
+    ~BasicDataset() { aligned_free(values_); }
+
+    BasicDataset(const BasicDataset&) = delete;
+    BasicDataset& operator=(const BasicDataset&) = delete;
+
+    BasicDataset(BasicDataset&& other) noexcept { swap(other); }
+    BasicDataset& operator=(BasicDataset&& other) noexcept {
+        if (this != &other) {
+            BasicDataset empty;
+            swap(empty);
+            swap(other);
+        }
+        return *this;
+    }
+
+    long long int size() const { return numPoints_; }
+    int dims() const { return dims_; }
+    Layout layout() const { return layout_; }
+    long long int pointStride() const { return pointStride_; }
+    long long int dimStride() const { return dimStride_; }
+
+    T* data() { return values_; }
+    const T* data() const { return values_; }
+
+    T& at(long long int i, int j) { return values_[i * pointStride_ + j * dimStride_]; }
+    T at(long long int i, int j) const { return values_[i * pointStride_ + j * dimStride_]; }
+
+    T* column(int j) { return values_ + j * dimStride_; }
+    T* point(long long int i) { return values_ + i * pointStride_; }
+
+    BasicDatasetView<T> view() const {
+        BasicDatasetView<T> v;
+        v.values = values_;
+        v.numPoints = numPoints_;
+        v.dims = dims_;
+        v.pointStride = pointStride_;
+        v.dimStride = dimStride_;
+        v.layout = layout_;
+        return v;
+    }
+
+    operator BasicDatasetView<T>() const { return view(); }
+
+private:
+    // Zeroes the values block by block: a block is a range of every column (SoA) or a range of
+    // whole points (AoS), so each thread touches the pages of the points it will be assigned
+    void first_touch() {
+        const long long int numBlocks = (capacity_ + DATASET_BLOCK - 1) / DATASET_BLOCK;
+        const int numColumns = layout_ == LAYOUT_SOA ? dims_ : 1;
+        const long long int columnValues = layout_ == LAYOUT_SOA ? capacity_ : valueCount_;
+        const long long int blockValues = layout_ == LAYOUT_SOA ? DATASET_BLOCK : DATASET_BLOCK * dims_;
+        T* values = values_;
+        const long long int columnStride = dimStride_;
+        #pragma omp parallel for schedule(static)
+        for (long long int b = 0; b < numBlocks; b++) {
+            const long long int begin = b * blockValues;
+            const long long int end = begin + blockValues < columnValues ? begin + blockValues : columnValues;
+            for (int c = 0; c < numColumns; c++) {
+                memset(values + c * columnStride + begin, 0, sizeof(T) * (end - begin));
+            }
+        }
+    }
+
+    void swap(BasicDataset& other) {
+        std::swap(values_, other.values_);
+        std::swap(numPoints_, other.numPoints_);
+        std::swap(dims_, other.dims_);
+        std::swap(layout_, other.layout_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(pointStride_, other.pointStride_);
+        std::swap(dimStride_, other.dimStride_);
+        std::swap(valueCount_, other.valueCount_);
+    }
+
+    T* values_ = nullptr;
+    long long int numPoints_ = 0;
+    int dims_ = 0;
+    Layout layout_ = LAYOUT_SOA;
+    long long int capacity_ = 0;
+    long long int pointStride_ = 0;
+    long long int dimStride_ = 0;
+    long long int valueCount_ = 0;
+};
+
+using DatasetView = BasicDatasetView<double>;
+using FloatDatasetView = BasicDatasetView<float>;
+using Dataset = BasicDataset<double>;
+using FloatDataset = BasicDataset<float>;
+
+/*
+    Copy of a data set with another coordinate type (e.g. double to float32), same layout.
+*/
+template <typename T, typename S>
+inline BasicDataset<T> convert_dataset(const BasicDatasetView<S>& data) {
+    BasicDataset<T> converted(data.numPoints, data.dims, data.layout);
+    for (int d = 0; d < data.dims; d++) {
+        #pragma omp parallel for schedule(static)
+        for (long long int i = 0; i < data.numPoints; i++) converted.at(i, d) = (T)data.at(i, d);
+    }
+    return converted;
+}
+
+#endif
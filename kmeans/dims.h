@@ -0,0 +1,36 @@
+#ifndef KMEANS_DIMS_H
+#define KMEANS_DIMS_H
+
+#include <type_traits>
+
+/*
+    Compile-time dimension specialization
+
+    Kernels take a template parameter D: the number of coordinates per point when it is known
+    at compile time, or 0 to read it at runtime. dispatch_dims() picks the specialization once,
+    so the hot loops of the common small dimensions are fully unrolled.
+*/
+
+template <int D>
+using Dim = std::integral_constant<int, D>;
+
+// Number of coordinates for specialization D (runtime value when D == 0)
+template <int D>
+inline int dimensions(int runtimeDims) {
+    return D > 0 ? D : runtimeDims;
+}
+
+// Calls f(Dim<D>()) with the specialization matching dims
+template <typename F>
+inline auto dispatch_dims(int dims, F&& f) {
+    switch (dims) {
+        case 2: return f(Dim<2>());
+        case 3: return f(Dim<3>());
+        case 4: return f(Dim<4>());
+        case 8: return f(Dim<8>());
+        case 16: return f(Dim<16>());
+        default: return f(Dim<0>());
+    }
+}
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef KMEANS_DISTRIBUTED_H
+#define KMEANS_DISTRIBUTED_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mpi.h>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "assign.h"
+#include "csv.h"
+#include "init.h"
+#include "kmeans.h"
+#include "mapped_file.h"
+#include "reduction.h"
+#include "random.h"
+#include "streaming.h"
+
+/*
+    DISTRIBUTED (MPI + OMP)
+
+    Lloyd iterations over a data set split in contiguous shards, one per MPI rank. Every rank
+    loads only its rows (a block of rows of the binary file, or a byte range of the CSV file
+    moved to line boundaries), labels and accumulates them with the same single-sweep OMP kernel
+    as kmeans_paralelo (lloyd_sweep) and the k sums and sizes of every rank are added up with
+    one MPI_Allreduce of the sums and one of the sizes together with the reassigned count, so
+    every rank moves the centroids and decides convergence on the same global values.
+
+    The initialization sample is chosen by global row index with the counter-based generator
+    and gathered on rank 0 in row order, and the seed is the one of rank 0, so the centroids
+    and the labels don't depend on the number of ranks (only the order of the floating point
+    additions of the sums does).
+
+    Requires MPI_Init (or MPI_Init_thread with MPI_THREAD_FUNNELED): MPI is only called from
+    the master thread, outside of the parallel regions.
+*/
+
+// Stream of the initialization sample
+const uint64_t DISTRIBUTED_STREAM_SAMPLE = 64;
+
+struct DistributedStats {
+    int iterations = 0;
+    long long int globalPoints = 0;
+    // Time in the local sweeps and in the MPI_Allreduce calls (including the wait for the
+    // slowest rank), on this rank
+    double computeSeconds = 0.0;
+    double communicationSeconds = 0.0;
+    double initSeconds = 0.0;
+    double totalSeconds = 0.0;
+};
+
+/*
+    Rows [first, first + count) of the global data set owned by every rank: the rows are split
+    in equal contiguous blocks.
+*/
+inline void shard_rows(long long int numPoints, int rank, int numRanks, long long int& first, long long int& count) {
+    first = (long long int)((__int128)numPoints * rank / numRanks);
+    count = (long long int)((__int128)numPoints * (rank + 1) / numRanks) - first;
+}
+
+/*
+    Loads the shard of this rank of a binary data set file (kmeans/binary.h) into points, in
+    LAYOUT_SOA. globalOffset is the global index of its first row. Returns false on every rank
+    if some rank couldn't read its shard.
+*/
+inline bool load_shard_binary(const std::string& file_name, MPI_Comm comm, Dataset& points,
+                              long long int& globalOffset, long long int& globalPoints) {
+    int rank, numRanks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &numRanks);
+
+    BlockStream stream;
+    int ok = stream.open(file_name) ? 1 : 0;
+    if (ok) {
+        long long int count = 0;
+        globalPoints = stream.size();
+        shard_rows(globalPoints, rank, numRanks, globalOffset, count);
+        points = Dataset(count, stream.dims(), LAYOUT_SOA);
+        if (count > 0 && !stream.read(globalOffset, count, points)) {
+            std::cerr << "Read error in shard of rank " << rank << ": " << file_name << "\n";
+            ok = 0;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    return ok == 1;
+}
+
+/*
+    Loads the shard of this rank of a CSV file into points. The file is split in equal byte
+    ranges and a line belongs to the rank whose range holds its first byte, so every rank only
+    parses (and the page cache only brings in) its own part of the file. globalOffset, the
+    global index of the first row, is the prefix sum of the row counts of the lower ranks.
+    Returns false on every rank if some rank couldn't parse its shard.
+*/
+inline bool load_shard_CSV(const std::string& file_name, MPI_Comm comm, Dataset& points,
+                           long long int& globalOffset, long long int& globalPoints) {
+    int rank, numRanks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &numRanks);
+
+    long long int rows = 0;
+    MappedFile file;
+    int ok = file.open(file_name) ? 1 : 0;
+    if (!ok) std::cerr << "Couldn't read file: " << file_name << "\n";
+    if (ok) {
+        const char* text = file.data();
+        const size_t size = file.size();
+        // First line start at or after a byte position
+        auto line_start = [&](size_t pos) -> size_t {
+            if (pos == 0) return 0;
+            if (pos >= size) return size;
+            const void* nl = memchr(text + pos - 1, '\n', size - pos + 1);
+            return nl ? (const char*)nl - text + 1 : size;
+        };
+        const size_t begin = line_start((size_t)((unsigned __int128)size * rank / numRanks));
+        const size_t end = line_start((size_t)((unsigned __int128)size * (rank + 1) / numRanks));
+
+        const char* p = text + begin;
+        const char* last = text + end;
+        while (p < last) {
+            const char* nl = (const char*)memchr(p, '\n', last - p);
+            rows++;
+            p = nl ? nl + 1 : last;
+        }
+        const int dims = CSV_dimensions(file_name);
+        points = Dataset(rows, dims > 0 ? dims : 1, LAYOUT_SOA);
+        if (dims <= 0 || (rows > 0 && parse_CSV_text(text + begin, end - begin, points, file_name) < 0)) ok = 0;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (ok != 1) return false;
+
+    globalOffset = 0;
+    MPI_Exscan(&rows, &globalOffset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) globalOffset = 0;
+    MPI_Allreduce(&rows, &globalPoints, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    return true;
+}
+
+/*
+    Writes the labels of every shard to one file of raw 32-bit integers in global row order
+    (the format of the ground truth labels of tools/generate_data.cpp), each rank at its own
+    offset with a collective write.
+*/
+inline bool save_distributed_labels(const std::string& file_name, MPI_Comm comm, const int* labels,
+                                    long long int count, long long int globalOffset) {
+    MPI_File out;
+    if (MPI_File_open(comm, file_name.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &out) != MPI_SUCCESS) {
+        std::cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    MPI_File_set_size(out, 0);
+    int ok = 1;
+    // MPI counts are int: large shards are written in pieces
+    const long long int piece = 1 << 28;
+    long long int pieces = (count + piece - 1) / piece;
+    MPI_Allreduce(MPI_IN_PLACE, &pieces, 1, MPI_LONG_LONG, MPI_MAX, comm);
+    for (long long int c = 0; c < pieces; c++) {
+        const long long int begin = c * piece < count ? c * piece : count;
+        const long long int size = begin + piece < count ? piece : count - begin;
+        const MPI_Offset offset = (MPI_Offset)sizeof(int32_t) * (globalOffset + begin);
+        if (MPI_File_write_at_all(out, offset, labels + begin, (int)size, MPI_INT, MPI_STATUS_IGNORE) != MPI_SUCCESS) ok = 0;
+    }
+    MPI_File_close(&out);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    if (!ok) std::cerr << "Couldn't write to file: " << file_name << "\n";
+    return ok == 1;
+}
+
+template <int D>
+inline bool kmeans_distributed_impl(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                                    double* centroids, MPI_Comm comm, DistributedStats& stats, InitMethod init) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+    double runStart = omp_get_wtime();
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    long long int globalOffset = 0;
+    MPI_Exscan(&numPoints, &globalOffset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) globalOffset = 0;
+    MPI_Allreduce(&numPoints, &stats.globalPoints, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    // Same decision on every rank: k and the global size are the same everywhere
+    if (k <= 0 || k > stats.globalPoints) {
+        if (rank == 0) {
+            std::cerr << "Invalid k-means input: k = " << k << ", " << stats.globalPoints << " points of " << dims
+                      << " dimensions\n";
+        }
+        return false;
+    }
+    uint64_t seed = rank == 0 ? (uint64_t)rand() : 0;
+    MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, comm);
+
+    // Init sample: every point with probability sampleSize / globalPoints, gathered in row order
+    long long int sampleSize = 20LL * k > 65536 ? 20LL * k : 65536;
+    if (sampleSize > stats.globalPoints) sampleSize = stats.globalPoints;
+    const double rate = stats.globalPoints > 0 ? (double)sampleSize / stats.globalPoints : 1.0;
+    std::vector<double> local;
+    for (long long int i = 0; i < numPoints; i++) {
+        if (rate < 1.0 && counter_uniform(seed, DISTRIBUTED_STREAM_SAMPLE, globalOffset + i) >= rate) continue;
+        for (int d = 0; d < dims; d++) local.push_back(data.at(i, d));
+    }
+    int numRanks;
+    MPI_Comm_size(comm, &numRanks);
+    int localValues = (int)local.size();
+    std::vector<int> counts(numRanks), displacements(numRanks, 0);
+    MPI_Gather(&localValues, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+    for (int r = 1; r < numRanks; r++) displacements[r] = displacements[r - 1] + counts[r - 1];
+    const long long int sampled = (displacements[numRanks - 1] + counts[numRanks - 1]) / dims;
+    std::vector<double> gathered(rank == 0 ? (size_t)sampled * dims : 0);
+    MPI_Gatherv(local.data(), localValues, MPI_DOUBLE, gathered.data(), counts.data(), displacements.data(),
+                MPI_DOUBLE, 0, comm);
+    // Only rank 0 knows the sample size (the counts are gathered there)
+    int ok = 1;
+    if (rank == 0) {
+        if (sampled < k) {
+            std::cerr << "Initialization sample too small: " << sampled << " points for k = " << k << "\n";
+            ok = 0;
+        } else {
+            Dataset sample(sampled, dims, LAYOUT_SOA);
+            for (long long int i = 0; i < sampled; i++) {
+                for (int d = 0; d < dims; d++) sample.at(i, d) = gathered[(size_t)i * dims + d];
+            }
+            init_centroids<D>(sample.view(), k, centroids, init);
+        }
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, comm);
+    if (ok != 1) return false;
+    MPI_Bcast(centroids, k * dims, MPI_DOUBLE, 0, comm);
+    stats.initSeconds = omp_get_wtime() - runStart;
+
+    ReductionWorkspace workspace(k, dims);
+    CentroidTable table(k, dims);
+    std::vector<double> globalSums((size_t)k * dims);
+    // k cluster sizes followed by the number of reassigned points
+    std::vector<long long int> counters(k + 1), globalCounters(k + 1);
+
+    bool changed = true;
+    int iter = 0;
+
+    while (changed && iter < maxIterations) {
+        iter++;
+        double start = omp_get_wtime();
+        table.load(centroids);
+        counters[k] = lloyd_sweep<D>(data, table, clusterAssignment, workspace);
+        memcpy(counters.data(), workspace.totalSizes(), sizeof(long long int) * k);
+        double sweepEnd = omp_get_wtime();
+
+        MPI_Allreduce(workspace.totalSums(), globalSums.data(), k * dims, MPI_DOUBLE, MPI_SUM, comm);
+        MPI_Allreduce(counters.data(), globalCounters.data(), k + 1, MPI_LONG_LONG, MPI_SUM, comm);
+        stats.computeSeconds += sweepEnd - start;
+        stats.communicationSeconds += omp_get_wtime() - sweepEnd;
+
+        changed = globalCounters[k] > 0;
+        if (changed) {
+            for (int j = 0; j < k; j++) {
+                if (globalCounters[j] == 0) continue;
+                for (int d = 0; d < dims; d++) {
+                    centroids[(long long int)j * dims + d] = globalSums[(size_t)j * dims + d] / globalCounters[j];
+                }
+            }
+        }
+    }
+
+    stats.iterations = iter;
+    stats.totalSeconds = omp_get_wtime() - runStart;
+    return true;
+}
+
+/** DISTRIBUTED VERSION
+ *  Performs Lloyd's k-means over a data set split among the ranks of comm, with OMP inside
+ *  every rank. Collective: every rank of comm calls it with its own shard (contiguous rows of
+ *  the global data set, in rank order) and the same k and maxIterations; every rank ends with
+ *  the same centroids and the labels of its own points. Returns false on every rank (after
+ *  rank 0 reports it) if k isn't in [1, global points] or the initialization sample has fewer
+ *  than k points.
+ *  Shard of the data set of this rank
+ *  @param data
+ *  Number of desired clusters
+ *  @param k
+ *  Maximum number of iterations allowed for the algorithm
+ *  @param maxIterations
+ *  Output cluster id of every point of the shard (initialized by the caller, e.g. to -1)
+ *  @param clusterAssignment
+ *  Output centroids (k * dims values, centroid by centroid)
+ *  @param centroids
+ *  Communicator of the ranks that hold the data set
+ *  @param comm
+ *  Optional iterations and compute / communication times of this rank
+ *  @param stats
+ *  Initial centroids, picked on rank 0 from a sample of the whole data set (see init.h)
+ *  @param init
+ */
+inline bool kmeans_distributed(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                               double* centroids, MPI_Comm comm, DistributedStats* stats = nullptr,
+                               InitMethod init = INIT_KMEANS_PARALLEL) {
+    DistributedStats local;
+    bool ok = false;
+    dispatch_dims(data.dims, [&](auto dim) {
+        ok = kmeans_distributed_impl<decltype(dim)::value>(data, k, maxIterations, clusterAssignment, centroids, comm,
+                                                           local, init);
+    });
+    if (stats != nullptr) *stats = local;
+    return ok;
+}
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef KMEANS_ELKAN_H
+#define KMEANS_ELKAN_H
+
+#include <cmath>
+#include <cstring>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "kmeans.h"
+#include "pruning.h"
+
+#if !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/*
+    ELKAN
+
+    Lloyd iterations accelerated with the triangle inequality (Elkan, 2003). Every point keeps
+    an upper bound on the distance to its centroid and one lower bound per centroid, and the
+    half distances between centroids are recomputed once per iteration. Centroid c is skipped
+    for point x when
+        u(x) < l(x, c)   or   u(x) < d(a, c) / 2       (a = current centroid of x)
+    and the whole point is skipped when u(x) < min_c d(a, c) / 2. The tests first run over all
+    centroids without branches using the stale upper bound; only the survivors are tested again
+    with the exact distance to a, in centroid order, before their distance is computed.
+    The bounds are stored relative to the total drift of their centroid (see pruning.h), so
+    after an update only the k drifts change and points that are skipped cost one bound read.
+    Late updates only move the reassigned points (incremental.h), so they don't read the data set.
+    Memory is n * k lower bounds on top of the data set.
+*/
+
+template <int D>
+inline void kmeans_elkan_impl(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                              PruningStats* stats, InitMethod init) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+
+    double* centroids = new double[dims * k];
+    init_centroids<D>(data, k, centroids, init);
+
+    double* oldCentroids = new double[dims * k];
+    ReductionWorkspace workspace(k, dims);
+    IncrementalCentroids incremental(k, dims, workspace.numThreads());
+    double* halfDist = new double[k * k];
+    double* halfMin = new double[k];
+    double* drift = new double[k]();
+    double* upper = static_cast<double*>(aligned_malloc(sizeof(double) * numPoints));
+    double* lower = static_cast<double*>(aligned_malloc(sizeof(double) * numPoints * k));
+    // Coordinates of the current point and centroids that survive the bound tests, per thread
+    ThreadScratch<double> points(dims);
+    ThreadScratch<int> candidateLists(k);
+
+    if (stats != nullptr) *stats = PruningStats();
+
+    bool changed = true;
+    int iter = 0;
+
+    while (changed && iter < maxIterations) {
+        changed = false;
+        iter++;
+
+        long long int reassigned = 0;
+        long long int computed = 0;
+        const bool tracking = incremental.tracking(numPoints);
+
+        if (iter > 1) {
+            for (int a = 0; a < k; a++) {
+                halfMin[a] = INFINITY;
+                for (int b = 0; b < k; b++) {
+                    if (a == b) {
+                        halfDist[a * k + b] = 0.0;
+                        continue;
+                    }
+                    halfDist[a * k + b] = lower_bound_of(0.5 * centroid_distance(centroids, dims, a, b));
+                    if (halfDist[a * k + b] < halfMin[a]) halfMin[a] = halfDist[a * k + b];
+                }
+            }
+        }
+
+        #pragma omp parallel reduction(+:reassigned, computed)
+        {
+            double* x = points.get(omp_get_thread_num());
+            int* candidates = candidateLists.get(omp_get_thread_num());
+
+            #pragma omp for schedule(static)
+            for (long long int i = 0; i < numPoints; i++) {
+                double* l = lower + i * k;
+
+                if (iter == 1) {
+                    // First pass: every distance, which initializes all the bounds
+                    gather_point<D>(data, i, x);
+                    double bestDist = 0.0;
+                    int best = 0;
+                    for (int j = 0; j < k; j++) {
+                        double dist = squared_distance<D>(x, centroids, j, dims);
+                        l[j] = store_lower(sqrt(dist), 0.0);
+                        if (j == 0 || dist < bestDist) {
+                            bestDist = dist;
+                            best = j;
+                        }
+                    }
+                    upper[i] = store_upper(sqrt(bestDist), 0.0);
+                    computed += k;
+                    if (clusterAssignment[i] != best) {
+                        if (tracking) incremental.record(omp_get_thread_num(), i, clusterAssignment[i], best);
+                        clusterAssignment[i] = best;
+                        reassigned++;
+                    }
+                    continue;
+                }
+
+                int a = clusterAssignment[i];
+                double u = current_upper(upper[i], drift[a]);
+                if (u < halfMin[a]) continue;
+
+                // Branch-free filter with the loose upper bound
+                const double* half = halfDist + a * k;
+                int numCandidates = 0;
+                for (int j = 0; j < k; j++) {
+                    candidates[numCandidates] = j;
+                    numCandidates += (j != a) & !(u < half[j]) & !(u < current_lower(l[j], drift[j]));
+                }
+                if (numCandidates == 0) continue;
+
+                // Tighten the upper bound, then test the survivors again against the closest so far
+                gather_point<D>(data, i, x);
+                double bestDist = squared_distance<D>(x, centroids, a, dims);
+                computed++;
+                l[a] = store_lower(sqrt(bestDist), drift[a]);
+                u = upper_bound_of(sqrt(bestDist));
+                for (int c = 0; c < numCandidates; c++) {
+                    int j = candidates[c];
+                    if (u < half[j] || u < current_lower(l[j], drift[j])) continue;
+                    double dist = squared_distance<D>(x, centroids, j, dims);
+                    computed++;
+                    l[j] = store_lower(sqrt(dist), drift[j]);
+                    if (closer_centroid(dist, j, bestDist, a)) {
+                        a = j;
+                        half = halfDist + a * k;
+                        bestDist = dist;
+                        u = upper_bound_of(sqrt(dist));
+                    }
+                }
+                upper[i] = store_upper(u, drift[a]);
+                if (clusterAssignment[i] != a) {
+                    if (tracking) incremental.record(omp_get_thread_num(), i, clusterAssignment[i], a);
+                    clusterAssignment[i] = a;
+                    reassigned++;
+                }
+            }
+        }
+
+        if (stats != nullptr) {
+            stats->skippedFraction.push_back(1.0 - (double)computed / ((double)numPoints * k));
+        }
+        changed = reassigned > 0;
+
+        if (!changed) break;
+
+        memcpy(oldCentroids, centroids, sizeof(double) * dims * k);
+        if (tracking) {
+            incremental.apply<D>(data, &workspace);
+            incremental.move_to_means(centroids);
+        } else {
+            update_centroids_paralelo<D>(data, clusterAssignment, centroids, workspace);
+            incremental.set(workspace.totalSums(), workspace.totalSizes());
+        }
+        incremental.end_iteration(reassigned);
+        add_centroid_drift(oldCentroids, centroids, k, dims, drift);
+    }
+
+    if (stats != nullptr) stats->iterations = iter;
+
+    aligned_free(lower);
+    aligned_free(upper);
+    delete[] drift;
+    delete[] halfMin;
+    delete[] halfDist;
+    delete[] oldCentroids;
+    delete[] centroids;
+}
+
+/** ELKAN VERSION
+ *  Performs the k-means algorithm using OMP, skipping distance computations with Elkan's
+ *  triangle inequality bounds. Same centroids, updates and labels as kmeans_paralelo.
+ *  Contiguous data set (any layout, any number of dimensions)
+ *  @param data
+ *  Number of desired clusters
+ *  @param k
+ *  Maximum number of iterations allowed for the algorithm
+ *  @param maxIterations
+ *  Output array with the cluster id of every point (size data.numPoints)
+ *  @param clusterAssignment
+ *  Optional fraction of distance computations skipped per iteration
+ *  @param stats
+ *  Initial centroids (see init.h)
+ *  @param init
+ */
+inline void kmeans_elkan(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                         PruningStats* stats = nullptr, InitMethod init = INIT_KMEANS_PARALLEL) {
+    dispatch_dims(data.dims, [&](auto dim) {
+        kmeans_elkan_impl<decltype(dim)::value>(data, k, maxIterations, clusterAssignment, stats, init);
+    });
+}
+
+#if !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
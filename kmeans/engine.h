@@ -0,0 +1,240 @@
+#ifndef KMEANS_ENGINE_H
+#define KMEANS_ENGINE_H
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "assign.h"
+#include "init.h"
+#include "kmeans.h"
+#include "reduction.h"
+#include "incremental.h"
+
+/*
+    KMeans engine
+
+    Library entry point for callers that cluster many data sets, e.g. a service that re-runs
+    k-means thousands of times a minute. The engine owns every buffer of a run (centroids,
+    centroid table, per-thread accumulators, incremental sums, initialization buffers and,
+    unless the caller passes its own, the labels) and keeps them between fit() calls. They are
+    only reallocated when the shape grows: another k or dims, more points than any previous
+    fit, or another number of OMP threads. Repeated fits of the same shape don't touch the
+    heap; the only buffers that can still grow are the lists of label changes of the
+    incremental update and the k-means|| candidates, and only when a fit needs more of them
+    than every previous one.
+
+    fit() takes a non-owning view (any layout; double coordinates with KMeans, float32 with
+    FloatKMeans) and runs the parallel Lloyd engine of kmeans.h with the seed of the options,
+    so results don't depend on rand(). The C ABI on top of it is in kmeans_c.h.
+*/
+
+struct KMeansOptions {
+    int k = 8;
+    int maxIterations = 300;
+    InitMethod init = INIT_KMEANS_PARALLEL;
+    uint64_t seed = 1;
+};
+
+struct KMeansResult {
+    // Owned by the engine (the labels by the caller when fit received them), valid until the
+    // next fit
+    const double* centroids = nullptr;
+    const int* labels = nullptr;
+    long long int numPoints = 0;
+    int k = 0;
+    int dims = 0;
+    // Sum of squared distances from every point to its centroid
+    double inertia = 0.0;
+    int iterations = 0;
+    bool converged = false;
+    // Labels that changed in the last iteration (0 when converged)
+    long long int lastReassigned = 0;
+    double initSeconds = 0.0;
+    double iterateSeconds = 0.0;
+    // Buffers this fit had to (re)allocate; 0 for repeated fits of the same shape
+    int allocations = 0;
+};
+
+/*
+    Sum of squared distances from every point to the centroid of its label
+*/
+template <int D, typename T>
+inline double cluster_inertia(const BasicDatasetView<T>& data, const int* clusterAssignment, const double* centroids) {
+    const int dims = dimensions<D>(data.dims);
+    const BasicDatasetView<T> points = data;
+    double total = 0.0;
+    #pragma omp parallel for reduction(+:total) schedule(static)
+    for (long long int i = 0; i < points.numPoints; i++) {
+        const double* centroid = centroids + (long long int)clusterAssignment[i] * dims;
+        double dist = 0.0;
+        for (int d = 0; d < dims; d++) {
+            double diff = points.at(i, d) - centroid[d];
+            dist += diff * diff;
+        }
+        total += dist;
+    }
+    return total;
+}
+
+template <typename T>
+class BasicKMeans {
+public:
+    explicit BasicKMeans(const KMeansOptions& options = KMeansOptions()) : options_(options) {}
+
+    BasicKMeans(const BasicKMeans&) = delete;
+    BasicKMeans& operator=(const BasicKMeans&) = delete;
+
+    ~BasicKMeans() { aligned_free(labels_); }
+
+    const KMeansOptions& options() const { return options_; }
+
+    // New options for the next fits; the buffers are kept (and reshaped if k changed)
+    void set_options(const KMeansOptions& options) { options_ = options; }
+
+    /*
+        Clusters data. Labels go to the caller's array when labels is not null (data.numPoints
+        values) and to the engine's otherwise; initialCentroids (k * dims values, centroid by
+        centroid) replaces the initialization, e.g. to warm start from a previous result.
+        Returns false (after reporting it) if k doesn't fit the data.
+    */
+    bool fit(const BasicDatasetView<T>& data, int* labels = nullptr, const double* initialCentroids = nullptr) {
+        return fit(data, labels, initialCentroids,
+                   [](int, long long int, const IncrementalCentroids&) { return true; });
+    }
+
+    /*
+        Same as above with a per-iteration observer (see lloyd_iterate): it is called with the
+        iteration, the labels that changed and the sums and sizes of the new labels, and
+        returning false ends the fit after that iteration (the result is then not converged).
+    */
+    template <typename Observer>
+    bool fit(const BasicDatasetView<T>& data, int* labels, const double* initialCentroids, Observer&& observe) {
+        const int k = options_.k;
+        if (k <= 0 || data.dims <= 0 || data.numPoints < k) {
+            std::cerr << "Invalid k-means input: k = " << k << ", " << data.numPoints << " points of " << data.dims
+                      << " dimensions\n";
+            return false;
+        }
+        result_ = KMeansResult();
+        reserve(data.numPoints, data.dims, labels == nullptr);
+        int* clusterAssignment = labels != nullptr ? labels : labels_;
+
+        dispatch_dims(data.dims, [&](auto dim) {
+            run<decltype(dim)::value>(data, clusterAssignment, initialCentroids, observe);
+        });
+
+        result_.centroids = centroids_.data();
+        result_.labels = clusterAssignment;
+        result_.numPoints = data.numPoints;
+        result_.k = k;
+        result_.dims = data.dims;
+        result_.allocations = allocations_;
+        return true;
+    }
+
+    const KMeansResult& result() const { return result_; }
+
+    /*
+        Labels of the nearest centroid of the last fit for every point of data (same dims).
+        Returns false (after reporting it) if there was no fit of that shape.
+    */
+    bool predict(const BasicDatasetView<T>& data, int* labels) {
+        if (table_ == nullptr || result_.centroids == nullptr || data.dims != table_->dims) {
+            std::cerr << "predict needs a previous fit with " << data.dims << " dimensions\n";
+            return false;
+        }
+        table_->load(centroids_.data());
+        const long long int numBlocks = (data.numPoints + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+        const BasicCentroidTable<T>& table = *table_;
+        #pragma omp parallel for schedule(static)
+        for (long long int b = 0; b < numBlocks; b++) {
+            long long int begin = b * ASSIGN_BLOCK;
+            long long int end = begin + ASSIGN_BLOCK < data.numPoints ? begin + ASSIGN_BLOCK : data.numPoints;
+            assign_block(data, begin, end, table, labels);
+        }
+        return true;
+    }
+
+private:
+    // Grows the buffers for this shape; counts what had to be allocated
+    void reserve(long long int numPoints, int dims, bool ownLabels) {
+        const int k = options_.k;
+        const int numThreads = omp_get_max_threads();
+        allocations_ = 0;
+        if (workspace_ == nullptr || workspace_->k() != k || workspace_->dims() != dims ||
+            workspace_->numThreads() != numThreads) {
+            workspace_.reset(new ReductionWorkspace(k, dims, numThreads));
+            incremental_.reset(new IncrementalCentroids(k, dims, numThreads));
+            allocations_ += 2;
+        }
+        if (table_ == nullptr || table_->k != k || table_->dims != dims) {
+            table_.reset(new BasicCentroidTable<T>(k, dims));
+            allocations_++;
+        }
+        if (centroids_.size() != (size_t)k * dims) {
+            if (centroids_.capacity() < (size_t)k * dims) allocations_++;
+            centroids_.resize((size_t)k * dims);
+        }
+        if (ownLabels && numPoints > labelCapacity_) {
+            aligned_free(labels_);
+            labels_ = nullptr;
+            labels_ = static_cast<int*>(aligned_malloc(sizeof(int) * numPoints));
+            labelCapacity_ = numPoints;
+            allocations_++;
+        }
+        if (options_.init != INIT_RANDOM && numPoints > initCapacity_) {
+            initCapacity_ = numPoints;
+            allocations_++;
+        }
+    }
+
+    template <int D, typename Observer>
+    void run(const BasicDatasetView<T>& data, int* clusterAssignment, const double* initialCentroids,
+             Observer& observe) {
+        const int k = options_.k;
+        double start = omp_get_wtime();
+
+        #pragma omp parallel for schedule(static)
+        for (long long int i = 0; i < data.numPoints; i++) clusterAssignment[i] = -1;
+        if (initialCentroids != nullptr) {
+            memcpy(centroids_.data(), initialCentroids, sizeof(double) * centroids_.size());
+        } else {
+            init_centroids_seeded<D>(data, k, centroids_.data(), options_.init, options_.seed, init_);
+        }
+        double initEnd = omp_get_wtime();
+
+        incremental_->restart();
+        long long int reassigned = 0;
+        result_.iterations = lloyd_iterate<D>(data, options_.maxIterations, clusterAssignment, centroids_.data(),
+                                              *table_, *workspace_, *incremental_, reassigned, observe);
+        result_.lastReassigned = reassigned;
+        result_.converged = reassigned == 0;
+        result_.inertia = cluster_inertia<D>(data, clusterAssignment, centroids_.data());
+
+        result_.initSeconds = initEnd - start;
+        result_.iterateSeconds = omp_get_wtime() - initEnd;
+    }
+
+    KMeansOptions options_;
+    KMeansResult result_;
+    std::unique_ptr<ReductionWorkspace> workspace_;
+    std::unique_ptr<IncrementalCentroids> incremental_;
+    std::unique_ptr<BasicCentroidTable<T>> table_;
+    InitWorkspace init_;
+    std::vector<double> centroids_;
+    int* labels_ = nullptr;
+    long long int labelCapacity_ = 0;
+    long long int initCapacity_ = 0;
+    int allocations_ = 0;
+};
+
+using KMeans = BasicKMeans<double>;
+using FloatKMeans = BasicKMeans<float>;
+
+#endif
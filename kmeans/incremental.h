@@ -0,0 +1,220 @@
+#ifndef KMEANS_INCREMENTAL_H
+#define KMEANS_INCREMENTAL_H
+
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "reduction.h"
+#include "perf.h"
+
+/*
+    Incremental centroid update
+
+    Keeps the per-cluster coordinate sums and sizes between iterations. While tracking, the
+    engines record every label change (point, old label, new label) in the list of the thread
+    that made it, and the update only moves those points: the sums of the old cluster lose the
+    point and the new one gains it. The lists are applied in parallel, one list per thread,
+    into the slots of a ReductionWorkspace and reduced like a full update, so an iteration costs
+    O(changes) instead of O(n) for the update.
+
+    A full recomputation is used instead
+        - on the first update (labels before it are unknown),
+        - when the previous iteration changed more than INCREMENTAL_MAX_CHANGED of the points
+          (early iterations, where reading everything is cheaper than scattered deltas),
+        - every INCREMENTAL_REFRESH updates, which bounds the rounding drift of the sums.
+    The decision only depends on the history of change counts, so engines that produce the same
+    labels also make the same choices (and get the same centroids).
+*/
+
+// Full recomputation every this many updates
+const int INCREMENTAL_REFRESH = 16;
+
+// Fraction of changed points above which the next update is a full recomputation
+const double INCREMENTAL_MAX_CHANGED = 0.1;
+
+struct LabelChange {
+    long long int point;
+    int from;
+    int to;
+};
+
+class IncrementalCentroids {
+public:
+    IncrementalCentroids(int k, int dims, int numThreads = omp_get_max_threads())
+        : k_(k), dims_(dims), sums_((size_t)k * dims, 0.0), sizes_(k, 0), lists_(numThreads) {}
+
+    int numThreads() const { return (int)lists_.size(); }
+
+    // Forgets the sums and the history for a new run; the lists keep their capacity
+    void restart() {
+        valid_ = false;
+        updatesSinceFull_ = 0;
+        previousChanged_ = 0;
+        for (ChangeList& list : lists_) list.changes.clear();
+    }
+
+    /*
+        True when this iteration's update will use the change lists, so the engine has to
+        record its label changes; false means a full recomputation is due.
+    */
+    bool tracking(long long int numPoints) const {
+        return valid_ && updatesSinceFull_ < INCREMENTAL_REFRESH - 1 &&
+               previousChanged_ <= INCREMENTAL_MAX_CHANGED * numPoints;
+    }
+
+    // Records that point moved from cluster from to cluster to (thread t)
+    void record(int t, long long int point, int from, int to) { lists_[t].changes.push_back({point, from, to}); }
+
+    // Sums and sizes after a full recomputation
+    void set(const double* sums, const long long int* sizes) {
+        memcpy(sums_.data(), sums, sizeof(double) * sums_.size());
+        memcpy(sizes_.data(), sizes, sizeof(long long int) * sizes_.size());
+        valid_ = true;
+        updatesSinceFull_ = 0;
+    }
+
+    /*
+        Applies the recorded changes. With a workspace every list goes to a slot and the slots
+        are reduced in parallel; without one (serial engine) the deltas are added in place.
+        perf, when the counters are compiled in, counts the accumulate phase (see perf.h).
+    */
+    template <int D, typename T>
+    void apply(const BasicDatasetView<T>& data, ReductionWorkspace* workspace,
+               [[maybe_unused]] PerfCounters* perf = nullptr) {
+        const BasicDatasetView<T> points = data;
+        const int numLists = (int)lists_.size();
+
+        if (workspace == nullptr) {
+            for (int l = 0; l < numLists; l++) apply_list<D>(points, lists_[l].changes, sums_.data(), sizes_.data());
+        } else {
+            const long long int numSums = (long long int)k_ * dims_;
+            #pragma omp parallel
+            {
+                const int t = omp_get_thread_num();
+                KMEANS_PERF_BEGIN(perf, t, PERF_ACCUMULATE);
+                workspace->reset(t);
+
+                #pragma omp for schedule(static, 1)
+                for (int l = 0; l < numLists; l++) {
+                    apply_list<D>(points, lists_[l].changes, workspace->sums(t), workspace->sizes(t));
+                }
+
+                workspace->reduce(omp_get_num_threads());
+
+                const double* deltaSums = workspace->totalSums();
+                const long long int* deltaSizes = workspace->totalSizes();
+                #pragma omp for schedule(static) nowait
+                for (long long int e = 0; e < numSums; e++) sums_[e] += deltaSums[e];
+                #pragma omp for schedule(static)
+                for (int j = 0; j < k_; j++) sizes_[j] += deltaSizes[j];
+                KMEANS_PERF_END(perf, t, PERF_ACCUMULATE);
+            }
+        }
+        updatesSinceFull_++;
+    }
+
+    // Ends an iteration: remembers how many labels changed and empties the lists
+    void end_iteration(long long int changed) {
+        previousChanged_ = changed;
+        for (ChangeList& list : lists_) list.changes.clear();
+    }
+
+    // Current per-cluster sums (k * dims) and sizes (k), valid after every update
+    const double* sums() const { return sums_.data(); }
+    const long long int* sizes() const { return sizes_.data(); }
+
+    // Moves every non-empty cluster to the mean of its points
+    void move_to_means(double* centroids) const {
+        for (int j = 0; j < k_; j++) {
+            if (sizes_[j] <= 0) continue;
+            for (int d = 0; d < dims_; d++) {
+                centroids[(long long int)j * dims_ + d] = sums_[(long long int)j * dims_ + d] / sizes_[j];
+            }
+        }
+    }
+
+private:
+    template <int D, typename T>
+    static void apply_list(BasicDatasetView<T> points, const std::vector<LabelChange>& changes, double* sums,
+                           long long int* sizes) {
+        const int dims = dimensions<D>(points.dims);
+        for (const LabelChange& change : changes) {
+            sizes[change.from]--;
+            sizes[change.to]++;
+            for (int d = 0; d < dims; d++) {
+                double value = points.at(change.point, d);
+                sums[(long long int)change.from * dims + d] -= value;
+                sums[(long long int)change.to * dims + d] += value;
+            }
+        }
+    }
+
+    // Padded so the lists of different threads don't share a cache line
+    struct alignas(64) ChangeList {
+        std::vector<LabelChange> changes;
+    };
+
+    int k_;
+    int dims_;
+    std::vector<double> sums_;
+    std::vector<long long int> sizes_;
+    std::vector<ChangeList> lists_;
+    bool valid_ = false;
+    int updatesSinceFull_ = 0;
+    long long int previousChanged_ = 0;
+};
+
+/*
+    Sum of squared distances from every point to the mean of all of them: the constant term of
+    the inertia computed from cluster sums
+*/
+template <int D, typename T>
+inline double total_scatter(const BasicDatasetView<T>& data, std::vector<double>& mean) {
+    const int dims = dimensions<D>(data.dims);
+    const BasicDatasetView<T> points = data;
+    mean.assign(dims, 0.0);
+    for (int d = 0; d < dims; d++) {
+        double sum = 0.0;
+        #pragma omp parallel for reduction(+:sum) schedule(static)
+        for (long long int i = 0; i < points.numPoints; i++) sum += points.at(i, d);
+        mean[d] = sum / points.numPoints;
+    }
+    double total = 0.0;
+    #pragma omp parallel for reduction(+:total) schedule(static)
+    for (long long int i = 0; i < points.numPoints; i++) {
+        for (int d = 0; d < dims; d++) {
+            double diff = points.at(i, d) - mean[d];
+            total += diff * diff;
+        }
+    }
+    return total;
+}
+
+/*
+    Inertia of the labels around their means from the per-cluster sums: the scatter around the
+    global mean minus the scatter of the cluster means, weighted by size. Centering on the mean
+    keeps the cancellation small unless the clusters are many orders of magnitude tighter than
+    the data set, which is enough to compare restarts or follow a run.
+*/
+inline double inertia_from_sums(const IncrementalCentroids& incremental, int k, int dims, double scatter,
+                                const double* mean) {
+    const double* sums = incremental.sums();
+    const long long int* sizes = incremental.sizes();
+    double between = 0.0;
+    for (int j = 0; j < k; j++) {
+        if (sizes[j] <= 0) continue;
+        double dist = 0.0;
+        for (int d = 0; d < dims; d++) {
+            double diff = sums[(long long int)j * dims + d] / sizes[j] - mean[d];
+            dist += diff * diff;
+        }
+        between += sizes[j] * dist;
+    }
+    double inertia = scatter - between;
+    return inertia > 0.0 ? inertia : 0.0;
+}
+
+#endif
@@ -0,0 +1,446 @@
+#ifndef KMEANS_INIT_H
+#define KMEANS_INIT_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "random.h"
+
+/*
+    Initial centroids
+
+    INIT_RANDOM             k points picked with rand() % numPoints (the original seeding)
+    INIT_KMEANS_PLUS_PLUS   k-means++ (Arthur & Vassilvitskii, 2007): every new centroid is a
+                            point drawn with probability proportional to its squared distance
+                            to the closest centroid chosen so far (D^2 sampling)
+    INIT_KMEANS_PARALLEL    k-means|| (Bahmani et al., 2012): a few rounds in which every point
+                            is kept independently with probability l * D^2(x) / cost, l = 2k,
+                            then the candidates, weighted by the number of points closest to
+                            them, are reduced to k centroids with k-means++
+
+    Both D^2 initializers are parallel over points and use the counter-based draws of random.h,
+    indexed by round and point id. Sums of distances are taken per block of INIT_BLOCK points and
+    the block sums are added in order, so for a given seed the centroids are the same with any
+    number of threads.
+*/
+enum InitMethod { INIT_RANDOM, INIT_KMEANS_PLUS_PLUS, INIT_KMEANS_PARALLEL };
+
+// Points per block of the ordered distance sums
+const long long int INIT_BLOCK = 4096;
+
+// Sampling rounds of k-means|| (the paper reports 5 rounds with l = 2k as enough)
+const int KMEANS_PARALLEL_ROUNDS = 5;
+
+// Streams of the counter-based draws
+const uint64_t INIT_STREAM_FIRST = 0;
+const uint64_t INIT_STREAM_PLUS_PLUS = 1;
+const uint64_t INIT_STREAM_RECLUSTER = 2;
+const uint64_t INIT_STREAM_ROUND = 3;
+
+// Dimensions up to this many are copied to the stack in the distance passes
+const int INIT_STACK_DIMS = 64;
+
+/*
+    Buffers of the D^2 initializers. They only grow, so an engine that keeps one across runs on
+    data sets of the same shape initializes without touching the heap. The per-point buffers
+    are filled in parallel by the initializers, which places their pages near the threads.
+*/
+class InitWorkspace {
+public:
+    InitWorkspace() {}
+    ~InitWorkspace() {
+        aligned_free(minDist_);
+        aligned_free(nearest_);
+    }
+
+    InitWorkspace(const InitWorkspace&) = delete;
+    InitWorkspace& operator=(const InitWorkspace&) = delete;
+
+    // Makes room for numPoints points, k centroids and dims dimensions
+    void prepare(long long int numPoints, int k, int dims) {
+        if (numPoints > pointCapacity_) {
+            aligned_free(minDist_);
+            aligned_free(nearest_);
+            minDist_ = nullptr;
+            nearest_ = nullptr;
+            minDist_ = static_cast<double*>(aligned_malloc(sizeof(double) * numPoints));
+            nearest_ = static_cast<int*>(aligned_malloc(sizeof(int) * numPoints));
+            pointCapacity_ = numPoints;
+        }
+        const long long int numBlocks = (numPoints + INIT_BLOCK - 1) / INIT_BLOCK;
+        if ((long long int)blockSums.size() < numBlocks) {
+            blockSums.resize(numBlocks);
+            blockCounts.resize(numBlocks + 1);
+        }
+        // Expected k-means|| candidates are 1 + 2k per round; room for twice that
+        const size_t expected = (size_t)(1 + 4 * (long long int)k * KMEANS_PARALLEL_ROUNDS);
+        candidates.reserve(expected * dims);
+        weights.reserve(expected);
+        candidateDist.reserve(expected);
+        candidateWeighted.reserve(expected);
+        candidateBlockSums.reserve((expected + INIT_BLOCK - 1) / INIT_BLOCK);
+        const int numThreads = omp_get_max_threads();
+        if ((int)threadWeights.size() < numThreads) threadWeights.resize(numThreads);
+        for (std::vector<long long int>& local : threadWeights) local.reserve(expected);
+    }
+
+    double* minDist() { return minDist_; }
+    int* nearest() { return nearest_; }
+
+    std::vector<double> blockSums;
+    // Candidates picked per block in a k-means|| round, then their prefix sums
+    std::vector<long long int> blockCounts;
+    std::vector<double> candidates;
+    std::vector<long long int> weights;
+    std::vector<std::vector<long long int>> threadWeights;
+    // Weighted k-means++ over the candidates
+    std::vector<double> candidateDist;
+    std::vector<double> candidateWeighted;
+    std::vector<double> candidateBlockSums;
+
+private:
+    double* minDist_ = nullptr;
+    int* nearest_ = nullptr;
+    long long int pointCapacity_ = 0;
+};
+
+/*
+    Initial centroids: k points of the data set picked with rand()
+*/
+template <int D, typename T>
+inline void init_random_centroids(const BasicDatasetView<T>& data, int k, double* centroids) {
+    const int dims = dimensions<D>(data.dims);
+    for (int i = 0; i < k; i++) {
+        long long int randIndex = rand() % data.numPoints;
+        for (int d = 0; d < dims; d++) {
+            centroids[dims * i + d] = data.at(randIndex, d);
+        }
+    }
+}
+
+/*
+    Lowers minDist[i] to the squared distance from point i to centers [first, last) (stored point
+    by point) and records the closest one in nearest (when not null; ties keep the earliest).
+    blockSums[b] receives the sum of minDist over block b.
+*/
+template <int D, typename T>
+inline void update_min_distances(const BasicDatasetView<T>& data, const double* centers, int first, int last,
+                                 double* minDist, int* nearest, double* blockSums, bool parallel) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+    const long long int numBlocks = (numPoints + INIT_BLOCK - 1) / INIT_BLOCK;
+
+    #pragma omp parallel for schedule(static) if(parallel)
+    for (long long int b = 0; b < numBlocks; b++) {
+        long long int begin = b * INIT_BLOCK;
+        long long int end = begin + INIT_BLOCK < numPoints ? begin + INIT_BLOCK : numPoints;
+        double fixedX[D > 0 ? D : INIT_STACK_DIMS];
+        std::vector<double> runtimeX(D > 0 || dims <= INIT_STACK_DIMS ? 0 : dims);
+        double* x = runtimeX.empty() ? fixedX : runtimeX.data();
+        double sum = 0.0;
+        for (long long int i = begin; i < end; i++) {
+            for (int d = 0; d < dims; d++) x[d] = data.at(i, d);
+            for (int c = first; c < last; c++) {
+                const double* center = centers + (long long int)c * dims;
+                double dist = 0.0;
+                for (int d = 0; d < dims; d++) {
+                    double diff = x[d] - center[d];
+                    dist += diff * diff;
+                }
+                if (dist < minDist[i]) {
+                    minDist[i] = dist;
+                    if (nearest != nullptr) nearest[i] = c;
+                }
+            }
+            sum += minDist[i];
+        }
+        blockSums[b] = sum;
+    }
+}
+
+inline double ordered_total(const double* blockSums, long long int numBlocks) {
+    double total = 0.0;
+    for (long long int b = 0; b < numBlocks; b++) total += blockSums[b];
+    return total;
+}
+
+/*
+    Index drawn with probability weight[i] / total, for u uniform in [0, 1). blockSums holds the
+    sums of INIT_BLOCK consecutive weights; the walk skips whole blocks and only scans one.
+    Rounding can leave the target past the last weight: the last positive weight is taken then.
+*/
+inline long long int pick_weighted(const double* weight, long long int n, const double* blockSums, double total,
+                                   double u) {
+    const long long int numBlocks = (n + INIT_BLOCK - 1) / INIT_BLOCK;
+    double target = u * total;
+    long long int b = 0;
+    long long int lastPositive = -1;
+    while (b < numBlocks) {
+        if (blockSums[b] > 0.0) {
+            lastPositive = b;
+            if (target < blockSums[b]) break;
+        }
+        target -= blockSums[b];
+        b++;
+    }
+    if (b == numBlocks) {
+        b = lastPositive;
+        target = INFINITY;
+    }
+
+    long long int begin = b * INIT_BLOCK;
+    long long int end = begin + INIT_BLOCK < n ? begin + INIT_BLOCK : n;
+    long long int picked = -1;
+    for (long long int i = begin; i < end; i++) {
+        if (weight[i] <= 0.0) continue;
+        picked = i;
+        if (target < weight[i]) break;
+        target -= weight[i];
+    }
+    return picked;
+}
+
+template <int D, typename T>
+inline void copy_point(const BasicDatasetView<T>& data, long long int i, double* centroid) {
+    const int dims = dimensions<D>(data.dims);
+    for (int d = 0; d < dims; d++) centroid[d] = data.at(i, d);
+}
+
+/*
+    D^2 sampling of centroids [begin, k) over the whole data set. Centroids [0, begin) are chosen
+    and minDist / blockSums are up to date with them. When every point already sits on a
+    centroid (total cost 0) the remaining picks are uniform.
+*/
+template <int D, typename T>
+inline void kmeans_plus_plus_steps(const BasicDatasetView<T>& data, int begin, int k, uint64_t seed, double* centroids,
+                                   double* minDist, double* blockSums, bool parallel) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+    const long long int numBlocks = (numPoints + INIT_BLOCK - 1) / INIT_BLOCK;
+
+    for (int c = begin; c < k; c++) {
+        double total = ordered_total(blockSums, numBlocks);
+        long long int i;
+        if (total > 0.0) {
+            i = pick_weighted(minDist, numPoints, blockSums, total, counter_uniform(seed, INIT_STREAM_PLUS_PLUS, c));
+        } else {
+            i = counter_random(seed, INIT_STREAM_PLUS_PLUS, c) % numPoints;
+        }
+        copy_point<D>(data, i, centroids + (long long int)c * dims);
+        if (c + 1 < k) update_min_distances<D>(data, centroids, c, c + 1, minDist, nullptr, blockSums, parallel);
+    }
+}
+
+/*
+    k-means++: first centroid uniform, the rest by D^2 sampling. One pass over the data per
+    centroid, parallel over points.
+*/
+template <int D, typename T>
+inline void init_kmeans_plus_plus(const BasicDatasetView<T>& data, int k, uint64_t seed, double* centroids,
+                                  InitWorkspace& workspace, bool parallel = true) {
+    const long long int numPoints = data.numPoints;
+    workspace.prepare(numPoints, k, data.dims);
+    double* minDist = workspace.minDist();
+    double* blockSums = workspace.blockSums.data();
+
+    #pragma omp parallel for schedule(static) if(parallel)
+    for (long long int i = 0; i < numPoints; i++) minDist[i] = INFINITY;
+
+    copy_point<D>(data, counter_random(seed, INIT_STREAM_FIRST, 0) % numPoints, centroids);
+    if (k > 1) update_min_distances<D>(data, centroids, 0, 1, minDist, nullptr, blockSums, parallel);
+    kmeans_plus_plus_steps<D>(data, 1, k, seed, centroids, minDist, blockSums, parallel);
+}
+
+/*
+    Weighted k-means++ over the m candidates of k-means|| (stored point by point), serial:
+    m is a few times k, much smaller than the data set.
+*/
+inline void recluster_candidates(InitWorkspace& workspace, int dims, int k, uint64_t seed, double* centroids) {
+    const std::vector<double>& candidates = workspace.candidates;
+    const std::vector<long long int>& weights = workspace.weights;
+    const long long int m = (long long int)weights.size();
+    std::vector<double>& minDist = workspace.candidateDist;
+    std::vector<double>& weighted = workspace.candidateWeighted;
+    std::vector<double>& blockSums = workspace.candidateBlockSums;
+    const long long int numBlocks = (m + INIT_BLOCK - 1) / INIT_BLOCK;
+    minDist.assign(m, INFINITY);
+    weighted.resize(m);
+    blockSums.resize(numBlocks);
+
+    for (int c = 0; c < k; c++) {
+        // Weight of a candidate: points it stands for times D^2 (just the points for the first pick)
+        for (long long int b = 0; b < numBlocks; b++) {
+            long long int begin = b * INIT_BLOCK;
+            long long int end = begin + INIT_BLOCK < m ? begin + INIT_BLOCK : m;
+            double sum = 0.0;
+            for (long long int j = begin; j < end; j++) {
+                weighted[j] = c == 0 ? (double)weights[j] : weights[j] * minDist[j];
+                sum += weighted[j];
+            }
+            blockSums[b] = sum;
+        }
+        double total = ordered_total(blockSums.data(), numBlocks);
+        long long int j;
+        if (total > 0.0) {
+            j = pick_weighted(weighted.data(), m, blockSums.data(), total,
+                              counter_uniform(seed, INIT_STREAM_RECLUSTER, c));
+        } else {
+            j = counter_random(seed, INIT_STREAM_RECLUSTER, c) % m;
+        }
+        const double* chosen = &candidates[j * dims];
+        for (int d = 0; d < dims; d++) centroids[(long long int)c * dims + d] = chosen[d];
+
+        for (long long int i = 0; i < m; i++) {
+            double dist = 0.0;
+            for (int d = 0; d < dims; d++) {
+                double diff = candidates[i * dims + d] - chosen[d];
+                dist += diff * diff;
+            }
+            if (dist < minDist[i]) minDist[i] = dist;
+        }
+    }
+}
+
+/*
+    k-means||: KMEANS_PARALLEL_ROUNDS passes over the data instead of k. Each round keeps point i
+    when u(round, i) * cost < l * D^2(i), then lowers the distances against the new candidates.
+    The closest candidate of every point is tracked along the way, which gives the weights for
+    the final weighted k-means++ without another pass. With fewer than k candidates (data with
+    few distinct points) they are all kept and the rest is filled by D^2 sampling.
+*/
+template <int D, typename T>
+inline void init_kmeans_parallel(const BasicDatasetView<T>& data, int k, uint64_t seed, double* centroids,
+                                 InitWorkspace& workspace, bool parallel = true) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+    const long long int numBlocks = (numPoints + INIT_BLOCK - 1) / INIT_BLOCK;
+    const double oversampling = 2.0 * k;
+
+    workspace.prepare(numPoints, k, dims);
+    double* minDist = workspace.minDist();
+    int* nearest = workspace.nearest();
+    double* blockSums = workspace.blockSums.data();
+    long long int* blockCounts = workspace.blockCounts.data();
+
+    #pragma omp parallel for schedule(static) if(parallel)
+    for (long long int i = 0; i < numPoints; i++) {
+        minDist[i] = INFINITY;
+        nearest[i] = 0;
+    }
+
+    std::vector<double>& candidates = workspace.candidates;
+    candidates.resize(dims);
+    copy_point<D>(data, counter_random(seed, INIT_STREAM_FIRST, 0) % numPoints, candidates.data());
+    update_min_distances<D>(data, candidates.data(), 0, 1, minDist, nearest, blockSums, parallel);
+
+    for (int round = 0; round < KMEANS_PARALLEL_ROUNDS; round++) {
+        double cost = ordered_total(blockSums, numBlocks);
+        if (cost <= 0.0) break;
+
+        // The draws are pure functions of (round, point): count the picks of every block,
+        // then copy them in point order into their slots of the candidate list
+        #pragma omp parallel for schedule(static) if(parallel)
+        for (long long int b = 0; b < numBlocks; b++) {
+            long long int begin = b * INIT_BLOCK;
+            long long int end = begin + INIT_BLOCK < numPoints ? begin + INIT_BLOCK : numPoints;
+            long long int count = 0;
+            for (long long int i = begin; i < end; i++) {
+                count += counter_uniform(seed, INIT_STREAM_ROUND + round, i) * cost < oversampling * minDist[i];
+            }
+            blockCounts[b + 1] = count;
+        }
+        const int first = (int)(candidates.size() / dims);
+        blockCounts[0] = first;
+        for (long long int b = 0; b < numBlocks; b++) blockCounts[b + 1] += blockCounts[b];
+        const int last = (int)blockCounts[numBlocks];
+        candidates.resize((size_t)last * dims);
+
+        #pragma omp parallel for schedule(static) if(parallel)
+        for (long long int b = 0; b < numBlocks; b++) {
+            if (blockCounts[b + 1] == blockCounts[b]) continue;
+            long long int begin = b * INIT_BLOCK;
+            long long int end = begin + INIT_BLOCK < numPoints ? begin + INIT_BLOCK : numPoints;
+            long long int slot = blockCounts[b];
+            for (long long int i = begin; i < end; i++) {
+                if (counter_uniform(seed, INIT_STREAM_ROUND + round, i) * cost < oversampling * minDist[i]) {
+                    copy_point<D>(data, i, &candidates[slot++ * dims]);
+                }
+            }
+        }
+        if (last > first) {
+            update_min_distances<D>(data, candidates.data(), first, last, minDist, nearest, blockSums, parallel);
+        }
+    }
+
+    const int m = (int)(candidates.size() / dims);
+    if (m <= k) {
+        for (long long int i = 0; i < (long long int)m * dims; i++) centroids[i] = candidates[i];
+        kmeans_plus_plus_steps<D>(data, m, k, seed, centroids, minDist, blockSums, parallel);
+    } else {
+        // Points closest to every candidate (integer counts: same sums in any order)
+        std::vector<long long int>& weights = workspace.weights;
+        weights.assign(m, 0);
+        #pragma omp parallel if(parallel)
+        {
+            std::vector<long long int>& localWeights = workspace.threadWeights[omp_get_thread_num()];
+            localWeights.assign(m, 0);
+            #pragma omp for schedule(static)
+            for (long long int i = 0; i < numPoints; i++) localWeights[nearest[i]]++;
+            #pragma omp critical
+            for (int j = 0; j < m; j++) weights[j] += localWeights[j];
+        }
+        recluster_candidates(workspace, dims, k, seed, centroids);
+    }
+}
+
+/*
+    Initial centroids from an explicit seed, with the buffers of workspace. INIT_RANDOM picks
+    its k points with counter-based draws here instead of rand().
+*/
+template <int D, typename T>
+inline void init_centroids_seeded(const BasicDatasetView<T>& data, int k, double* centroids, InitMethod method,
+                                  uint64_t seed, InitWorkspace& workspace, bool parallel = true) {
+    if (method == INIT_RANDOM) {
+        for (int c = 0; c < k; c++) {
+            copy_point<D>(data, counter_random(seed, INIT_STREAM_FIRST, c) % data.numPoints,
+                          centroids + (long long int)c * data.dims);
+        }
+    } else if (method == INIT_KMEANS_PLUS_PLUS) {
+        init_kmeans_plus_plus<D>(data, k, seed, centroids, workspace, parallel);
+    } else {
+        init_kmeans_parallel<D>(data, k, seed, centroids, workspace, parallel);
+    }
+}
+
+/*
+    Initial centroids of the engines. The D^2 initializers take their seed from one rand() draw
+    in the calling thread, so srand(seed) still fixes the whole run; parallel = false keeps the
+    serial engine serial (the centroids are the same either way).
+*/
+template <int D, typename T>
+inline void init_centroids(const BasicDatasetView<T>& data, int k, double* centroids, InitMethod method,
+                           bool parallel = true) {
+    if (method == INIT_RANDOM) {
+        init_random_centroids<D>(data, k, centroids);
+        return;
+    }
+    InitWorkspace workspace;
+    init_centroids_seeded<D>(data, k, centroids, method, (uint64_t)rand(), workspace, parallel);
+}
+
+// Name of an initialization method for the drivers ("random", "kmeans++", "kmeans||")
+inline bool parse_init_method(const std::string& name, InitMethod& method) {
+    if (name == "random") method = INIT_RANDOM;
+    else if (name == "kmeans++") method = INIT_KMEANS_PLUS_PLUS;
+    else if (name == "kmeans||") method = INIT_KMEANS_PARALLEL;
+    else return false;
+    return true;
+}
+
+#endif
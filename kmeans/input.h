@@ -0,0 +1,66 @@
+#ifndef KMEANS_INPUT_H
+#define KMEANS_INPUT_H
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <omp.h>
+
+#include "dataset.h"
+#include "csv.h"
+#include "binary.h"
+
+/*
+    Input data set of the drivers
+
+    open("data/N_data", N) maps data/N_data.bin when it exists (no copy, no parsing) and
+    otherwise loads data/N_data.csv into an owning Dataset. Either way the engines only see
+    view(), limited to the first maxPoints points.
+*/
+class InputDataset {
+public:
+    bool open(std::string base_name, long long int maxPoints, Layout layout = LAYOUT_SOA) {
+        double start = omp_get_wtime();
+        std::string binary_name = base_name + ".bin";
+        if (std::ifstream(binary_name).good()) {
+            if (!binary_.open(binary_name)) return false;
+            view_ = binary_.view();
+            if (view_.numPoints > maxPoints) view_.numPoints = maxPoints;
+            mapped_ = true;
+            seconds_ = omp_get_wtime() - start;
+            return true;
+        }
+
+        std::string csv_name = base_name + ".csv";
+        int dims = CSV_dimensions(csv_name);
+        if (dims == 0) return false;
+        points_ = Dataset(maxPoints, dims, layout);
+        CSVLoadStats stats;
+        if (!load_CSV(csv_name, points_, &stats)) return false;
+        view_ = points_.view();
+        // The file may hold fewer than maxPoints rows
+        view_.numPoints = stats.rows;
+        mapped_ = false;
+        megabytesPerSecond_ = stats.megabytesPerSecond();
+        seconds_ = omp_get_wtime() - start;
+        return true;
+    }
+
+    const DatasetView& view() const { return view_; }
+    operator DatasetView() const { return view_; }
+
+    // True when the data comes straight from a mapped binary file
+    bool mapped() const { return mapped_; }
+    double seconds() const { return seconds_; }
+    double megabytesPerSecond() const { return megabytesPerSecond_; }
+
+private:
+    BinaryDataset binary_;
+    Dataset points_;
+    DatasetView view_;
+    bool mapped_ = false;
+    double seconds_ = 0.0;
+    double megabytesPerSecond_ = 0.0;
+};
+
+#endif
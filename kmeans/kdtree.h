@@ -0,0 +1,413 @@
+#ifndef KMEANS_KDTREE_H
+#define KMEANS_KDTREE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "kmeans.h"
+#include "reduction.h"
+#include "pruning.h"
+
+#if !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/*
+    KD-TREE FILTERING
+
+    Kanungo et al. (2002) filtering algorithm. A kd-tree is built once over the data set; every
+    node stores the bounding box, the number of points and the coordinate sum of its subtree.
+    Each iteration walks the tree with the list of candidate centroids: at every node the
+    candidate z* closest to the middle of the box is found, and every candidate that is farther
+    than z* from all the corners of the box is dropped. When one candidate is left the whole
+    subtree belongs to it and its sum and count are added at once; otherwise the walk continues
+    down to the leaves, where points are assigned one by one against the few candidates left.
+    Assignment and update therefore take one walk over a small part of the tree instead of two
+    passes over the data. Subtrees near the root are distributed as OpenMP tasks.
+
+    Candidates are only dropped when they are strictly farther for every point of the box
+    (with the BOUND_EPS margin of pruning.h), so the labels are the Lloyd labels for the same
+    centroids; only the order in which the centroid sums are added differs.
+*/
+
+// Points per leaf of the tree
+const int KDTREE_LEAF_SIZE = 32;
+
+// Levels of the tree whose subtrees become OpenMP tasks
+const int KDTREE_TASK_DEPTH = 8;
+
+/*
+    Kd-tree over a data set, split at the median of the widest dimension of each box.
+    Nodes are stored in heap order (children of node v are 2v + 1 and 2v + 2) and the tree
+    keeps a permutation of the point ids, so the data set itself is not reordered. The tree
+    doesn't depend on the centroids, so it can be reused across restarts and values of k.
+*/
+class KdTree {
+public:
+    KdTree(const DatasetView& data, int leafSize = KDTREE_LEAF_SIZE) : data_(data), leafSize_(leafSize) {
+        const long long int n = data.numPoints;
+        depth_ = 0;
+        while (((n + (1LL << depth_) - 1) >> depth_) > leafSize) depth_++;
+        numNodes_ = (2LL << depth_) - 1;
+        dims_ = data.dims;
+
+        order_.resize(n);
+        begin_.assign(numNodes_, 0);
+        end_.assign(numNodes_, 0);
+        boxMin_.assign(numNodes_ * dims_, 0.0);
+        boxMax_.assign(numNodes_ * dims_, 0.0);
+        sum_.assign(numNodes_ * dims_, 0.0);
+
+        #pragma omp parallel for schedule(static)
+        for (long long int i = 0; i < n; i++) order_[i] = i;
+
+        root_box();
+        #pragma omp parallel
+        #pragma omp single
+        build(0, 0, n, 0);
+    }
+
+    const DatasetView& data() const { return data_; }
+    int dims() const { return dims_; }
+    int depth() const { return depth_; }
+    long long int numNodes() const { return numNodes_; }
+
+    bool leaf(long long int v) const { return 2 * v + 1 >= numNodes_ || end_[v] - begin_[v] <= leafSize_; }
+    long long int begin(long long int v) const { return begin_[v]; }
+    long long int end(long long int v) const { return end_[v]; }
+    long long int count(long long int v) const { return end_[v] - begin_[v]; }
+    const double* boxMin(long long int v) const { return &boxMin_[v * dims_]; }
+    const double* boxMax(long long int v) const { return &boxMax_[v * dims_]; }
+    const double* sum(long long int v) const { return &sum_[v * dims_]; }
+
+    // Point id at position p of the tree order
+    long long int point(long long int p) const { return order_[p]; }
+
+private:
+    void build(long long int v, long long int begin, long long int end, int depth) {
+        begin_[v] = begin;
+        end_[v] = end;
+        double* lo = &boxMin_[v * dims_];
+        double* hi = &boxMax_[v * dims_];
+        double* s = &sum_[v * dims_];
+
+        // The root box is computed in parallel by the constructor
+        const bool isLeaf = end - begin <= leafSize_ || 2 * v + 1 >= numNodes_;
+        if (v != 0) {
+            for (int d = 0; d < dims_; d++) {
+                lo[d] = INFINITY;
+                hi[d] = -INFINITY;
+                s[d] = 0.0;
+            }
+            for (long long int p = begin; p < end; p++) {
+                for (int d = 0; d < dims_; d++) {
+                    double value = data_.at(order_[p], d);
+                    if (value < lo[d]) lo[d] = value;
+                    if (value > hi[d]) hi[d] = value;
+                    if (isLeaf) s[d] += value;
+                }
+            }
+        }
+        if (isLeaf) return;
+
+        // Split at the median of the widest dimension of the box
+        int split = 0;
+        for (int d = 1; d < dims_; d++) {
+            if (hi[d] - lo[d] > hi[split] - lo[split]) split = d;
+        }
+        const long long int mid = begin + (end - begin) / 2;
+        const DatasetView& data = data_;
+        std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+                         [&](long long int a, long long int b) { return data.at(a, split) < data.at(b, split); });
+
+        if (depth < KDTREE_TASK_DEPTH) {
+            #pragma omp task
+            build(2 * v + 1, begin, mid, depth + 1);
+            #pragma omp task
+            build(2 * v + 2, mid, end, depth + 1);
+            #pragma omp taskwait
+        } else {
+            build(2 * v + 1, begin, mid, depth + 1);
+            build(2 * v + 2, mid, end, depth + 1);
+        }
+
+        const long long int left = 2 * v + 1, right = 2 * v + 2;
+        for (int d = 0; d < dims_; d++) {
+            s[d] = sum_[left * dims_ + d] + sum_[right * dims_ + d];
+        }
+    }
+
+    // Bounding box (and sum, for a root that is a leaf) of all the points
+    void root_box() {
+        const long long int n = data_.numPoints;
+        for (int d = 0; d < dims_; d++) {
+            double lo = INFINITY, hi = -INFINITY, sum = 0.0;
+            #pragma omp parallel for reduction(min:lo) reduction(max:hi) reduction(+:sum) schedule(static)
+            for (long long int i = 0; i < n; i++) {
+                double value = data_.at(i, d);
+                lo = value < lo ? value : lo;
+                hi = value > hi ? value : hi;
+                sum += value;
+            }
+            boxMin_[d] = lo;
+            boxMax_[d] = hi;
+            sum_[d] = sum;
+        }
+    }
+
+    DatasetView data_;
+    int leafSize_;
+    int dims_ = 0;
+    int depth_ = 0;
+    long long int numNodes_ = 0;
+    std::vector<long long int> order_;
+    std::vector<long long int> begin_;
+    std::vector<long long int> end_;
+    std::vector<double> boxMin_;
+    std::vector<double> boxMax_;
+    std::vector<double> sum_;
+};
+
+/*
+    State of one filtering walk. Sums, sizes and change counts are per thread; tasks are
+    tied, so a task keeps using the slot of the thread that started it.
+*/
+struct KdFilterState {
+    const KdTree* tree;
+    const double* centroids;
+    int k;
+    int* clusterAssignment;
+    int* owner;             // per node: centroid owning the whole subtree, -1 if mixed or unknown
+    ReductionWorkspace* workspace; // per thread sums and sizes
+    long long int* changes;        // per thread, padded to a cache line
+};
+
+// True when centroid z is farther than zStar from every point of the box [lo, hi]
+inline bool farther_in_box(const double* z, const double* zStar, const double* lo, const double* hi, int dims) {
+    double distZ = 0.0, distStar = 0.0;
+    for (int d = 0; d < dims; d++) {
+        // Corner of the box furthest in the direction z - zStar
+        double corner = z[d] > zStar[d] ? hi[d] : lo[d];
+        double diffZ = z[d] - corner;
+        double diffStar = zStar[d] - corner;
+        distZ += diffZ * diffZ;
+        distStar += diffStar * diffStar;
+    }
+    return distZ - distStar > BOUND_EPS * (distZ + distStar);
+}
+
+// Labels every point of subtree v with c and marks the subtree as owned by c
+inline void own_subtree(KdFilterState& s, long long int v, int c, long long int& changes) {
+    const KdTree& tree = *s.tree;
+    for (long long int p = tree.begin(v); p < tree.end(v); p++) {
+        long long int i = tree.point(p);
+        if (s.clusterAssignment[i] != c) {
+            s.clusterAssignment[i] = c;
+            changes++;
+        }
+    }
+    // Descendants share the node's range, so they are owned too
+    for (long long int first = v, last = v; first < tree.numNodes(); first = 2 * first + 1, last = 2 * last + 2) {
+        for (long long int u = first; u <= last && u < tree.numNodes(); u++) s.owner[u] = c;
+    }
+}
+
+template <int D>
+inline void kd_filter(KdFilterState& s, long long int v, const int* candidates, int numCandidates, int* scratch,
+                      int depth) {
+    const KdTree& tree = *s.tree;
+    const int dims = dimensions<D>(tree.dims());
+    const int t = omp_get_thread_num();
+    double* sums = s.workspace->sums(t);
+    long long int* sizes = s.workspace->sizes(t);
+    long long int& changes = s.changes[t * 8];
+
+    if (tree.count(v) == 0) return;
+
+    if (tree.leaf(v)) {
+        double x[D > 0 ? D : 1];
+        std::vector<double> runtimeX(D > 0 ? 0 : dims);
+        double* point = D > 0 ? x : runtimeX.data();
+        int owner = -2;
+        for (long long int p = tree.begin(v); p < tree.end(v); p++) {
+            long long int i = tree.point(p);
+            gather_point<D>(tree.data(), i, point);
+            int best = candidates[0];
+            double bestDist = squared_distance<D>(point, s.centroids, best, dims);
+            for (int c = 1; c < numCandidates; c++) {
+                int j = candidates[c];
+                double dist = squared_distance<D>(point, s.centroids, j, dims);
+                if (closer_centroid(dist, j, bestDist, best)) {
+                    best = j;
+                    bestDist = dist;
+                }
+            }
+            sizes[best]++;
+            for (int d = 0; d < dims; d++) sums[best * dims + d] += point[d];
+            if (s.clusterAssignment[i] != best) {
+                s.clusterAssignment[i] = best;
+                changes++;
+            }
+            owner = owner == -2 || owner == best ? best : -1;
+        }
+        s.owner[v] = owner;
+        return;
+    }
+
+    // Candidate closest to the middle of the box
+    const double* lo = tree.boxMin(v);
+    const double* hi = tree.boxMax(v);
+    int zStar = candidates[0];
+    double zStarDist = INFINITY;
+    for (int c = 0; c < numCandidates; c++) {
+        int j = candidates[c];
+        double dist = 0.0;
+        for (int d = 0; d < dims; d++) {
+            double diff = s.centroids[j * dims + d] - 0.5 * (lo[d] + hi[d]);
+            dist += diff * diff;
+        }
+        if (dist < zStarDist) {
+            zStarDist = dist;
+            zStar = j;
+        }
+    }
+
+    // Drop the candidates that can't be the closest to any point of the box
+    int* kept = scratch;
+    int numKept = 0;
+    for (int c = 0; c < numCandidates; c++) {
+        int j = candidates[c];
+        if (j == zStar || !farther_in_box(s.centroids + j * dims, s.centroids + zStar * dims, lo, hi, dims)) {
+            kept[numKept++] = j;
+        }
+    }
+
+    if (numKept == 1) {
+        sizes[zStar] += tree.count(v);
+        const double* nodeSum = tree.sum(v);
+        for (int d = 0; d < dims; d++) sums[zStar * dims + d] += nodeSum[d];
+        if (s.owner[v] != zStar) own_subtree(s, v, zStar, changes);
+        return;
+    }
+
+    s.owner[v] = -1;
+    if (depth < KDTREE_TASK_DEPTH) {
+        // Each task gets its own copy of the candidates and its own scratch space
+        // (sized here: the task may run after this frame is gone)
+        std::vector<int> kept_copy(kept, kept + numKept);
+        const size_t scratchSize = (size_t)s.k * (tree.depth() - depth + 1);
+        KdFilterState* state = &s;
+        for (long long int child = 2 * v + 1; child <= 2 * v + 2; child++) {
+            #pragma omp task firstprivate(child, kept_copy, scratchSize, state, depth)
+            {
+                std::vector<int> taskScratch(scratchSize);
+                kd_filter<D>(*state, child, kept_copy.data(), (int)kept_copy.size(), taskScratch.data(), depth + 1);
+            }
+        }
+    } else {
+        kd_filter<D>(s, 2 * v + 1, kept, numKept, scratch + s.k, depth + 1);
+        kd_filter<D>(s, 2 * v + 2, kept, numKept, scratch + s.k, depth + 1);
+    }
+}
+
+template <int D>
+inline void kmeans_kdtree_impl(const KdTree& tree, int k, int maxIterations, int* clusterAssignment,
+                               InitMethod init) {
+    const DatasetView& data = tree.data();
+    const int dims = dimensions<D>(data.dims);
+    const int numThreads = omp_get_max_threads();
+
+    double* centroids = new double[dims * k];
+    init_centroids<D>(data, k, centroids, init);
+
+    int* owner = new int[tree.numNodes()];
+    for (long long int v = 0; v < tree.numNodes(); v++) owner[v] = -1;
+    ReductionWorkspace workspace(k, dims, numThreads);
+    long long int* changes = new long long int[numThreads * 8];
+    int* all = new int[k];
+    for (int j = 0; j < k; j++) all[j] = j;
+
+    KdFilterState state;
+    state.tree = &tree;
+    state.centroids = centroids;
+    state.k = k;
+    state.clusterAssignment = clusterAssignment;
+    state.owner = owner;
+    state.workspace = &workspace;
+    state.changes = changes;
+
+    bool changed = true;
+    int iter = 0;
+
+    while (changed && iter < maxIterations) {
+        changed = false;
+        iter++;
+
+        for (int i = 0; i < numThreads * 8; i++) changes[i] = 0;
+
+        // Every thread clears its own slot before it can pick up a task
+        #pragma omp parallel
+        {
+            workspace.reset(omp_get_thread_num());
+            #pragma omp single
+            {
+                std::vector<int> scratch((size_t)k * (tree.depth() + 1));
+                kd_filter<D>(state, 0, all, k, scratch.data(), 0);
+            }
+            workspace.reduce(omp_get_num_threads());
+        }
+
+        long long int reassigned = 0;
+        for (int t = 0; t < numThreads; t++) reassigned += changes[t * 8];
+        changed = reassigned > 0;
+
+        if (!changed) break;
+
+        workspace.move_to_means(centroids);
+    }
+
+    delete[] all;
+    delete[] changes;
+    delete[] owner;
+    delete[] centroids;
+}
+
+/** KD-TREE VERSION
+ *  Performs the k-means algorithm with Kanungo's filtering over a prebuilt kd-tree, using
+ *  OMP tasks. Meant for low-dimensional data; the tree can be reused for any k and seed.
+ *  Kd-tree built over the data set (KdTree tree(data))
+ *  @param tree
+ *  Number of desired clusters
+ *  @param k
+ *  Maximum number of iterations allowed for the algorithm
+ *  @param maxIterations
+ *  Output array with the cluster id of every point (size data.numPoints)
+ *  @param clusterAssignment
+ *  Initial centroids (see init.h)
+ *  @param init
+ */
+inline void kmeans_kdtree(const KdTree& tree, int k, int maxIterations, int* clusterAssignment,
+                          InitMethod init = INIT_KMEANS_PARALLEL) {
+    dispatch_dims(tree.dims(), [&](auto dim) {
+        kmeans_kdtree_impl<decltype(dim)::value>(tree, k, maxIterations, clusterAssignment, init);
+    });
+}
+
+// Same as above, building the tree for a single run
+inline void kmeans_kdtree(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                          InitMethod init = INIT_KMEANS_PARALLEL) {
+    KdTree tree(data);
+    kmeans_kdtree(tree, k, maxIterations, clusterAssignment, init);
+}
+
+#if !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
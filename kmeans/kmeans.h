@@ -0,0 +1,434 @@
+#ifndef KMEANS_KMEANS_H
+#define KMEANS_KMEANS_H
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "assign.h"
+#include "init.h"
+#include "reduction.h"
+#include "incremental.h"
+#include "trace.h"
+#include "perf.h"
+
+/*
+    Euclidean distance between point i of the data set and a centroid
+*/
+template <int D, typename T>
+inline double euclideanDistance(const BasicDatasetView<T>& data, long long int i, const double* centroid) {
+    const int dims = dimensions<D>(data.dims);
+    double dist = 0.0;
+    for (int d = 0; d < dims; d++) {
+        double diff = data.at(i, d) - centroid[d];
+        dist += diff * diff;
+    }
+    return sqrt(dist);
+}
+
+// Points handed to the assignment kernel at a time (the blocks of the first touch, see dataset.h)
+const long long int ASSIGN_BLOCK = DATASET_BLOCK;
+
+/*
+    Centroid update of the parallel engine: every thread accumulates its points into its own
+    padded slot of the workspace, the slots are reduced in parallel (see reduction.h), then
+    every non-empty cluster moves to the mean of its points. Points are handed out in the
+    ASSIGN_BLOCK blocks of lloyd_sweep, so every thread reads the pages it placed on first touch
+    and accumulates the same points, in the same order, as in a fused sweep.
+*/
+template <int D, typename T>
+inline void update_centroids_paralelo(const BasicDatasetView<T>& data, const int* clusterAssignment, double* centroids,
+                                      ReductionWorkspace& workspace) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+    const long long int numBlocks = (numPoints + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    #pragma omp parallel
+    {
+        const int t = omp_get_thread_num();
+        workspace.reset(t);
+        double* localSums = workspace.sums(t);
+        long long int* localSizes = workspace.sizes(t);
+
+        // Accumulate local sums (through a local copy of the view: the 64-bit size counters
+        // could otherwise alias its strides and force a reload per point)
+        const BasicDatasetView<T> points = data;
+        #pragma omp for schedule(static)
+        for (long long int b = 0; b < numBlocks; b++) {
+            long long int begin = b * ASSIGN_BLOCK;
+            long long int end = begin + ASSIGN_BLOCK < numPoints ? begin + ASSIGN_BLOCK : numPoints;
+            for (long long int i = begin; i < end; i++) {
+                int cluster = clusterAssignment[i];
+                localSizes[cluster]++;
+                for (int d = 0; d < dims; d++) {
+                    localSums[dims * cluster + d] += points.at(i, d);
+                }
+            }
+        }
+
+        // Combine results
+        workspace.reduce(omp_get_num_threads());
+    }
+
+    workspace.move_to_means(centroids);
+}
+
+/*
+    Fused assignment and accumulation: points [begin, end) are labeled and then added into
+    sums / sizes while the block is still in cache. Returns the number of labels that changed.
+*/
+template <int D, typename T>
+inline long long int assign_accumulate_block(const BasicDatasetView<T>& data, long long int begin, long long int end,
+                                             const BasicCentroidTable<T>& table, int* clusterAssignment, double* sums,
+                                             long long int* sizes) {
+    const int dims = dimensions<D>(data.dims);
+    long long int changed = assign_block<D>(data, begin, end, table, clusterAssignment);
+    const BasicDatasetView<T> points = data;
+    for (long long int i = begin; i < end; i++) {
+        int cluster = clusterAssignment[i];
+        sizes[cluster]++;
+        for (int d = 0; d < dims; d++) {
+            sums[dims * cluster + d] += points.at(i, d);
+        }
+    }
+    return changed;
+}
+
+/*
+    Assignment that also records every label change of points [begin, end) in list t of the
+    incremental update. Returns the number of labels that changed.
+*/
+template <int D, typename T>
+inline long long int assign_block_recording(const BasicDatasetView<T>& data, long long int begin, long long int end,
+                                            const BasicCentroidTable<T>& table, int* clusterAssignment,
+                                            IncrementalCentroids& incremental, int t) {
+    int previous[ASSIGN_BLOCK];
+    long long int changed = 0;
+    for (long long int first = begin; first < end; first += ASSIGN_BLOCK) {
+        long long int last = first + ASSIGN_BLOCK < end ? first + ASSIGN_BLOCK : end;
+        memcpy(previous, clusterAssignment + first, sizeof(int) * (last - first));
+        long long int blockChanged = assign_block<D>(data, first, last, table, clusterAssignment);
+        if (blockChanged == 0) continue;
+        changed += blockChanged;
+        for (long long int i = first; i < last; i++) {
+            if (clusterAssignment[i] != previous[i - first]) {
+                incremental.record(t, i, previous[i - first], clusterAssignment[i]);
+            }
+        }
+    }
+    return changed;
+}
+
+/*
+    Assignment and accumulation of the parallel engine in a single sweep over the data: each
+    thread labels its blocks and accumulates them into its slot of the workspace in the same
+    pass (instead of an assignment pass followed by update_centroids_paralelo reading everything
+    again), and the slots are reduced in parallel into workspace.totalSums() / totalSizes().
+    Returns the number of points whose label changed.
+*/
+template <int D, typename T>
+inline long long int lloyd_sweep(const BasicDatasetView<T>& data, const BasicCentroidTable<T>& table,
+                                 int* clusterAssignment, ReductionWorkspace& workspace,
+                                 [[maybe_unused]] TraceRecorder* trace = nullptr,
+                                 [[maybe_unused]] PerfCounters* perf = nullptr) {
+    const long long int numPoints = data.numPoints;
+    const long long int numBlocks = (numPoints + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    long long int reassigned = 0;
+
+    #pragma omp parallel reduction(+:reassigned)
+    {
+        const int t = omp_get_thread_num();
+        KMEANS_TRACE_STAMP(trace, t, TRACE_ASSIGN_BEGIN);
+        KMEANS_PERF_BEGIN(perf, t, PERF_ASSIGN);
+        workspace.reset(t);
+        double* localSums = workspace.sums(t);
+        long long int* localSizes = workspace.sizes(t);
+
+        #pragma omp for schedule(static) nowait
+        for (long long int b = 0; b < numBlocks; b++) {
+            long long int begin = b * ASSIGN_BLOCK;
+            long long int end = begin + ASSIGN_BLOCK < numPoints ? begin + ASSIGN_BLOCK : numPoints;
+            reassigned += assign_accumulate_block<D>(data, begin, end, table, clusterAssignment, localSums, localSizes);
+        }
+        KMEANS_PERF_END(perf, t, PERF_ASSIGN);
+        KMEANS_TRACE_STAMP(trace, t, TRACE_ASSIGN_END);
+
+        // Every slot must be complete before it is reduced
+        #pragma omp barrier
+        KMEANS_TRACE_STAMP(trace, t, TRACE_REDUCE_BEGIN);
+        KMEANS_PERF_BEGIN(perf, t, PERF_ACCUMULATE);
+        workspace.reduce(omp_get_num_threads());
+        KMEANS_PERF_END(perf, t, PERF_ACCUMULATE);
+        KMEANS_TRACE_STAMP(trace, t, TRACE_REDUCE_END);
+    }
+    return reassigned;
+}
+
+/*
+    One Lloyd iteration of the parallel engine: lloyd_sweep and, when some label changed, every
+    non-empty cluster moves to the mean of its points. Returns the number of points whose label
+    changed.
+*/
+template <int D, typename T>
+inline long long int lloyd_step_fused(const BasicDatasetView<T>& data, const BasicCentroidTable<T>& table,
+                                      int* clusterAssignment, double* centroids, ReductionWorkspace& workspace) {
+    long long int reassigned = lloyd_sweep<D>(data, table, clusterAssignment, workspace);
+    if (reassigned > 0) workspace.move_to_means(centroids);
+    return reassigned;
+}
+
+/*
+    K_MEANS
+
+    Centroids are stored contiguously: centroid j is centroids[j * dims] ... centroids[j * dims + dims - 1].
+    Before each assignment step they are copied into a CentroidTable (SoA) for the SIMD kernels.
+    The engines are templated on the dimension D (0 = runtime, see dims.h); kmeans_serial and
+    kmeans_paralelo pick the specialization once from data.dims.
+    They are also templated on the coordinate type T of the data set (double or float, see
+    dataset.h). With float data the distances are computed in float (twice the SIMD lanes and
+    half the bytes per point), but the centroids, the per-thread sums and their reduction stay
+    in double, so the centroids don't lose precision as the number of points grows; only ties
+    closer than float rounding can be labeled differently than with double data.
+*/
+
+template <int D, typename T>
+inline void kmeans_serial_impl(const BasicDatasetView<T>& data, int k, int maxIterations, int* clusterAssignment,
+                               InitMethod init) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+    double* centroids = new double[dims * k];
+    init_centroids<D>(data, k, centroids, init, false);
+
+    bool changed = true;
+    int iter = 0;
+
+    long long int* clusterSizes = new long long int[k];
+    double* newCentroids = new double[dims * k];
+    BasicCentroidTable<T> table(k, dims);
+    IncrementalCentroids incremental(k, dims, 1);
+    KMEANS_TRACE_ONLY(TraceRecorder* trace = TraceRecorder::active();
+                      if (trace != nullptr) trace->begin_run<D>("serial", data, k, 1);)
+    KMEANS_PERF_ONLY(PerfCounters* perf = PerfCounters::active();)
+
+    while (changed && iter < maxIterations) {
+        changed = false;
+        iter++;
+
+        // Late iterations only record the points that changed and update from those
+        const bool tracking = incremental.tracking(numPoints);
+        KMEANS_TRACE_ONLY(if (trace != nullptr) trace->begin_iteration(iter, tracking, centroids);)
+        table.load(centroids);
+        KMEANS_TRACE_STAMP(trace, 0, TRACE_ASSIGN_BEGIN);
+        KMEANS_PERF_BEGIN(perf, 0, PERF_ASSIGN);
+        long long int reassigned = tracking
+            ? assign_block_recording<D>(data, 0, numPoints, table, clusterAssignment, incremental, 0)
+            : assign_block<D>(data, 0, numPoints, table, clusterAssignment);
+        KMEANS_PERF_END(perf, 0, PERF_ASSIGN);
+        KMEANS_PERF_ONLY(if (perf != nullptr) perf->add_points((double)numPoints);)
+        KMEANS_TRACE_STAMP(trace, 0, TRACE_ASSIGN_END);
+        changed = reassigned > 0;
+
+        if (!changed) {
+            KMEANS_TRACE_ONLY(if (trace != nullptr) trace->end_iteration(0, incremental, centroids);)
+            break;
+        }
+
+        // The serial update accumulates and moves the centroids in one phase (no reduction)
+        KMEANS_TRACE_PHASE(trace, TRACE_PHASE_UPDATE, true);
+        KMEANS_PERF_BEGIN(perf, 0, PERF_ACCUMULATE);
+        if (tracking) {
+            incremental.apply<D>(data, nullptr);
+        } else {
+            for (int i = 0; i < k; i++) {
+                clusterSizes[i] = 0;
+            }
+            for (int i = 0; i < dims * k; i++) {
+                newCentroids[i] = 0.0;
+            }
+
+            for (long long int i = 0; i < numPoints; i++) {
+                int cluster = clusterAssignment[i];
+                clusterSizes[cluster]++;
+                for (int d = 0; d < dims; d++) {
+                    newCentroids[dims * cluster + d] += data.at(i, d);
+                }
+            }
+            incremental.set(newCentroids, clusterSizes);
+        }
+        KMEANS_PERF_END(perf, 0, PERF_ACCUMULATE);
+
+        incremental.move_to_means(centroids);
+        incremental.end_iteration(reassigned);
+        KMEANS_TRACE_PHASE(trace, TRACE_PHASE_UPDATE, false);
+        KMEANS_TRACE_ONLY(if (trace != nullptr) trace->end_iteration(reassigned, incremental, centroids);)
+    }
+
+    delete[] newCentroids;
+    delete[] clusterSizes;
+    delete[] centroids;
+}
+
+/*
+    Lloyd iterations of the parallel engine from the given centroids, with caller-owned
+    workspaces (sized for k, data.dims and the threads of the team). Returns the number of
+    iterations; reassigned receives the label changes of the last one (0 when it converged).
+    After every iteration observe(iteration, reassigned, incremental) is called with the sums
+    and sizes of the new labels in incremental; returning false stops the run there.
+*/
+template <int D, typename T, typename Observer>
+inline int lloyd_iterate(const BasicDatasetView<T>& data, int maxIterations, int* clusterAssignment, double* centroids,
+                         BasicCentroidTable<T>& table, ReductionWorkspace& workspace,
+                         IncrementalCentroids& incremental, long long int& reassigned, Observer&& observe) {
+    const long long int numPoints = data.numPoints;
+    bool changed = true;
+    int iter = 0;
+    reassigned = 0;
+    TraceRecorder* trace = nullptr;
+    KMEANS_TRACE_ONLY(trace = TraceRecorder::active();
+                      if (trace != nullptr) trace->begin_run<D>("parallel", data, workspace.k(),
+                                                                workspace.numThreads());)
+    PerfCounters* perf = nullptr;
+    KMEANS_PERF_ONLY(perf = PerfCounters::active();)
+
+    // Main loop - until convergance or max iterations are reached
+    while (changed && iter < maxIterations) {
+        changed = false;
+        iter++;
+
+        const bool tracking = incremental.tracking(numPoints);
+        KMEANS_TRACE_ONLY(if (trace != nullptr) trace->begin_iteration(iter, tracking, centroids);)
+        table.load(centroids);
+        reassigned = 0;
+
+        if (!tracking) {
+            // Assignment and accumulation in one sweep; centroids move only if some label changed
+            reassigned = lloyd_sweep<D>(data, table, clusterAssignment, workspace, trace, perf);
+            KMEANS_TRACE_PHASE(trace, TRACE_PHASE_UPDATE, true);
+            if (reassigned > 0) workspace.move_to_means(centroids);
+            incremental.set(workspace.totalSums(), workspace.totalSizes());
+            KMEANS_TRACE_PHASE(trace, TRACE_PHASE_UPDATE, false);
+        } else {
+            // Few changes expected: record them and update the sums from those points only
+            const long long int numBlocks = (numPoints + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+            long long int recorded = 0;
+            #pragma omp parallel reduction(+:recorded)
+            {
+                const int t = omp_get_thread_num();
+                KMEANS_TRACE_STAMP(trace, t, TRACE_ASSIGN_BEGIN);
+                KMEANS_PERF_BEGIN(perf, t, PERF_ASSIGN);
+                #pragma omp for schedule(static) nowait
+                for (long long int b = 0; b < numBlocks; b++) {
+                    long long int begin = b * ASSIGN_BLOCK;
+                    long long int end = begin + ASSIGN_BLOCK < numPoints ? begin + ASSIGN_BLOCK : numPoints;
+                    recorded += assign_block_recording<D>(data, begin, end, table, clusterAssignment, incremental, t);
+                }
+                KMEANS_PERF_END(perf, t, PERF_ASSIGN);
+                KMEANS_TRACE_STAMP(trace, t, TRACE_ASSIGN_END);
+            }
+            reassigned = recorded;
+            if (reassigned > 0) {
+                KMEANS_TRACE_PHASE(trace, TRACE_PHASE_REDUCE, true);
+                incremental.apply<D>(data, &workspace, perf);
+                KMEANS_TRACE_PHASE(trace, TRACE_PHASE_REDUCE, false);
+                KMEANS_TRACE_PHASE(trace, TRACE_PHASE_UPDATE, true);
+                incremental.move_to_means(centroids);
+                KMEANS_TRACE_PHASE(trace, TRACE_PHASE_UPDATE, false);
+            }
+        }
+        incremental.end_iteration(reassigned);
+        KMEANS_TRACE_ONLY(if (trace != nullptr) trace->end_iteration(reassigned, incremental, centroids);)
+        KMEANS_PERF_ONLY(if (perf != nullptr) perf->add_points((double)numPoints);)
+        changed = reassigned > 0;
+        if (!observe(iter, reassigned, (const IncrementalCentroids&)incremental)) break;
+    }
+    return iter;
+}
+
+template <int D, typename T>
+inline int lloyd_iterate(const BasicDatasetView<T>& data, int maxIterations, int* clusterAssignment, double* centroids,
+                         BasicCentroidTable<T>& table, ReductionWorkspace& workspace,
+                         IncrementalCentroids& incremental, long long int& reassigned) {
+    return lloyd_iterate<D>(data, maxIterations, clusterAssignment, centroids, table, workspace, incremental,
+                            reassigned, [](int, long long int, const IncrementalCentroids&) { return true; });
+}
+
+template <int D, typename T>
+inline void kmeans_paralelo_impl(const BasicDatasetView<T>& data, int k, int maxIterations, int* clusterAssignment,
+                                 InitMethod init) {
+    const int dims = dimensions<D>(data.dims);
+
+    // Initialize centroids (k-means|| by default)
+    double* centroids = new double[dims * k];
+    init_centroids<D>(data, k, centroids, init);
+
+    // Per-thread accumulators and persistent sums, allocated once for the whole run
+    ReductionWorkspace workspace(k, dims);
+    IncrementalCentroids incremental(k, dims, workspace.numThreads());
+    BasicCentroidTable<T> table(k, dims);
+
+    long long int reassigned;
+    lloyd_iterate<D>(data, maxIterations, clusterAssignment, centroids, table, workspace, incremental, reassigned);
+
+    delete[] centroids;
+}
+
+/** SERIAL VERSION
+ *  Performs the k-means algorithm for the given data points and returns the assigned cluster id.
+ *  Contiguous data set (any layout, any number of dimensions)
+ *  @param data
+ *  Number of desired clusters
+ *  @param k
+ *  Maximum number of iterations allowed for the algorithm
+ *  @param maxIterations
+ *  Output array with the cluster id of every point (size data.numPoints)
+ *  @param clusterAssignment
+ *  Initial centroids (see init.h)
+ *  @param init
+ */
+inline void kmeans_serial(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                      InitMethod init = INIT_KMEANS_PARALLEL) {
+    dispatch_dims(data.dims, [&](auto dim) {
+        kmeans_serial_impl<decltype(dim)::value>(data, k, maxIterations, clusterAssignment, init);
+    });
+}
+
+// Same as above for float32 coordinates (mixed precision: float distances, double sums)
+inline void kmeans_serial(const FloatDatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                      InitMethod init = INIT_KMEANS_PARALLEL) {
+    dispatch_dims(data.dims, [&](auto dim) {
+        kmeans_serial_impl<decltype(dim)::value>(data, k, maxIterations, clusterAssignment, init);
+    });
+}
+
+/** PARALLEL VERSION
+ *  Performs the k-means algorithm using OMP.
+ *  Contiguous data set (any layout, any number of dimensions)
+ *  @param data
+ *  Number of desired clusters
+ *  @param k
+ *  Maximum number of iterations allowed for the algorithm
+ *  @param maxIterations
+ *  Output array with the cluster id of every point (size data.numPoints)
+ *  @param clusterAssignment
+ *  Initial centroids (see init.h)
+ *  @param init
+ */
+inline void kmeans_paralelo(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                      InitMethod init = INIT_KMEANS_PARALLEL) {
+    dispatch_dims(data.dims, [&](auto dim) {
+        kmeans_paralelo_impl<decltype(dim)::value>(data, k, maxIterations, clusterAssignment, init);
+    });
+}
+
+// Same as above for float32 coordinates (mixed precision: float distances, double sums)
+inline void kmeans_paralelo(const FloatDatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                      InitMethod init = INIT_KMEANS_PARALLEL) {
+    dispatch_dims(data.dims, [&](auto dim) {
+        kmeans_paralelo_impl<decltype(dim)::value>(data, k, maxIterations, clusterAssignment, init);
+    });
+}
+
+#endif
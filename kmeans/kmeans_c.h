@@ -0,0 +1,67 @@
+#ifndef KMEANS_C_H
+#define KMEANS_C_H
+
+#include <stdint.h>
+
+/*
+    C ABI of the KMeans engine (engine.h), for FFI callers. Implemented in lib/kmeans_c.cpp,
+    built as a shared library:
+        g++ -O3 -std=c++17 -fopenmp -shared -fPIC lib/kmeans_c.cpp -o libkmeans.so
+
+    A data set is passed as a strided view: coordinate d of point i is
+    values[i * point_stride + d * dim_stride] (point_stride = dims, dim_stride = 1 for row-major
+    arrays; point_stride = 1, dim_stride = num_points for column-major ones). Nothing is copied.
+    Every call returns KMEANS_OK or a negative status; an engine must not be used by two
+    threads at once.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct kmeans_engine kmeans_engine;
+
+enum kmeans_init { KMEANS_INIT_RANDOM = 0, KMEANS_INIT_PLUS_PLUS = 1, KMEANS_INIT_PARALLEL = 2 };
+
+enum kmeans_status { KMEANS_OK = 0, KMEANS_INVALID_ARGUMENT = -1, KMEANS_OUT_OF_MEMORY = -2 };
+
+typedef struct kmeans_result {
+    /* Owned by the engine (labels by the caller when passed to fit), valid until the next fit */
+    const double* centroids; /* k * dims values, centroid by centroid */
+    const int* labels;       /* num_points values */
+    long long num_points;
+    int k;
+    int dims;
+    double inertia;
+    int iterations;
+    int converged;
+    double init_seconds;
+    double iterate_seconds;
+    int allocations;         /* buffers allocated by this fit, 0 when the shape repeats */
+} kmeans_result;
+
+/* New engine; NULL if k or max_iterations are not positive or on allocation failure */
+kmeans_engine* kmeans_create(int k, int max_iterations, int init, uint64_t seed);
+
+void kmeans_destroy(kmeans_engine* engine);
+
+/* Clusters a double data set; labels may be NULL to use the engine's buffer */
+int kmeans_fit(kmeans_engine* engine, const double* values, long long num_points, int dims, long long point_stride,
+               long long dim_stride, int* labels, kmeans_result* result);
+
+/* Same for float32 coordinates (mixed precision: float distances, double sums) */
+int kmeans_fit_f32(kmeans_engine* engine, const float* values, long long num_points, int dims,
+                   long long point_stride, long long dim_stride, int* labels, kmeans_result* result);
+
+/* Nearest centroid of the last fit of the same coordinate type for every point */
+int kmeans_predict(kmeans_engine* engine, const double* values, long long num_points, int dims,
+                   long long point_stride, long long dim_stride, int* labels);
+
+int kmeans_predict_f32(kmeans_engine* engine, const float* values, long long num_points, int dims,
+                       long long point_stride, long long dim_stride, int* labels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
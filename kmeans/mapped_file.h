@@ -0,0 +1,87 @@
+#ifndef KMEANS_MAPPED_FILE_H
+#define KMEANS_MAPPED_FILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+#include "dataset.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+    Read-only memory mapping of a whole file. On systems without mmap the file is read into
+    an aligned buffer instead, so callers only ever see data() / size().
+*/
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file can't be opened
+    bool open(const std::string& file_name) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = st.st_size;
+        if (size_ > 0) {
+            void* ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr == MAP_FAILED) {
+                ::close(fd);
+                size_ = 0;
+                return false;
+            }
+            madvise(ptr, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(ptr);
+            mapped_ = true;
+        }
+        ::close(fd);
+        return true;
+#else
+        std::ifstream in(file_name, std::ios::binary | std::ios::ate);
+        if (!in) return false;
+        size_ = (size_t)in.tellg();
+        buffer_ = static_cast<char*>(aligned_malloc(size_));
+        in.seekg(0);
+        in.read(buffer_, size_);
+        data_ = buffer_;
+        return true;
+#endif
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+        aligned_free(buffer_);
+        buffer_ = nullptr;
+        data_ = nullptr;
+        size_ = 0;
+        mapped_ = false;
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    char* buffer_ = nullptr;
+};
+
+#endif
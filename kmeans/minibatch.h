@@ -0,0 +1,228 @@
+#ifndef KMEANS_MINIBATCH_H
+#define KMEANS_MINIBATCH_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "assign.h"
+#include "init.h"
+#include "kmeans.h"
+#include "reduction.h"
+#include "random.h"
+
+/*
+    MINI-BATCH
+
+    Mini-batch k-means (Sculley, 2010) for data sets too large for a full pass per iteration.
+    Every iteration draws batchSize points uniformly (with replacement) from counter-based
+    streams, copies them into a small SoA batch and labels them with the assignment kernels.
+    Each centroid c then takes the batch points assigned to it with its own learning rate:
+        counts[c] += m_c,   eta = m_c / counts[c],   c = (1 - eta) c + eta * mean of its m_c points
+    which is the per-sample update of the paper with rate 1 / counts[c], applied in one step.
+    Batch sums are accumulated per thread (reduction.h) and combined in parallel.
+
+    Convergence: the squared distance moved by all the centroids in an iteration is smoothed
+    with an exponentially weighted moving average (weight 2 * batchSize / numPoints, at most 1)
+    and the run stops once it drops below tolerance times the mean per-coordinate variance of
+    the initialization sample. The initial centroids come from a sample of initSize points, so
+    no step reads the whole data set except the optional final assignment.
+*/
+
+struct MiniBatchOptions {
+    // Points drawn per iteration
+    long long int batchSize = 1024;
+    // Points the initial centroids are picked from (0 = 3 * batchSize, at least 10 * k)
+    long long int initSize = 0;
+    // Stop when the smoothed centroid shift is below tolerance * variance (0 = run every iteration)
+    double tolerance = 1e-4;
+    // Label every point with the final centroids; otherwise only sampled points are labeled
+    bool fullAssignment = true;
+};
+
+/*
+    Statistics of a mini-batch run: iterations, points drawn and the smoothed centroid shift
+    after every iteration.
+*/
+struct MiniBatchStats {
+    int iterations = 0;
+    long long int sampledPoints = 0;
+    bool converged = false;
+    std::vector<double> shiftEwma;
+};
+
+// Streams of the batch draws (after the ones used by init.h)
+const uint64_t MINIBATCH_STREAM_INIT = 16;
+const uint64_t MINIBATCH_STREAM_BATCH = 17;
+
+template <int D>
+inline void kmeans_minibatch_impl(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                                  const MiniBatchOptions& options, MiniBatchStats* stats, InitMethod init) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+    const long long int batchSize = options.batchSize < numPoints ? options.batchSize : numPoints;
+    const uint64_t seed = (uint64_t)rand();
+
+    // Initial centroids from a uniform sample (its variance also scales the tolerance)
+    long long int initSize = options.initSize > 0 ? options.initSize : 3 * batchSize;
+    if (initSize < 10LL * k) initSize = 10LL * k;
+    if (initSize > numPoints) initSize = numPoints;
+    Dataset sample(initSize, dims, LAYOUT_SOA);
+    #pragma omp parallel for schedule(static)
+    for (long long int s = 0; s < initSize; s++) {
+        long long int i = initSize == numPoints ? s : counter_random(seed, MINIBATCH_STREAM_INIT, s) % numPoints;
+        for (int d = 0; d < dims; d++) sample.at(s, d) = data.at(i, d);
+    }
+    double* centroids = new double[dims * k];
+    init_centroids<D>(sample.view(), k, centroids, init);
+
+    double variance = 0.0;
+    for (int d = 0; d < dims; d++) {
+        double mean = 0.0, squares = 0.0;
+        #pragma omp parallel for reduction(+:mean, squares) schedule(static)
+        for (long long int s = 0; s < initSize; s++) {
+            mean += sample.at(s, d);
+            squares += sample.at(s, d) * sample.at(s, d);
+        }
+        mean /= initSize;
+        variance += squares / initSize - mean * mean;
+    }
+    variance /= dims;
+    const double threshold = options.tolerance * variance;
+    const double alpha = 2.0 * batchSize / numPoints < 1.0 ? 2.0 * batchSize / numPoints : 1.0;
+
+    // Workspace reused by every iteration
+    Dataset batch(batchSize, dims, LAYOUT_SOA);
+    long long int* batchIds = new long long int[batchSize];
+    int* batchLabels = new int[batchSize];
+    ReductionWorkspace workspace(k, dims);
+    long long int* counts = new long long int[k]();
+    CentroidTable table(k, dims);
+    const DatasetView batchView = batch.view();
+    const long long int numBlocks = (batchSize + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+
+    if (stats != nullptr) *stats = MiniBatchStats();
+
+    double ewma = 0.0;
+    bool converged = false;
+    int iter = 0;
+
+    while (!converged && iter < maxIterations) {
+        iter++;
+        table.load(centroids);
+        double shift = 0.0;
+
+        #pragma omp parallel reduction(+:shift)
+        {
+            const int t = omp_get_thread_num();
+            workspace.reset(t);
+            double* sums = workspace.sums(t);
+            long long int* sizes = workspace.sizes(t);
+
+            // Draw the batch and copy it, so the kernels read contiguous coordinates
+            #pragma omp for schedule(static)
+            for (long long int b = 0; b < batchSize; b++) {
+                long long int i = counter_random(seed, MINIBATCH_STREAM_BATCH + iter, b) % numPoints;
+                batchIds[b] = i;
+                batchLabels[b] = -1;
+                for (int d = 0; d < dims; d++) batch.at(b, d) = data.at(i, d);
+            }
+
+            #pragma omp for schedule(static)
+            for (long long int blk = 0; blk < numBlocks; blk++) {
+                long long int begin = blk * ASSIGN_BLOCK;
+                long long int end = begin + ASSIGN_BLOCK < batchSize ? begin + ASSIGN_BLOCK : batchSize;
+                assign_block<D>(batchView, begin, end, table, batchLabels);
+                for (long long int b = begin; b < end; b++) {
+                    int c = batchLabels[b];
+                    sizes[c]++;
+                    for (int d = 0; d < dims; d++) sums[c * dims + d] += batch.at(b, d);
+                }
+            }
+
+            // The batch is drawn with replacement, so a point can fall in the blocks of two
+            // threads: its label is written by one thread, the last draw winning
+            if (!options.fullAssignment) {
+                #pragma omp single nowait
+                for (long long int b = 0; b < batchSize; b++) clusterAssignment[batchIds[b]] = batchLabels[b];
+            }
+
+            // Per-centroid learning rate step with the combined batch sums
+            workspace.reduce(omp_get_num_threads());
+            const double* totalSums = workspace.totalSums();
+            const long long int* totalSizes = workspace.totalSizes();
+            #pragma omp for schedule(static)
+            for (int c = 0; c < k; c++) {
+                long long int size = totalSizes[c];
+                if (size == 0) continue;
+                counts[c] += size;
+                const double eta = (double)size / counts[c];
+                for (int d = 0; d < dims; d++) {
+                    double sum = totalSums[c * dims + d];
+                    double moved = (1.0 - eta) * centroids[c * dims + d] + eta * (sum / size);
+                    double diff = moved - centroids[c * dims + d];
+                    shift += diff * diff;
+                    centroids[c * dims + d] = moved;
+                }
+            }
+        }
+
+        ewma = iter == 1 ? shift : (1.0 - alpha) * ewma + alpha * shift;
+        converged = options.tolerance > 0.0 && iter > 1 && ewma < threshold;
+        if (stats != nullptr) stats->shiftEwma.push_back(ewma);
+    }
+
+    if (options.fullAssignment) {
+        table.load(centroids);
+        const long long int numPointBlocks = (numPoints + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+        #pragma omp parallel for schedule(static)
+        for (long long int blk = 0; blk < numPointBlocks; blk++) {
+            long long int begin = blk * ASSIGN_BLOCK;
+            long long int end = begin + ASSIGN_BLOCK < numPoints ? begin + ASSIGN_BLOCK : numPoints;
+            assign_block<D>(data, begin, end, table, clusterAssignment);
+        }
+    }
+
+    if (stats != nullptr) {
+        stats->iterations = iter;
+        stats->sampledPoints = (long long int)iter * batchSize;
+        stats->converged = converged;
+    }
+
+    delete[] counts;
+    delete[] batchLabels;
+    delete[] batchIds;
+    delete[] centroids;
+}
+
+/** MINI-BATCH VERSION
+ *  Performs mini-batch k-means using OMP: every iteration updates the centroids from a random
+ *  batch instead of the whole data set. Approximate, for data sets too large for Lloyd.
+ *  Contiguous data set (any layout, any number of dimensions)
+ *  @param data
+ *  Number of desired clusters
+ *  @param k
+ *  Maximum number of iterations (batches) allowed for the algorithm
+ *  @param maxIterations
+ *  Output array with the cluster id of every point (size data.numPoints)
+ *  @param clusterAssignment
+ *  Batch size, initialization sample, tolerance and final assignment pass
+ *  @param options
+ *  Optional iterations, points drawn and smoothed centroid shift per iteration
+ *  @param stats
+ *  Initial centroids, picked from the initialization sample (see init.h)
+ *  @param init
+ */
+inline void kmeans_minibatch(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                             const MiniBatchOptions& options = MiniBatchOptions(), MiniBatchStats* stats = nullptr,
+                             InitMethod init = INIT_KMEANS_PARALLEL) {
+    dispatch_dims(data.dims, [&](auto dim) {
+        kmeans_minibatch_impl<decltype(dim)::value>(data, k, maxIterations, clusterAssignment, options, stats, init);
+    });
+}
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef KMEANS_NUMA_H
+#define KMEANS_NUMA_H
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "dataset.h"
+
+/*
+    NUMA placement
+
+    On a machine with several sockets every page lives on the node of the thread that touched
+    it first, and a thread reading another node's memory pays the interconnect on every
+    iteration. Three pieces keep the engines local:
+        - data placement: a Dataset is zeroed in parallel with the engines' static block
+          schedule (see dataset.h), so it must be created with the thread count of the runs;
+          place_dataset copies a view (e.g. a mapped binary file, whose pages sit wherever
+          the reader faulted them) into a data set placed for the current team,
+        - thread affinity: pin_threads binds OMP thread t to one CPU, AFFINITY_COMPACT
+          filling a node before the next one and AFFINITY_SCATTER alternating nodes, and
+          records the node of every thread,
+        - per-node reduction: a ReductionWorkspace created while the threads are pinned over
+          several nodes reduces the per-thread sums first within each node and then across
+          nodes (see reduction.h), so only one partial per node crosses the interconnect.
+    The topology comes from /sys/devices/system/node; without it (another OS, no NUMA support)
+    the machine is one node with every CPU and pinning is a no-op. pin_threads takes the
+    place of OMP_PROC_BIND / OMP_PLACES, which can't be changed after the runtime starts; the
+    binding holds for later teams of the same size, whose threads the runtime reuses.
+*/
+
+// Granularity of the placement of memory on the nodes
+const size_t NUMA_PAGE_BYTES = 4096;
+
+enum ThreadAffinity { AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SCATTER };
+
+inline bool parse_thread_affinity(const std::string& name, ThreadAffinity& affinity) {
+    if (name == "none") affinity = AFFINITY_NONE;
+    else if (name == "compact") affinity = AFFINITY_COMPACT;
+    else if (name == "scatter") affinity = AFFINITY_SCATTER;
+    else return false;
+    return true;
+}
+
+inline const char* thread_affinity_name(ThreadAffinity affinity) {
+    return affinity == AFFINITY_COMPACT ? "compact" : affinity == AFFINITY_SCATTER ? "scatter" : "none";
+}
+
+// Ids of a sysfs list such as "0-15,32-47"
+inline std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream in(text);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        if (range.empty() || range[0] < '0' || range[0] > '9') continue;
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+struct NumaTopology {
+    // CPUs of every node, in id order
+    std::vector<std::vector<int>> nodeCpus;
+
+    int numNodes() const { return (int)nodeCpus.size(); }
+
+    int numCpus() const {
+        int total = 0;
+        for (const std::vector<int>& cpus : nodeCpus) total += (int)cpus.size();
+        return total;
+    }
+
+    // CPU of thread t out of numThreads
+    int cpu_of(int t, ThreadAffinity affinity) const {
+        const int cpus = numCpus();
+        if (affinity == AFFINITY_SCATTER) {
+            // Round robin over the nodes, then over the CPUs of each node
+            const int node = t % numNodes();
+            const std::vector<int>& list = nodeCpus[node];
+            return list[(t / numNodes()) % list.size()];
+        }
+        int index = t % cpus;
+        for (const std::vector<int>& list : nodeCpus) {
+            if (index < (int)list.size()) return list[index];
+            index -= (int)list.size();
+        }
+        return nodeCpus[0][0];
+    }
+
+    int node_of_cpu(int cpu) const {
+        for (int n = 0; n < numNodes(); n++) {
+            for (int c : nodeCpus[n]) {
+                if (c == cpu) return n;
+            }
+        }
+        return 0;
+    }
+};
+
+/*
+    Nodes with CPUs from /sys/devices/system/node; one node with omp_get_num_procs() CPUs when
+    there is no NUMA information
+*/
+inline NumaTopology numa_topology() {
+    NumaTopology topology;
+#ifdef __linux__
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string text;
+    if (online.is_open() && std::getline(online, text)) {
+        for (int node : parse_cpu_list(text)) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if (!in.is_open() || !std::getline(in, list)) continue;
+            std::vector<int> cpus = parse_cpu_list(list);
+            if (!cpus.empty()) topology.nodeCpus.push_back(cpus);
+        }
+    }
+#endif
+    if (topology.nodeCpus.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < omp_get_num_procs(); cpu++) cpus.push_back(cpu);
+        topology.nodeCpus.push_back(cpus);
+    }
+    return topology;
+}
+
+/*
+    Node of every OMP thread, as left by the last pin_threads (empty when the threads aren't
+    pinned). Read by ReductionWorkspace; set_thread_nodes is there for callers that pin their
+    threads by other means.
+*/
+inline std::vector<int>& thread_nodes() {
+    static std::vector<int> nodes;
+    return nodes;
+}
+
+inline void set_thread_nodes(const std::vector<int>& nodes) { thread_nodes() = nodes; }
+
+/*
+    Binds OMP threads 0..numThreads-1 to one CPU each (AFFINITY_NONE lets them run on every
+    CPU again) and records their nodes. Returns false (after reporting it) if the OS refused.
+*/
+inline bool pin_threads(ThreadAffinity affinity, int numThreads = omp_get_max_threads()) {
+    const NumaTopology topology = numa_topology();
+    std::vector<int> nodes(numThreads, 0);
+    bool ok = true;
+#ifdef __linux__
+    // errno is per thread: keep the one of a thread that failed
+    int error = 0;
+    #pragma omp parallel num_threads(numThreads) reduction(&&:ok)
+    {
+        const int t = omp_get_thread_num();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (affinity == AFFINITY_NONE) {
+            for (const std::vector<int>& cpus : topology.nodeCpus) {
+                for (int cpu : cpus) CPU_SET(cpu, &set);
+            }
+        } else {
+            const int cpu = topology.cpu_of(t, affinity);
+            CPU_SET(cpu, &set);
+            nodes[t] = topology.node_of_cpu(cpu);
+        }
+        ok = sched_setaffinity(0, sizeof(set), &set) == 0;
+        if (!ok) {
+            const int failure = errno;
+            #pragma omp critical(kmeans_pin_threads)
+            error = failure;
+        }
+    }
+    if (!ok) std::cerr << "Couldn't set the affinity of the threads: " << strerror(error) << "\n";
+#endif
+    if (affinity == AFFINITY_NONE || !ok) nodes.clear();
+    set_thread_nodes(nodes);
+    return ok;
+}
+
+/*
+    Copy of data whose pages are placed for the current team (same layout and type)
+*/
+template <typename T>
+inline BasicDataset<T> place_dataset(const BasicDatasetView<T>& data) {
+    BasicDataset<T> placed(data.numPoints, data.dims, data.layout);
+    const long long int numBlocks = (data.numPoints + DATASET_BLOCK - 1) / DATASET_BLOCK;
+    #pragma omp parallel for schedule(static)
+    for (long long int b = 0; b < numBlocks; b++) {
+        const long long int begin = b * DATASET_BLOCK;
+        const long long int end = begin + DATASET_BLOCK < data.numPoints ? begin + DATASET_BLOCK : data.numPoints;
+        for (int d = 0; d < data.dims; d++) {
+            for (long long int i = begin; i < end; i++) placed.at(i, d) = data.at(i, d);
+        }
+    }
+    return placed;
+}
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef KMEANS_PERF_H
+#define KMEANS_PERF_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+    Hardware performance counters
+
+    Optional perf_event_open counters (cycles, instructions, last level cache misses and
+    branch misses) around the phases of kmeans_serial and the parallel engine behind
+    kmeans_paralelo:
+        assign      serial: the assignment; parallel: the fused sweep, which labels and
+                    accumulates every block while it is in cache (see lloyd_sweep), or the
+                    recording assignment of the incremental iterations
+        accumulate  serial: the accumulation of the new sums; parallel: the reduction of the
+                    per-thread sums, or the application of the recorded changes
+    Build with -DKMEANS_PERF to compile the hooks in (like KMEANS_TRACE, see trace.h, the
+    KMEANS_PERF_* macros expand to nothing otherwise) and count while a PerfScope is alive on
+    the thread that calls the engine.
+
+    Every thread opens its own counter group the first time it enters a phase (the counters
+    follow that thread only, user space only) and adds the deltas of each phase to its own
+    padded slot; the group is reopened if another OS thread shows up with the same OMP
+    thread number. Values are scaled by the enabled / running time when the kernel
+    multiplexes the counters. When perf_event_open isn't there or is refused (not Linux,
+    perf_event_paranoid, containers, virtual machines without a PMU) nothing is counted,
+    available() is false and reason() says why; events the CPU doesn't have are reported as
+    missing and the rest are still counted.
+*/
+
+#ifdef KMEANS_PERF
+#define KMEANS_PERF_ONLY(...) __VA_ARGS__
+#define KMEANS_PERF_BEGIN(perf, t, phase) \
+    do { if ((perf) != nullptr) (perf)->begin((t), (phase)); } while (0)
+#define KMEANS_PERF_END(perf, t, phase) \
+    do { if ((perf) != nullptr) (perf)->end((t), (phase)); } while (0)
+#else
+#define KMEANS_PERF_ONLY(...)
+#define KMEANS_PERF_BEGIN(perf, t, phase) do {} while (0)
+#define KMEANS_PERF_END(perf, t, phase) do {} while (0)
+#endif
+
+enum PerfEvent { PERF_CYCLES = 0, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_BRANCH_MISSES, PERF_EVENTS };
+
+enum PerfPhase { PERF_ASSIGN = 0, PERF_ACCUMULATE, PERF_PHASES };
+
+inline const char* perf_event_name(PerfEvent event) {
+    static const char* const names[PERF_EVENTS] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+    return names[event];
+}
+
+inline const char* perf_phase_name(PerfPhase phase) {
+    static const char* const names[PERF_PHASES] = {"assign", "accumulate"};
+    return names[phase];
+}
+
+// Bytes moved per last level cache miss
+const double PERF_LINE_BYTES = 64.0;
+
+// Counts of one phase, summed over threads
+struct PerfValues {
+    double count[PERF_EVENTS] = {0.0, 0.0, 0.0, 0.0};
+    // False for the events that couldn't be opened
+    bool counted[PERF_EVENTS] = {false, false, false, false};
+
+    double ipc() const {
+        return counted[PERF_CYCLES] && counted[PERF_INSTRUCTIONS] && count[PERF_CYCLES] > 0.0
+            ? count[PERF_INSTRUCTIONS] / count[PERF_CYCLES] : 0.0;
+    }
+
+    // Bytes brought from memory (LLC misses times the line size) per point visited
+    double bytes_per_point(double pointsVisited) const {
+        return counted[PERF_LLC_MISSES] && pointsVisited > 0.0
+            ? count[PERF_LLC_MISSES] * PERF_LINE_BYTES / pointsVisited : 0.0;
+    }
+};
+
+class PerfCounters {
+public:
+    explicit PerfCounters(int numThreads = omp_get_max_threads()) : slots_(numThreads) {}
+
+    ~PerfCounters() {
+        for (ThreadSlot& slot : slots_) close_group(slot);
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Counters the engines called from this thread report to (nullptr: none)
+    static PerfCounters*& active() {
+        static thread_local PerfCounters* current = nullptr;
+        return current;
+    }
+
+    // True when some thread could open its counters
+    bool available() const {
+        for (const ThreadSlot& slot : slots_) {
+            if (slot.leader >= 0) return true;
+        }
+        return false;
+    }
+
+    // Why nothing is counted (empty when available)
+    std::string reason() const {
+        if (available()) return "";
+        for (const ThreadSlot& slot : slots_) {
+            if (slot.error != 0) return std::string("perf_event_open: ") + strerror(slot.error);
+        }
+#ifdef __linux__
+        return "no phase was measured";
+#else
+        return "perf_event_open needs Linux";
+#endif
+    }
+
+    // Forgets the counts (the counter groups stay open)
+    void clear() {
+        for (ThreadSlot& slot : slots_) memset(slot.total, 0, sizeof(slot.total));
+        pointsVisited_ = 0.0;
+    }
+
+    // Points swept per phase, added by the engine once per iteration
+    void add_points(double points) { pointsVisited_ += points; }
+    double points_visited() const { return pointsVisited_; }
+
+    // Phase totals over all threads
+    PerfValues totals(PerfPhase phase) const {
+        PerfValues values;
+        for (const ThreadSlot& slot : slots_) {
+            for (int e = 0; e < PERF_EVENTS; e++) {
+                values.count[e] += slot.total[phase][e];
+                values.counted[e] = values.counted[e] || slot.index[e] >= 0;
+            }
+        }
+        return values;
+    }
+
+    // Called by thread t of the engine's team when it enters / leaves a phase
+    void begin(int t, PerfPhase phase) {
+        if (t >= (int)slots_.size()) return;
+        ThreadSlot& slot = slots_[t];
+        if (!ready(slot)) return;
+        read_group(slot, slot.start[phase]);
+    }
+
+    void end(int t, PerfPhase phase) {
+        if (t >= (int)slots_.size()) return;
+        ThreadSlot& slot = slots_[t];
+        if (slot.leader < 0 || slot.tid != current_tid()) return;
+        double now[PERF_EVENTS + 2];
+        if (!read_group(slot, now)) return;
+        const double* start = slot.start[phase];
+        // Counts scaled by enabled / running time of this interval (multiplexing)
+        const double enabled = now[PERF_EVENTS] - start[PERF_EVENTS];
+        const double running = now[PERF_EVENTS + 1] - start[PERF_EVENTS + 1];
+        const double scale = running > 0.0 ? enabled / running : 1.0;
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            if (slot.index[e] >= 0) slot.total[phase][e] += (now[e] - start[e]) * scale;
+        }
+    }
+
+private:
+    // Padded so the threads' slots don't share a cache line
+    struct alignas(64) ThreadSlot {
+        int leader = -1;
+        int fds[PERF_EVENTS] = {-1, -1, -1, -1};
+        // Position of every event in the group read, -1 if it couldn't be opened
+        int index[PERF_EVENTS] = {-1, -1, -1, -1};
+        int members = 0;
+        long tid = 0;
+        int error = 0;
+        bool failed = false;
+        // Values at the start of each phase: events, time enabled, time running
+        double start[PERF_PHASES][PERF_EVENTS + 2] = {};
+        double total[PERF_PHASES][PERF_EVENTS] = {};
+    };
+
+    static long current_tid() {
+#ifdef __linux__
+        return syscall(SYS_gettid);
+#else
+        return 0;
+#endif
+    }
+
+    // Opens the group of the calling thread if needed; false when it can't count
+    bool ready(ThreadSlot& slot) {
+        const long tid = current_tid();
+        if (slot.leader >= 0 && slot.tid == tid) return true;
+        if (slot.failed && slot.tid == tid) return false;
+        close_group(slot);
+        slot.tid = tid;
+        slot.failed = !open_group(slot);
+        return !slot.failed;
+    }
+
+    bool open_group(ThreadSlot& slot) {
+#ifdef __linux__
+        static const uint64_t configs[PERF_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[e];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, slot.leader, 0);
+            if (fd < 0) {
+                // Without the cycles (the group leader) nothing else is opened
+                slot.error = errno;
+                if (e == PERF_CYCLES) return false;
+                continue;
+            }
+            if (slot.leader < 0) slot.leader = fd;
+            slot.fds[e] = fd;
+            slot.index[e] = slot.members++;
+        }
+        return true;
+#else
+        (void)slot;
+        return false;
+#endif
+    }
+
+    void close_group(ThreadSlot& slot) {
+#ifdef __linux__
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            if (slot.fds[e] >= 0) close(slot.fds[e]);
+        }
+#endif
+        for (int e = 0; e < PERF_EVENTS; e++) slot.fds[e] = slot.index[e] = -1;
+        slot.leader = -1;
+        slot.members = 0;
+    }
+
+    // Current values of the group: one per event, then time enabled and time running
+    bool read_group(const ThreadSlot& slot, double* values) {
+#ifdef __linux__
+        uint64_t buffer[3 + PERF_EVENTS];
+        const ssize_t bytes = sizeof(uint64_t) * (3 + slot.members);
+        if (read(slot.leader, buffer, bytes) != bytes) return false;
+        for (int e = 0; e < PERF_EVENTS; e++) values[e] = slot.index[e] >= 0 ? (double)buffer[3 + slot.index[e]] : 0.0;
+        values[PERF_EVENTS] = (double)buffer[1];
+        values[PERF_EVENTS + 1] = (double)buffer[2];
+        return true;
+#else
+        (void)slot;
+        (void)values;
+        return false;
+#endif
+    }
+
+    std::vector<ThreadSlot> slots_;
+    double pointsVisited_ = 0.0;
+};
+
+/*
+    Counts the engines called from this thread into counters while alive
+*/
+class PerfScope {
+public:
+    explicit PerfScope(PerfCounters& counters) : previous_(PerfCounters::active()) {
+        PerfCounters::active() = &counters;
+    }
+    ~PerfScope() { PerfCounters::active() = previous_; }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    PerfCounters* previous_;
+};
+
+#endif
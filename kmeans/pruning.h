@@ -0,0 +1,118 @@
+#ifndef KMEANS_PRUNING_H
+#define KMEANS_PRUNING_H
+
+#include <cmath>
+#include <vector>
+
+#include "dataset.h"
+#include "dims.h"
+#include "assign.h"
+
+/*
+    Shared pieces of the bound-based (triangle inequality) engines
+
+    The bounds only decide which distances can be skipped; every distance that is actually
+    compared is the exact squared distance evaluated in the same order as the assignment
+    kernels, with ties kept on the lowest centroid id. A centroid is skipped only when its
+    bound proves it strictly farther than the current one, and the bounds are widened by a
+    relative margin after every update to absorb rounding, so the labels are the same as the
+    Lloyd labels for the same centroids.
+*/
+
+#if !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Relative margin applied to every bound after it is computed or updated
+const double BOUND_EPS = 1e-9;
+
+inline double upper_bound_of(double dist) { return dist * (1.0 + BOUND_EPS); }
+inline double lower_bound_of(double dist) { return dist > 0.0 ? dist * (1.0 - BOUND_EPS) : 0.0; }
+
+/*
+    Drift-relative bounds: instead of moving every bound after each update, a bound is stored
+    together with drift[c], the total distance centroid c has moved since the start of the run.
+        stored lower = lower + drift[c]     current lower = stored - drift[c]
+        stored upper = upper - drift[c]     current upper = stored + drift[c]
+    which is the same as subtracting (adding) every shift since the bound was stored, so bounds
+    of skipped points are never written. The margin covers the cancellation of the subtraction.
+*/
+inline double store_lower(double dist, double drift) { return lower_bound_of(dist) + drift; }
+inline double store_upper(double dist, double drift) { return upper_bound_of(dist) - drift; }
+inline double current_lower(double stored, double drift) {
+    return stored - drift - BOUND_EPS * (fabs(stored) + drift);
+}
+inline double current_upper(double stored, double drift) {
+    return stored + drift + BOUND_EPS * (fabs(stored) + drift);
+}
+
+/*
+    Statistics of a pruned run: for every iteration the fraction of the n * k point-centroid
+    distances that didn't have to be computed.
+*/
+struct PruningStats {
+    int iterations = 0;
+    std::vector<double> skippedFraction;
+
+    double meanSkipped() const {
+        double sum = 0.0;
+        for (double f : skippedFraction) sum += f;
+        return skippedFraction.empty() ? 0.0 : sum / skippedFraction.size();
+    }
+};
+
+// Copies the coordinates of point i into x, so repeated distances read one contiguous row
+template <int D>
+inline void gather_point(const DatasetView& data, long long int i, double* x) {
+    const int dims = dimensions<D>(data.dims);
+    for (int d = 0; d < dims; d++) x[d] = data.at(i, d);
+}
+
+// Exact squared distance between a gathered point and centroid j (centroids stored point by point)
+template <int D>
+inline double squared_distance(const double* x, const double* centroids, int j, int runtimeDims) {
+    KMEANS_NO_CONTRACT
+    const int dims = dimensions<D>(runtimeDims);
+    const double* c = centroids + (long long int)j * dims;
+    double diff = x[0] - c[0];
+    double dist = diff * diff;
+    for (int d = 1; d < dims; d++) {
+        diff = x[d] - c[d];
+        dist = dist + diff * diff;
+    }
+    return dist;
+}
+
+// True when (dist, j) beats the current best (bestDist, best), with the kernels' tie rule
+inline bool closer_centroid(double dist, int j, double bestDist, int best) {
+    return dist < bestDist || (dist == bestDist && j < best);
+}
+
+// Distance between two centroids stored point by point
+inline double centroid_distance(const double* centroids, int dims, int a, int b) {
+    double dist = 0.0;
+    for (int d = 0; d < dims; d++) {
+        double diff = centroids[a * dims + d] - centroids[b * dims + d];
+        dist += diff * diff;
+    }
+    return sqrt(dist);
+}
+
+// Adds the distance every centroid moved in the last update (upper bound) to drift
+inline void add_centroid_drift(const double* oldCentroids, const double* centroids, int k, int dims, double* drift) {
+    for (int j = 0; j < k; j++) {
+        double dist = 0.0;
+        for (int d = 0; d < dims; d++) {
+            double diff = centroids[j * dims + d] - oldCentroids[j * dims + d];
+            dist += diff * diff;
+        }
+        drift[j] += upper_bound_of(sqrt(dist));
+    }
+}
+
+#if !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
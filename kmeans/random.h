@@ -0,0 +1,33 @@
+#ifndef KMEANS_RANDOM_H
+#define KMEANS_RANDOM_H
+
+#include <cstdint>
+
+/*
+    Counter-based random numbers
+
+    A draw is a pure function of (seed, stream, counter): there is no generator state to share
+    or to hand out per thread. The parallel loops index the streams by round and the counters
+    by point id, so every point sees the same numbers whichever thread handles it and the
+    results for a seed don't depend on the number of threads or the schedule.
+    The mixing function is the SplitMix64 finalizer.
+*/
+
+inline uint64_t mix64(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// 64 random bits for draw number counter of stream stream
+inline uint64_t counter_random(uint64_t seed, uint64_t stream, uint64_t counter) {
+    return mix64(mix64(seed ^ mix64(stream)) + counter);
+}
+
+// Uniform double in [0, 1) with 53 random bits
+inline double counter_uniform(uint64_t seed, uint64_t stream, uint64_t counter) {
+    return (counter_random(seed, stream, counter) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef KMEANS_REDUCTION_H
+#define KMEANS_REDUCTION_H
+
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "numa.h"
+
+/*
+    Per-thread centroid accumulators
+
+    One block allocated per run (not per iteration) holding, for every thread, k * dims sums
+    and k sizes. Each thread's slot starts on its own cache line and is padded to a whole
+    number of lines, so threads never write to the same line while accumulating. A thread
+    zeroes its own slot (which also places the pages near it on first touch).
+    reduce() replaces the critical-section merge: the k * dims sums and the k sizes are split
+    among the threads of the team and each element adds up the slots of all threads, always
+    in thread order, so the merge is parallel and its result doesn't depend on the schedule.
+
+    When the workspace is created while the threads are pinned over several NUMA nodes (see
+    numa.h), reduce() works in two levels: the threads of every node add up the slots of that
+    node into a partial of their own, then the partials are added up in node order. Each slot
+    is then read by threads of its own node and only one partial per node crosses sockets,
+    instead of every thread reading the slots of all the others. The sums are the same up to
+    the order of the additions, which is fixed for a given placement.
+*/
+class ReductionWorkspace {
+public:
+    ReductionWorkspace(int k, int dims, int numThreads = omp_get_max_threads())
+        : k_(k), dims_(dims), numThreads_(numThreads) {
+        const size_t bytes = sizeof(double) * (size_t)k * dims + sizeof(long long int) * (size_t)k;
+        slotBytes_ = (bytes + DATASET_ALIGNMENT - 1) / DATASET_ALIGNMENT * DATASET_ALIGNMENT;
+        slots_ = static_cast<char*>(aligned_malloc(slotBytes_ * numThreads));
+        totalSums_ = static_cast<double*>(aligned_malloc(sizeof(double) * (size_t)k * dims));
+        totalSizes_ = static_cast<long long int*>(aligned_malloc(sizeof(long long int) * (size_t)k));
+        group_by_node();
+    }
+
+    ~ReductionWorkspace() {
+        aligned_free(partials_);
+        aligned_free(totalSizes_);
+        aligned_free(totalSums_);
+        aligned_free(slots_);
+    }
+
+    ReductionWorkspace(const ReductionWorkspace&) = delete;
+    ReductionWorkspace& operator=(const ReductionWorkspace&) = delete;
+
+    int k() const { return k_; }
+    int dims() const { return dims_; }
+    int numThreads() const { return numThreads_; }
+
+    // NUMA nodes the reduction is split over (1: flat reduction)
+    int numNodes() const { return groups_.empty() ? 1 : (int)groups_.size(); }
+
+    // Slot of thread t: k * dims sums (centroid by centroid) followed by k sizes
+    double* sums(int t) { return reinterpret_cast<double*>(slots_ + slotBytes_ * t); }
+    long long int* sizes(int t) { return reinterpret_cast<long long int*>(sums(t) + (size_t)k_ * dims_); }
+
+    // Zeroes slot t; called by thread t before it accumulates
+    void reset(int t) { memset(slots_ + slotBytes_ * t, 0, slotBytes_); }
+
+    /*
+        Adds up the slots of the first numThreads threads into totalSums() / totalSizes().
+        Must be called by every thread of the team (it is a worksharing loop with an implicit
+        barrier), after all of them finished accumulating.
+    */
+    void reduce(int numThreads) {
+        if (groups_.size() > 1 && numThreads == numThreads_) {
+            reduce_by_node();
+            return;
+        }
+        const long long int numSums = (long long int)k_ * dims_;
+        #pragma omp for schedule(static) nowait
+        for (int j = 0; j < k_; j++) {
+            long long int size = 0;
+            for (int t = 0; t < numThreads; t++) size += sizes(t)[j];
+            totalSizes_[j] = size;
+        }
+        #pragma omp for schedule(static)
+        for (long long int e = 0; e < numSums; e++) {
+            double sum = 0.0;
+            for (int t = 0; t < numThreads; t++) sum += sums(t)[e];
+            totalSums_[e] = sum;
+        }
+    }
+
+    const double* totalSums() const { return totalSums_; }
+    const long long int* totalSizes() const { return totalSizes_; }
+
+    // Moves every non-empty cluster to the mean of its points (after reduce)
+    void move_to_means(double* centroids) const {
+        for (int j = 0; j < k_; j++) {
+            if (totalSizes_[j] == 0) continue;
+            for (int d = 0; d < dims_; d++) {
+                centroids[(long long int)j * dims_ + d] = totalSums_[(long long int)j * dims_ + d] / totalSizes_[j];
+            }
+        }
+    }
+
+private:
+    // Threads of every node, from the placement of pin_threads, when they span several nodes
+    void group_by_node() {
+        const std::vector<int>& nodes = thread_nodes();
+        if ((int)nodes.size() != numThreads_) return;
+        std::vector<std::vector<int>> byNode;
+        for (int t = 0; t < numThreads_; t++) {
+            if (nodes[t] >= (int)byNode.size()) byNode.resize(nodes[t] + 1);
+            byNode[nodes[t]].push_back(t);
+        }
+        for (std::vector<int>& members : byNode) {
+            if (!members.empty()) groups_.push_back(members);
+        }
+        if (groups_.size() <= 1) {
+            groups_.clear();
+            return;
+        }
+        groupOf_.assign(numThreads_, 0);
+        rankOf_.assign(numThreads_, 0);
+        for (int g = 0; g < (int)groups_.size(); g++) {
+            for (int r = 0; r < (int)groups_[g].size(); r++) {
+                groupOf_[groups_[g][r]] = g;
+                rankOf_[groups_[g][r]] = r;
+            }
+        }
+        // One partial per node, on pages of its own (first touched by that node's threads)
+        partialBytes_ = (slotBytes_ + NUMA_PAGE_BYTES - 1) / NUMA_PAGE_BYTES * NUMA_PAGE_BYTES;
+        partials_ = static_cast<char*>(aligned_malloc(partialBytes_ * groups_.size(), NUMA_PAGE_BYTES));
+    }
+
+    double* partial_sums(int g) { return reinterpret_cast<double*>(partials_ + partialBytes_ * g); }
+    long long int* partial_sizes(int g) {
+        return reinterpret_cast<long long int*>(partial_sums(g) + (size_t)k_ * dims_);
+    }
+
+    void reduce_by_node() {
+        const long long int numSums = (long long int)k_ * dims_;
+        const int t = omp_get_thread_num();
+        const int g = groupOf_[t];
+        const std::vector<int>& members = groups_[g];
+        const int rank = rankOf_[t];
+        const int size = (int)members.size();
+
+        // Level 1: the threads of node g split its elements and add up the node's slots
+        double* partialSums = partial_sums(g);
+        long long int* partialSizes = partial_sizes(g);
+        const long long int firstSum = numSums * rank / size, lastSum = numSums * (rank + 1) / size;
+        for (long long int e = firstSum; e < lastSum; e++) {
+            double sum = 0.0;
+            for (int m : members) sum += sums(m)[e];
+            partialSums[e] = sum;
+        }
+        const int firstSize = (int)((long long int)k_ * rank / size), lastSize = (int)((long long int)k_ * (rank + 1) / size);
+        for (int j = firstSize; j < lastSize; j++) {
+            long long int count = 0;
+            for (int m : members) count += sizes(m)[j];
+            partialSizes[j] = count;
+        }
+        #pragma omp barrier
+
+        // Level 2: the partials of all the nodes, in node order
+        const int numGroups = (int)groups_.size();
+        #pragma omp for schedule(static) nowait
+        for (int j = 0; j < k_; j++) {
+            long long int count = 0;
+            for (int h = 0; h < numGroups; h++) count += partial_sizes(h)[j];
+            totalSizes_[j] = count;
+        }
+        #pragma omp for schedule(static)
+        for (long long int e = 0; e < numSums; e++) {
+            double sum = 0.0;
+            for (int h = 0; h < numGroups; h++) sum += partial_sums(h)[e];
+            totalSums_[e] = sum;
+        }
+    }
+
+    int k_;
+    int dims_;
+    int numThreads_;
+    size_t slotBytes_ = 0;
+    char* slots_ = nullptr;
+    std::vector<std::vector<int>> groups_;
+    std::vector<int> groupOf_;
+    std::vector<int> rankOf_;
+    size_t partialBytes_ = 0;
+    char* partials_ = nullptr;
+    double* totalSums_ = nullptr;
+    long long int* totalSizes_ = nullptr;
+};
+
+/*
+    Per-thread scratch arrays of a run (a gathered point, candidate lists, ...): count values
+    of T for each thread, allocated once like the accumulators instead of by every thread on
+    every iteration, each array starting on its own cache line.
+*/
+template <typename T>
+class ThreadScratch {
+public:
+    explicit ThreadScratch(size_t count, int numThreads = omp_get_max_threads()) {
+        const size_t bytes = sizeof(T) * (count > 0 ? count : 1);
+        strideBytes_ = (bytes + DATASET_ALIGNMENT - 1) / DATASET_ALIGNMENT * DATASET_ALIGNMENT;
+        block_ = static_cast<char*>(aligned_malloc(strideBytes_ * numThreads));
+    }
+
+    ~ThreadScratch() { aligned_free(block_); }
+
+    ThreadScratch(const ThreadScratch&) = delete;
+    ThreadScratch& operator=(const ThreadScratch&) = delete;
+
+    // Array of thread t
+    T* get(int t) { return reinterpret_cast<T*>(block_ + strideBytes_ * t); }
+
+private:
+    size_t strideBytes_ = 0;
+    char* block_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef KMEANS_REORDER_H
+#define KMEANS_REORDER_H
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+
+/*
+    Spatial reordering
+
+    Optional preprocessing that copies the data set sorted along a space-filling curve, so
+    points that are close in space are close in memory. Consecutive iterations of the OpenMP
+    loops then see the same few clusters, the chunk of every thread has a few dominant
+    clusters (its accumulators stay in cache) and neighbouring points share their pruning
+    bounds' outcome.
+
+    Every coordinate is scaled to [0, 2^b - 1] between the minimum and maximum of its
+    dimension, with b = 64 / dims bits (at most 32; with more than 64 dimensions only the
+    first 64 are used), and the bits are interleaved into a 64-bit key:
+        CURVE_MORTON   Z-order, the plain interleaving
+        CURVE_HILBERT  Hilbert curve in any number of dimensions (Skilling, 2004), which has
+                       no long jumps between consecutive cells
+    The keys are sorted with a parallel, stable LSD radix sort (ties keep the file order, so the
+    result doesn't depend on the number of threads) and the points are gathered in that order.
+
+    The permutation is kept both ways: order()[s] is the original index of sorted point s and
+    position()[i] is where original point i ended up. save_results / save_to_CSV take
+    position() to write the results in the original order.
+*/
+
+enum SpatialCurve { CURVE_NONE, CURVE_MORTON, CURVE_HILBERT };
+
+inline bool parse_spatial_curve(const std::string& name, SpatialCurve& curve) {
+    if (name == "none") curve = CURVE_NONE;
+    else if (name == "morton") curve = CURVE_MORTON;
+    else if (name == "hilbert") curve = CURVE_HILBERT;
+    else return false;
+    return true;
+}
+
+// Dimensions that take part in the key
+const int CURVE_MAX_DIMS = 64;
+
+/*
+    Hilbert transform of the cell coordinates x[0..n) with b bits each, in place (Skilling's
+    AxesToTranspose): interleaving the transformed bits gives the Hilbert index.
+*/
+inline void hilbert_transpose(uint32_t* x, int b, int n) {
+    const uint32_t m = 1u << (b - 1);
+    for (uint32_t q = m; q > 1; q >>= 1) {
+        const uint32_t p = q - 1;
+        for (int i = 0; i < n; i++) {
+            if (x[i] & q) {
+                x[0] ^= p;
+            } else {
+                uint32_t t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+    for (int i = 1; i < n; i++) x[i] ^= x[i - 1];
+    uint32_t t = 0;
+    for (uint32_t q = m; q > 1; q >>= 1) {
+        if (x[n - 1] & q) t ^= q - 1;
+    }
+    for (int i = 0; i < n; i++) x[i] ^= t;
+}
+
+// Interleaves the b low bits of x[0..n), most significant first
+inline uint64_t interleave_bits(const uint32_t* x, int b, int n) {
+    uint64_t key = 0;
+    for (int bit = b - 1; bit >= 0; bit--) {
+        for (int i = 0; i < n; i++) key = (key << 1) | ((x[i] >> bit) & 1u);
+    }
+    return key;
+}
+
+class SpatialOrder {
+public:
+    SpatialOrder() {}
+
+    // Sorts data along curve; with CURVE_NONE the copy keeps the original order
+    SpatialOrder(const DatasetView& data, SpatialCurve curve) { build(data, curve); }
+
+    void build(const DatasetView& data, SpatialCurve curve) {
+        const long long int numPoints = data.numPoints;
+        order_.assign(numPoints, 0);
+        position_.assign(numPoints, 0);
+
+        std::vector<uint64_t> keys(numPoints);
+        compute_keys(data, curve, keys.data());
+        sort_keys(keys, order_);
+
+        // Gather the points in curve order (same layout as the input)
+        points_ = Dataset(numPoints, data.dims, data.layout);
+        #pragma omp parallel for schedule(static)
+        for (long long int s = 0; s < numPoints; s++) {
+            const long long int i = order_[s];
+            position_[i] = s;
+            for (int d = 0; d < data.dims; d++) points_.at(s, d) = data.at(i, d);
+        }
+    }
+
+    // Reordered data set, what the engines should receive
+    DatasetView view() const { return points_.view(); }
+    operator DatasetView() const { return points_.view(); }
+
+    long long int size() const { return (long long int)order_.size(); }
+    const long long int* order() const { return order_.data(); }
+    const long long int* position() const { return position_.data(); }
+
+    // Labels of the reordered points back in the original order
+    void restore_labels(const int* sortedLabels, int* labels) const {
+        const long long int numPoints = size();
+        #pragma omp parallel for schedule(static)
+        for (long long int i = 0; i < numPoints; i++) labels[i] = sortedLabels[position_[i]];
+    }
+
+private:
+    static void compute_keys(const DatasetView& data, SpatialCurve curve, uint64_t* keys) {
+        const long long int numPoints = data.numPoints;
+        const int n = data.dims < CURVE_MAX_DIMS ? data.dims : CURVE_MAX_DIMS;
+        if (curve == CURVE_NONE || n == 0) {
+            #pragma omp parallel for schedule(static)
+            for (long long int i = 0; i < numPoints; i++) keys[i] = 0;
+            return;
+        }
+        const int b = 64 / n < 32 ? 64 / n : 32;
+        const double cells = (double)((1ULL << b) - 1);
+
+        // Bounding box
+        std::vector<double> low(n, INFINITY), high(n, -INFINITY);
+        for (int d = 0; d < n; d++) {
+            double lo = INFINITY, hi = -INFINITY;
+            #pragma omp parallel for reduction(min:lo) reduction(max:hi) schedule(static)
+            for (long long int i = 0; i < numPoints; i++) {
+                double v = data.at(i, d);
+                if (v < lo) lo = v;
+                if (v > hi) hi = v;
+            }
+            low[d] = lo;
+            high[d] = hi;
+        }
+        std::vector<double> scale(n);
+        for (int d = 0; d < n; d++) scale[d] = high[d] > low[d] ? cells / (high[d] - low[d]) : 0.0;
+
+        #pragma omp parallel for schedule(static)
+        for (long long int i = 0; i < numPoints; i++) {
+            uint32_t x[CURVE_MAX_DIMS];
+            for (int d = 0; d < n; d++) {
+                double cell = (data.at(i, d) - low[d]) * scale[d];
+                x[d] = cell < cells ? (uint32_t)cell : (uint32_t)cells;
+            }
+            if (curve == CURVE_HILBERT) hilbert_transpose(x, b, n);
+            keys[i] = interleave_bits(x, b, n);
+        }
+    }
+
+    /*
+        Stable LSD radix sort of the keys, 8 bits per pass, that leaves in order the indices of
+        the points by increasing key. The points are split into one contiguous chunk per thread;
+        every chunk is counted and scattered on its own and the offsets are laid out digit by
+        digit and, within a digit, in chunk order, which is what makes the sort stable. Passes
+        where all the keys share the digit are skipped.
+    */
+    static void sort_keys(std::vector<uint64_t>& keys, std::vector<long long int>& order) {
+        const long long int numPoints = (long long int)keys.size();
+        const int numChunks = omp_get_max_threads();
+        std::vector<uint64_t> keysOut(numPoints);
+        std::vector<long long int> orderOut(numPoints);
+        std::vector<long long int> counts((size_t)numChunks * 256);
+
+        #pragma omp parallel for schedule(static)
+        for (long long int i = 0; i < numPoints; i++) order[i] = i;
+
+        for (int shift = 0; shift < 64; shift += 8) {
+            #pragma omp parallel for schedule(static, 1)
+            for (int c = 0; c < numChunks; c++) {
+                long long int* count = counts.data() + (size_t)c * 256;
+                for (int v = 0; v < 256; v++) count[v] = 0;
+                const long long int end = numPoints * (c + 1) / numChunks;
+                for (long long int i = numPoints * c / numChunks; i < end; i++) count[(keys[i] >> shift) & 255]++;
+            }
+
+            // Exclusive offsets, digit-major then chunk order
+            long long int offset = 0;
+            bool single = false;
+            for (int v = 0; v < 256; v++) {
+                const long long int first = offset;
+                for (int c = 0; c < numChunks; c++) {
+                    long long int count = counts[(size_t)c * 256 + v];
+                    counts[(size_t)c * 256 + v] = offset;
+                    offset += count;
+                }
+                if (offset - first == numPoints) single = true;
+            }
+            if (single) continue;
+
+            #pragma omp parallel for schedule(static, 1)
+            for (int c = 0; c < numChunks; c++) {
+                long long int* next = counts.data() + (size_t)c * 256;
+                const long long int end = numPoints * (c + 1) / numChunks;
+                for (long long int i = numPoints * c / numChunks; i < end; i++) {
+                    long long int to = next[(keys[i] >> shift) & 255]++;
+                    keysOut[to] = keys[i];
+                    orderOut[to] = order[i];
+                }
+            }
+            keys.swap(keysOut);
+            order.swap(orderOut);
+        }
+    }
+
+    Dataset points_;
+    std::vector<long long int> order_;
+    std::vector<long long int> position_;
+};
+
+#endif
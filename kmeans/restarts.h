@@ -0,0 +1,216 @@
+#ifndef KMEANS_RESTARTS_H
+#define KMEANS_RESTARTS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "random.h"
+#include "incremental.h"
+#include "engine.h"
+
+/*
+    Multiple restarts (n_init)
+
+    Runs k-means nInit times from different seeds on the same loaded points and keeps the
+    labels and centroids of the run with the lowest inertia. Restart 0 uses the seed of the
+    options (so nInit = 1 is one plain fit) and restart r > 0 a seed drawn from it.
+
+    The restarts run concurrently, in groups of OMP threads: `concurrent` restarts at a time,
+    each with threads / concurrent threads for its point loops (nested parallelism). The
+    automatic choice gives every thread of a restart at least RESTART_POINTS_PER_THREAD points:
+    small data sets get one thread per restart (restart-level parallelism, no synchronization
+    inside a restart), large ones fewer concurrent restarts with more threads each, down to
+    one restart at a time with the whole team. Every group reuses one KMeans engine, so the
+    buffers of a group are allocated once for all its restarts.
+
+    Early abandonment: Lloyd's inertia never increases, so the current inertia of every
+    running or finished restart bounds its final one. After every iteration each restart
+    publishes its inertia (computed from the cluster sums in O(k * dims), not from the points)
+    and is abandoned when even a generous projection of its final inertia (the current one
+    minus RESTART_LOOKAHEAD times the last improvement) is still more than abandonMargin
+    above the best bound. Which restarts get abandoned depends on timing; the winner does not,
+    unless a restart within the margin of the best is cut short.
+*/
+
+// Points per thread of a restart below which the automatic mode adds concurrent restarts
+const long long int RESTART_POINTS_PER_THREAD = 65536;
+
+// Projected further improvement of a restart, in multiples of its last improvement
+const double RESTART_LOOKAHEAD = 10.0;
+
+// Stream of the seeds of restarts 1..nInit-1
+const uint64_t RESTART_STREAM_SEED = 40;
+
+struct RestartOptions {
+    int nInit = 10;
+    // Restarts run at the same time; 0 picks it from the number of points and threads
+    int concurrent = 0;
+    bool abandon = true;
+    // Relative margin over the best inertia for abandoning a restart
+    double abandonMargin = 0.05;
+    // Iterations a restart always runs before it can be abandoned (at least 2)
+    int minIterations = 3;
+};
+
+struct RestartStats {
+    int concurrent = 0;
+    int threadsPerRestart = 0;
+    int best = -1;
+    int abandoned = 0;
+    double seconds = 0.0;
+    // Per restart: final (or last, if abandoned) inertia, iterations and whether it was cut
+    std::vector<double> inertia;
+    std::vector<int> iterations;
+    std::vector<char> wasAbandoned;
+};
+
+// Restarts at a time and threads per restart for n points (concurrent = 0 means automatic)
+inline void restart_groups(long long int numPoints, int nInit, int numThreads, int concurrent,
+                           int& groups, int& threadsPerGroup) {
+    if (concurrent <= 0) {
+        long long int perRestart = numPoints / RESTART_POINTS_PER_THREAD;
+        perRestart = perRestart < 1 ? 1 : (perRestart > numThreads ? numThreads : perRestart);
+        concurrent = numThreads / (int)perRestart;
+    }
+    groups = std::max(1, std::min(std::min(concurrent, nInit), numThreads));
+    threadsPerGroup = std::max(1, numThreads / groups);
+}
+
+// Lowers bound to value if it is smaller
+inline void atomic_min(std::atomic<double>& bound, double value) {
+    double current = bound.load();
+    while (value < current && !bound.compare_exchange_weak(current, value)) {}
+}
+
+template <int D, typename T>
+inline bool kmeans_restarts_impl(const BasicDatasetView<T>& data, const KMeansOptions& options,
+                                 const RestartOptions& restartOptions, int* clusterAssignment, double* centroids,
+                                 RestartStats& stats) {
+    const int k = options.k;
+    const int dims = dimensions<D>(data.dims);
+    const int nInit = restartOptions.nInit;
+    const long long int numPoints = data.numPoints;
+    const double start = omp_get_wtime();
+
+    int groups, threadsPerGroup;
+    restart_groups(numPoints, nInit, omp_get_max_threads(), restartOptions.concurrent, groups, threadsPerGroup);
+    stats.concurrent = groups;
+    stats.threadsPerRestart = threadsPerGroup;
+    stats.best = -1;
+    stats.abandoned = 0;
+    stats.inertia.assign(nInit, 0.0);
+    stats.iterations.assign(nInit, 0);
+    stats.wasAbandoned.assign(nInit, 0);
+
+    std::vector<double> mean;
+    const double scatter = total_scatter<D>(data, mean);
+
+    // Best bound on the final inertia over all restarts, and the best finished one
+    std::atomic<double> bound(std::numeric_limits<double>::infinity());
+    double bestInertia = 0.0;
+    std::atomic<int> nextRestart(0);
+
+    // Nested teams: one outer thread per group, threadsPerGroup threads in its loops
+    const int previousLevels = omp_get_max_active_levels();
+    if (groups > 1 && threadsPerGroup > 1 && previousLevels < 2) omp_set_max_active_levels(2);
+
+    #pragma omp parallel num_threads(groups)
+    {
+        omp_set_num_threads(threadsPerGroup);
+        KMeansOptions runOptions = options;
+        BasicKMeans<T> engine(runOptions);
+        std::vector<int> labels(numPoints);
+
+        for (int r = nextRestart++; r < nInit; r = nextRestart++) {
+            runOptions.seed = r == 0 ? options.seed : counter_random(options.seed, RESTART_STREAM_SEED, r);
+            engine.set_options(runOptions);
+
+            double previous = 0.0;
+            bool abandoned = false;
+            auto observe = [&](int iteration, long long int, const IncrementalCentroids& incremental) {
+                const double inertia = inertia_from_sums(incremental, k, dims, scatter, mean.data());
+                atomic_min(bound, inertia);
+                // The projection needs the inertia of the previous iteration
+                if (restartOptions.abandon && iteration > 1 && iteration >= restartOptions.minIterations) {
+                    const double projected = inertia - RESTART_LOOKAHEAD * (previous - inertia);
+                    abandoned = projected > (1.0 + restartOptions.abandonMargin) * bound.load();
+                }
+                previous = inertia;
+                return !abandoned;
+            };
+            engine.fit(data, labels.data(), nullptr, observe);
+
+            const KMeansResult& result = engine.result();
+            stats.inertia[r] = result.inertia;
+            stats.iterations[r] = result.iterations;
+            stats.wasAbandoned[r] = abandoned;
+            if (abandoned) continue;
+            atomic_min(bound, result.inertia);
+
+            // Only the best labels leave the group's buffer; ties go to the lower restart
+            #pragma omp critical(kmeans_restarts_best)
+            {
+                if (stats.best < 0 || result.inertia < bestInertia ||
+                    (result.inertia == bestInertia && r < stats.best)) {
+                    stats.best = r;
+                    bestInertia = result.inertia;
+                    memcpy(clusterAssignment, labels.data(), sizeof(int) * numPoints);
+                    memcpy(centroids, result.centroids, sizeof(double) * k * dims);
+                }
+            }
+        }
+    }
+    omp_set_max_active_levels(previousLevels);
+
+    for (int r = 0; r < nInit; r++) stats.abandoned += stats.wasAbandoned[r];
+    stats.seconds = omp_get_wtime() - start;
+    return stats.best >= 0;
+}
+
+/** MULTIPLE RESTARTS
+ *  Runs k-means restartOptions.nInit times concurrently on the same points (see above) and
+ *  returns the labels and centroids of the run with the lowest inertia. Returns false (after
+ *  reporting it) if k doesn't fit the data.
+ *  Contiguous data set (any layout, double or float32 coordinates)
+ *  @param data
+ *  k, maxIterations, init and base seed of every restart
+ *  @param options
+ *  Number of restarts, concurrency and early abandonment
+ *  @param restartOptions
+ *  Output array with the cluster id of every point for the best restart (size data.numPoints)
+ *  @param clusterAssignment
+ *  Output centroids of the best restart (k * dims values)
+ *  @param centroids
+ *  Optional per-restart inertia, iterations and abandonment, and the chosen grouping
+ *  @param stats
+ */
+template <typename T>
+inline bool kmeans_restarts(const BasicDatasetView<T>& data, const KMeansOptions& options,
+                            const RestartOptions& restartOptions, int* clusterAssignment, double* centroids,
+                            RestartStats* stats = nullptr) {
+    const int k = options.k;
+    if (k <= 0 || data.dims <= 0 || data.numPoints < k || restartOptions.nInit <= 0) {
+        std::cerr << "Invalid k-means input: k = " << k << ", " << restartOptions.nInit << " restarts, "
+                  << data.numPoints << " points of " << data.dims << " dimensions\n";
+        return false;
+    }
+    RestartStats local;
+    RestartStats& out = stats != nullptr ? *stats : local;
+    bool ok = false;
+    dispatch_dims(data.dims, [&](auto dim) {
+        ok = kmeans_restarts_impl<decltype(dim)::value>(data, options, restartOptions, clusterAssignment, centroids,
+                                                        out);
+    });
+    return ok;
+}
+
+#endif
@@ -0,0 +1,469 @@
+#ifndef KMEANS_STREAMING_H
+#define KMEANS_STREAMING_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "assign.h"
+#include "binary.h"
+#include "init.h"
+#include "kmeans.h"
+#include "reduction.h"
+#include "random.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+/*
+    STREAMING (out of core)
+
+    Lloyd iterations over a binary data set (kmeans/binary.h) that doesn't fit in memory. The
+    file is read again on every iteration in blocks of rows; two block buffers are used so the
+    next block is read by an asynchronous task while the threads assign and accumulate the
+    current one (the read of the first block of the next iteration overlaps the last block of
+    this one, since reads don't depend on the centroids). Only the centroids, the per-thread
+    accumulators, the labels and the two buffers stay resident, and the block size is derived
+    from a memory budget. When the whole data set fits in one block it is read only once.
+
+    Labels can be bit-packed (ceil(log2(k + 1)) bits each instead of 32). Blocks and the
+    ASSIGN_BLOCK chunks inside them start at multiples of 64 points, so every chunk owns whole
+    64-bit words and is packed by one thread.
+
+    The initial centroids come from a uniform sample of the points, drawn in one streaming pass
+    with the counter-based generator (so it doesn't depend on the block size or the threads).
+    Only the binary format can be streamed: convert CSV files with tools/csv_to_binary or write
+    them directly with tools/generate_data --format bin.
+*/
+
+struct StreamingOptions {
+    // Bytes for labels, accumulators, the init sample and the two block buffers
+    size_t memoryBudget = (size_t)256 << 20;
+    // Bit-packed labels instead of 32-bit integers
+    bool compressLabels = false;
+    // Points in the initialization sample (0 = max(20 * k, 65536), at most the data set)
+    long long int initSize = 0;
+};
+
+/*
+    Statistics of a streaming run. readSeconds is time spent in the reads (on the reader task),
+    waitSeconds the time the computing threads waited for a block that wasn't read yet.
+*/
+struct StreamingStats {
+    int iterations = 0;
+    long long int blockPoints = 0;
+    long long int numBlocks = 0;
+    long long int bytesRead = 0;
+    size_t residentBytes = 0;
+    double readSeconds = 0.0;
+    double waitSeconds = 0.0;
+    double totalSeconds = 0.0;
+
+    // Read throughput of the storage and throughput seen by the whole run
+    double readMegabytesPerSecond() const { return readSeconds > 0.0 ? bytesRead / readSeconds / 1e6 : 0.0; }
+    double effectiveMegabytesPerSecond() const { return totalSeconds > 0.0 ? bytesRead / totalSeconds / 1e6 : 0.0; }
+};
+
+// Stream of the init sample draws
+const uint64_t STREAMING_STREAM_SAMPLE = 48;
+
+/*
+    Cluster ids of all the points, 32-bit or bit-packed. Stored as label + 1 so that 0 means
+    "not assigned yet" (read back as -1).
+*/
+class LabelStore {
+public:
+    LabelStore() {}
+    LabelStore(long long int numPoints, int k, bool compressed) { reset(numPoints, k, compressed); }
+
+    void reset(long long int numPoints, int k, bool compressed) {
+        numPoints_ = numPoints;
+        bits_ = 32;
+        if (compressed) {
+            bits_ = 1;
+            while ((1LL << bits_) < (long long int)k + 1) bits_++;
+        }
+        words_.assign(((size_t)numPoints * bits_ + 63) / 64, 0);
+    }
+
+    long long int size() const { return numPoints_; }
+    int bits() const { return bits_; }
+    size_t bytes() const { return words_.size() * sizeof(uint64_t); }
+
+    int get(long long int i) const {
+        const uint64_t bit = (uint64_t)i * bits_;
+        const uint64_t word = bit >> 6, offset = bit & 63;
+        uint64_t value = words_[word] >> offset;
+        if (offset + bits_ > 64) value |= words_[word + 1] << (64 - offset);
+        return (int)(value & mask()) - 1;
+    }
+
+    // Labels of points [begin, begin + count) into out
+    void unpack(long long int begin, long long int count, int* out) const {
+        for (long long int i = 0; i < count; i++) out[i] = get(begin + i);
+    }
+
+    /*
+        Stores the labels of points [begin, begin + count). begin must be a multiple of 64, so
+        the range starts on a word; it may only share its last word with the range that
+        follows it, which is why ranges are packed by whole ASSIGN_BLOCK chunks.
+    */
+    void pack(long long int begin, long long int count, const int* in) {
+        const uint64_t first = (uint64_t)begin * bits_ / 64;
+        const uint64_t last = ((uint64_t)(begin + count) * bits_ + 63) / 64;
+        for (uint64_t w = first; w < last; w++) words_[w] = 0;
+        for (long long int i = 0; i < count; i++) {
+            const uint64_t bit = (uint64_t)(begin + i) * bits_;
+            const uint64_t word = bit >> 6, offset = bit & 63;
+            const uint64_t value = (uint64_t)(in[i] + 1) & mask();
+            words_[word] |= value << offset;
+            if (offset + bits_ > 64) words_[word + 1] |= value >> (64 - offset);
+        }
+    }
+
+private:
+    uint64_t mask() const { return bits_ == 64 ? ~0ULL : (1ULL << bits_) - 1; }
+
+    long long int numPoints_ = 0;
+    int bits_ = 32;
+    std::vector<uint64_t> words_;
+};
+
+/*
+    Reader of row blocks of a binary data set file. read() fills a LAYOUT_SOA Dataset with
+    rows [begin, begin + count), one read per column.
+*/
+class BlockStream {
+public:
+    BlockStream() {}
+    ~BlockStream() { close(); }
+
+    BlockStream(const BlockStream&) = delete;
+    BlockStream& operator=(const BlockStream&) = delete;
+
+    // Returns false (after reporting it) if the file is missing or not a valid binary data set
+    bool open(const std::string& file_name) {
+        close();
+        uint64_t fileSize = 0;
+#ifndef _WIN32
+        fd_ = ::open(file_name.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd_ < 0 || fstat(fd_, &st) != 0) {
+            std::cerr << "Couldn't read file: " << file_name << "\n";
+            close();
+            return false;
+        }
+        fileSize = st.st_size;
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#else
+        in_.open(file_name, std::ios::binary | std::ios::ate);
+        if (!in_) {
+            std::cerr << "Couldn't read file: " << file_name << "\n";
+            return false;
+        }
+        fileSize = (uint64_t)in_.tellg();
+#endif
+        if (fileSize < sizeof(header_) || !read_bytes(&header_, sizeof(header_), 0)) {
+            std::cerr << "Invalid binary data set (truncated header): " << file_name << "\n";
+            close();
+            return false;
+        }
+        const char* reason = check_binary_header(header_, fileSize);
+        if (reason != nullptr) {
+            std::cerr << "Invalid binary data set (" << reason << "): " << file_name << "\n";
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+#else
+        if (in_.is_open()) in_.close();
+#endif
+    }
+
+    long long int size() const { return (long long int)header_.numPoints; }
+    int dims() const { return (int)header_.dims; }
+
+    // Reads rows [begin, begin + count) into block (capacity >= count); returns false on errors
+    bool read(long long int begin, long long int count, Dataset& block) {
+        for (int d = 0; d < dims(); d++) {
+            const uint64_t offset = header_.dataOffset + ((uint64_t)d * header_.columnStride + begin) * sizeof(double);
+            if (!read_bytes(block.column(d), sizeof(double) * count, offset)) return false;
+        }
+        return true;
+    }
+
+private:
+    bool read_bytes(void* out, size_t bytes, uint64_t offset) {
+        char* p = static_cast<char*>(out);
+#ifndef _WIN32
+        while (bytes > 0) {
+            ssize_t got = pread(fd_, p, bytes, (off_t)offset);
+            if (got <= 0) return false;
+            p += got;
+            bytes -= got;
+            offset += got;
+        }
+        return true;
+#else
+        in_.seekg((std::streamoff)offset);
+        in_.read(p, bytes);
+        return (size_t)in_.gcount() == bytes;
+#endif
+    }
+
+    BinaryHeader header_ = BinaryHeader();
+#ifndef _WIN32
+    int fd_ = -1;
+#else
+    std::ifstream in_;
+#endif
+};
+
+/*
+    Runs over every block of the stream once, calling process(view, begin) for each in order
+    while the next one is being read. The read of the block after the last one (the first of
+    the next pass) is left in flight in pending so the next pass starts without waiting; pass
+    a false prefetch on the last pass. Returns false if a read failed.
+*/
+class BlockPipeline {
+public:
+    BlockStream& stream;
+    long long int blockPoints;
+    long long int numBlocks;
+    Dataset buffers[2];
+    std::future<double> pending;
+    long long int next = 0;
+    bool loaded = false;
+    bool failed = false;
+    StreamingStats& stats;
+
+    BlockPipeline(BlockStream& s, long long int points, StreamingStats& st)
+        : stream(s), blockPoints(points), numBlocks((s.size() + points - 1) / points), stats(st) {
+        buffers[0] = Dataset(blockPoints, s.dims(), LAYOUT_SOA);
+        if (numBlocks > 1) buffers[1] = Dataset(blockPoints, s.dims(), LAYOUT_SOA);
+    }
+
+    ~BlockPipeline() {
+        if (pending.valid()) pending.wait();
+    }
+
+    long long int count_of(long long int block) const {
+        long long int begin = block * blockPoints;
+        return begin + blockPoints < stream.size() ? blockPoints : stream.size() - begin;
+    }
+
+    // Starts the asynchronous read of block (global sequence number) into its buffer
+    void start(long long int sequence) {
+        const long long int block = sequence % numBlocks;
+        Dataset* buffer = &buffers[sequence & 1];
+        const long long int count = count_of(block);
+        stats.bytesRead += (long long int)sizeof(double) * count * stream.dims();
+        pending = std::async(std::launch::async, [this, block, buffer, count]() {
+            double start = omp_get_wtime();
+            if (!stream.read(block * blockPoints, count, *buffer)) return -1.0;
+            return omp_get_wtime() - start;
+        });
+    }
+
+    template <typename Process>
+    bool pass(Process process, bool prefetch) {
+        // A single block is read once and stays in the buffer
+        if (numBlocks == 1) {
+            if (!loaded) {
+                start(0);
+                loaded = true;
+                if (!wait()) return false;
+            }
+            DatasetView view = buffers[0].view();
+            view.numPoints = stream.size();
+            process(view, 0LL);
+            return true;
+        }
+
+        if (!pending.valid()) start(next);
+        for (long long int b = 0; b < numBlocks; b++) {
+            const long long int sequence = next++;
+            if (!wait()) return false;
+            if (b + 1 < numBlocks || prefetch) start(next);
+            DatasetView view = buffers[sequence & 1].view();
+            view.numPoints = count_of(b);
+            process(view, b * blockPoints);
+        }
+        return true;
+    }
+
+private:
+    bool wait() {
+        double start = omp_get_wtime();
+        double seconds = pending.get();
+        stats.waitSeconds += omp_get_wtime() - start;
+        if (seconds < 0.0) {
+            std::cerr << "Read error in streaming pass\n";
+            failed = true;
+            return false;
+        }
+        stats.readSeconds += seconds;
+        return true;
+    }
+};
+
+template <int D>
+inline bool kmeans_streaming_impl(BlockStream& stream, int k, int maxIterations, double* centroids, LabelStore& labels,
+                                  const StreamingOptions& options, StreamingStats& stats, InitMethod init) {
+    const int dims = dimensions<D>(stream.dims());
+    const long long int numPoints = stream.size();
+    const uint64_t seed = (uint64_t)rand();
+    double runStart = omp_get_wtime();
+
+    labels.reset(numPoints, k, options.compressLabels);
+    ReductionWorkspace workspace(k, dims);
+    CentroidTable table(k, dims);
+
+    // Budget: resident state and init sample first, the rest split between the two buffers
+    long long int sampleSize = options.initSize > 0 ? options.initSize : (20LL * k > 65536 ? 20LL * k : 65536);
+    if (sampleSize > numPoints) sampleSize = numPoints;
+    const size_t slotBytes = sizeof(double) * ((size_t)k * dims + k) + DATASET_ALIGNMENT;
+    stats.residentBytes = labels.bytes() + slotBytes * (workspace.numThreads() + 1) + sizeof(double) * 2 * k * dims;
+    const size_t sampleBytes = sizeof(double) * sampleSize * dims;
+    const size_t perPoint = 2 * sizeof(double) * dims + sizeof(int);
+    long long int blockPoints = 0;
+    if (options.memoryBudget > stats.residentBytes + sampleBytes) {
+        blockPoints = (long long int)((options.memoryBudget - stats.residentBytes - sampleBytes) / perPoint);
+    }
+    blockPoints = blockPoints / ASSIGN_BLOCK * ASSIGN_BLOCK;
+    const long long int wholeSet = (numPoints + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK * ASSIGN_BLOCK;
+    if (blockPoints > wholeSet) blockPoints = wholeSet;
+    if (blockPoints == 0) {
+        std::cerr << "Memory budget too small: " << stats.residentBytes + sampleBytes + perPoint * ASSIGN_BLOCK
+                  << " bytes needed at least\n";
+        return false;
+    }
+    stats.blockPoints = blockPoints;
+
+    BlockPipeline pipeline(stream, blockPoints, stats);
+    stats.numBlocks = pipeline.numBlocks;
+    stats.residentBytes += sampleBytes + (perPoint - (pipeline.numBlocks == 1 ? sizeof(double) * dims : 0)) * blockPoints;
+    std::vector<int> blockLabels(blockPoints);
+
+    // Init sample: every point with probability sampleSize / numPoints, in file order
+    Dataset sample(sampleSize, dims, LAYOUT_SOA);
+    long long int sampled = 0;
+    const double rate = (double)sampleSize / numPoints;
+    bool ok = pipeline.pass([&](const DatasetView& block, long long int first) {
+        for (long long int i = 0; i < block.numPoints && sampled < sampleSize; i++) {
+            if (rate < 1.0 && counter_uniform(seed, STREAMING_STREAM_SAMPLE, first + i) >= rate) continue;
+            for (int d = 0; d < dims; d++) sample.at(sampled, d) = block.at(i, d);
+            sampled++;
+        }
+    }, maxIterations > 0);
+    if (!ok) return false;
+    DatasetView sampleView = sample.view();
+    sampleView.numPoints = sampled;
+    if (sampled < k) {
+        std::cerr << "Initialization sample too small: " << sampled << " points for k = " << k << "\n";
+        return false;
+    }
+    init_centroids<D>(sampleView, k, centroids, init);
+
+    bool changed = true;
+    int iter = 0;
+
+    while (changed && iter < maxIterations) {
+        iter++;
+        table.load(centroids);
+        long long int reassigned = 0;
+
+        #pragma omp parallel for schedule(static, 1)
+        for (int t = 0; t < workspace.numThreads(); t++) workspace.reset(t);
+
+        ok = pipeline.pass([&](const DatasetView& block, long long int first) {
+            const long long int numChunks = (block.numPoints + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+            #pragma omp parallel for reduction(+:reassigned) schedule(static)
+            for (long long int c = 0; c < numChunks; c++) {
+                const int t = omp_get_thread_num();
+                const long long int begin = c * ASSIGN_BLOCK;
+                const long long int end = begin + ASSIGN_BLOCK < block.numPoints ? begin + ASSIGN_BLOCK : block.numPoints;
+                int* chunkLabels = blockLabels.data();
+                labels.unpack(first + begin, end - begin, chunkLabels + begin);
+                reassigned += assign_accumulate_block<D>(block, begin, end, table, chunkLabels, workspace.sums(t),
+                                                         workspace.sizes(t));
+                labels.pack(first + begin, end - begin, chunkLabels + begin);
+            }
+        }, iter < maxIterations);
+        if (!ok) return false;
+
+        #pragma omp parallel
+        workspace.reduce(workspace.numThreads());
+
+        changed = reassigned > 0;
+        if (changed) workspace.move_to_means(centroids);
+    }
+
+    stats.iterations = iter;
+    stats.totalSeconds = omp_get_wtime() - runStart;
+    return true;
+}
+
+/** STREAMING VERSION
+ *  Performs Lloyd's k-means using OMP over a binary data set file that is read block by block
+ *  on every iteration, with the reads overlapped with the computation. Memory is bounded by
+ *  options.memoryBudget. Returns false (after reporting it) if the file can't be read, k isn't
+ *  in [1, points], the budget is too small for one block or the initialization sample has
+ *  fewer than k points.
+ *  Binary data set file (kmeans/binary.h)
+ *  @param file_name
+ *  Number of desired clusters
+ *  @param k
+ *  Maximum number of iterations allowed for the algorithm
+ *  @param maxIterations
+ *  Output centroids (k * dims values, centroid by centroid)
+ *  @param centroids
+ *  Output cluster id of every point (resized to the data set)
+ *  @param labels
+ *  Memory budget, label compression and initialization sample size
+ *  @param options
+ *  Optional iterations, block size, bytes read and read / wait times
+ *  @param stats
+ *  Initial centroids, picked from the initialization sample (see init.h)
+ *  @param init
+ */
+inline bool kmeans_streaming(const std::string& file_name, int k, int maxIterations, double* centroids,
+                             LabelStore& labels, const StreamingOptions& options = StreamingOptions(),
+                             StreamingStats* stats = nullptr, InitMethod init = INIT_KMEANS_PARALLEL) {
+    BlockStream stream;
+    if (!stream.open(file_name)) return false;
+    if (k <= 0 || k > stream.size()) {
+        std::cerr << "Invalid k-means input: k = " << k << ", " << stream.size() << " points of " << stream.dims()
+                  << " dimensions\n";
+        return false;
+    }
+    StreamingStats local;
+    bool ok = false;
+    dispatch_dims(stream.dims(), [&](auto dim) {
+        ok = kmeans_streaming_impl<decltype(dim)::value>(stream, k, maxIterations, centroids, labels, options, local, init);
+    });
+    if (stats != nullptr) *stats = local;
+    return ok;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef KMEANS_SYNTHETIC_H
+#define KMEANS_SYNTHETIC_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "random.h"
+
+/*
+    Synthetic Gaussian blob mixtures
+
+    k centers are drawn uniformly in [0, box)^dims and every point either belongs to a blob
+    (coordinates center + spread * N(0, 1)) or, with probability noise, is uniform noise over
+    the box widened by 3 * spread (label -1). Blob sizes follow a geometric progression whose
+    largest / smallest ratio is imbalance (1 = equal sizes).
+
+    Every value is a pure function of (seed, point, dimension) through the counter-based
+    generator of random.h, so a mixture can be produced in parallel, in pieces or on several
+    ranks and point i is always the same. Used by tools/generate_data (files of any size) and
+    by the benchmarks, which fill their data sets with fill().
+*/
+
+// Streams of the generator
+const uint64_t SYNTHETIC_STREAM_CENTERS = 100;
+const uint64_t SYNTHETIC_STREAM_NOISE = 101;
+const uint64_t SYNTHETIC_STREAM_BLOB = 102;
+const uint64_t SYNTHETIC_STREAM_COORDS = 103;
+
+struct BlobMixture {
+    long long int numPoints = 0;
+    int dims = 0;
+    int k = 0;
+    double spread = 0.04;
+    double imbalance = 1.0;
+    double noise = 0.0;
+    double box = 1.0;
+    uint64_t seed = 1;
+    std::vector<double> centers;
+    // Cumulative blob probabilities (last one is 1)
+    std::vector<double> cumulative;
+
+    BlobMixture() {}
+
+    // Equal blobs without noise, ready to use
+    BlobMixture(long long int numPoints, int dims, int k, double spread, double box, uint64_t seed = 1)
+        : numPoints(numPoints), dims(dims), k(k), spread(spread), box(box), seed(seed) {
+        setup();
+    }
+
+    // Draws the centers and blob probabilities; call after changing the parameters
+    void setup() {
+        centers.resize((size_t)k * dims);
+        for (long long int e = 0; e < (long long int)k * dims; e++) {
+            centers[e] = box * counter_uniform(seed, SYNTHETIC_STREAM_CENTERS, e);
+        }
+        cumulative.resize(k);
+        double total = 0.0;
+        for (int j = 0; j < k; j++) {
+            total += k > 1 ? pow(imbalance, -(double)j / (k - 1)) : 1.0;
+            cumulative[j] = total;
+        }
+        for (int j = 0; j < k; j++) cumulative[j] /= total;
+    }
+
+    // Blob of point i, -1 for noise
+    int label(long long int i) const {
+        if (noise > 0.0 && counter_uniform(seed, SYNTHETIC_STREAM_NOISE, i) < noise) return -1;
+        double u = counter_uniform(seed, SYNTHETIC_STREAM_BLOB, i);
+        int j = (int)(std::upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin());
+        return j < k ? j : k - 1;
+    }
+
+    // Coordinate d of point i with label blob
+    double coordinate(long long int i, int d, int blob) const {
+        const uint64_t counter = 2 * ((uint64_t)i * dims + d);
+        double u1 = counter_uniform(seed, SYNTHETIC_STREAM_COORDS, counter);
+        if (blob < 0) return -3.0 * spread + (box + 6.0 * spread) * u1;
+        double u2 = counter_uniform(seed, SYNTHETIC_STREAM_COORDS, counter + 1);
+        double gaussian = sqrt(-2.0 * log(1.0 - u1)) * cos(2.0 * M_PI * u2);
+        return centers[(size_t)blob * dims + d] + spread * gaussian;
+    }
+
+    /*
+        Fills data (dims columns) with points first, first + 1, ... of the mixture, in parallel
+        with the static block schedule of the engines and of the first touch (see dataset.h)
+    */
+    template <typename T>
+    void fill(BasicDataset<T>& data, long long int first = 0) const {
+        const long long int size = data.size();
+        const long long int numBlocks = (size + DATASET_BLOCK - 1) / DATASET_BLOCK;
+        #pragma omp parallel for schedule(static)
+        for (long long int b = 0; b < numBlocks; b++) {
+            const long long int begin = b * DATASET_BLOCK;
+            const long long int end = begin + DATASET_BLOCK < size ? begin + DATASET_BLOCK : size;
+            for (long long int i = begin; i < end; i++) {
+                const int blob = label(first + i);
+                for (int d = 0; d < dims; d++) data.at(i, d) = (T)coordinate(first + i, d, blob);
+            }
+        }
+    }
+};
+
+#endif
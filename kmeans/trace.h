@@ -0,0 +1,329 @@
+#ifndef KMEANS_TRACE_H
+#define KMEANS_TRACE_H
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "incremental.h"
+
+/*
+    Per-iteration tracing
+
+    Opt-in instrumentation of the Lloyd engines (kmeans_serial and the parallel engine behind
+    kmeans_paralelo, KMeans and kmeans_restarts). Build with -DKMEANS_TRACE to compile the
+    hooks in; without it the KMEANS_TRACE_* macros expand to nothing and the engines are the
+    same code as before. With the hooks compiled in, a run is only traced while a TraceScope
+    is alive on the thread that calls the engine.
+
+    For every iteration the recorder keeps
+        - the assignment time (the fused assignment and accumulation sweep of the parallel
+          engine), the reduction of the per-thread sums (or of the incremental deltas) and
+          the update of the centroids,
+        - the labels that changed, the inertia after the update (from the cluster sums, see
+          inertia_from_sums) and the largest centroid shift,
+        - the load imbalance of the sweep: slowest thread over mean thread time.
+    Each thread stamps its own padded slot inside the parallel regions; the master turns the
+    stamps into per-thread spans at the end of the iteration, so the hooks never share a line
+    or take a lock.
+
+    The trace can be written as CSV (one row per iteration), as JSON (runs with their
+    iterations) and as a Chrome trace (chrome://tracing or Perfetto): one track per thread
+    with its assignment and reduction spans, the serial phases on the master's track and
+    counters for the inertia and the labels changed.
+*/
+
+#ifdef KMEANS_TRACE
+#define KMEANS_TRACE_ONLY(...) __VA_ARGS__
+#define KMEANS_TRACE_STAMP(trace, t, stamp) \
+    do { if ((trace) != nullptr) (trace)->mark((t), (stamp)); } while (0)
+#define KMEANS_TRACE_PHASE(trace, phase, begin) \
+    do { if ((trace) != nullptr) (trace)->phase_mark((phase), (begin)); } while (0)
+#else
+#define KMEANS_TRACE_ONLY(...)
+#define KMEANS_TRACE_STAMP(trace, t, stamp) do {} while (0)
+#define KMEANS_TRACE_PHASE(trace, phase, begin) do {} while (0)
+#endif
+
+// Per-thread timestamps of an iteration
+enum TraceStamp { TRACE_ASSIGN_BEGIN = 0, TRACE_ASSIGN_END, TRACE_REDUCE_BEGIN, TRACE_REDUCE_END, TRACE_STAMPS };
+
+// Phases the master times itself (outside the per-thread regions)
+enum TracePhase { TRACE_PHASE_REDUCE = 0, TRACE_PHASE_UPDATE, TRACE_PHASES };
+
+struct TraceIteration {
+    int run = 0;
+    int iteration = 0;
+    // Update from the recorded label changes instead of a full recomputation
+    bool incremental = false;
+    double start = 0.0;
+    double assignSeconds = 0.0;
+    double reductionSeconds = 0.0;
+    double updateSeconds = 0.0;
+    long long int reassigned = 0;
+    double inertia = 0.0;
+    double maxShift = 0.0;
+    // Slowest thread over the mean thread time of the assignment sweep (1 = balanced)
+    double imbalance = 1.0;
+};
+
+struct TraceSpan {
+    int run;
+    int iteration;
+    int thread;
+    const char* name;
+    double begin;
+    double end;
+};
+
+struct TraceRun {
+    std::string engine;
+    long long int numPoints;
+    int k;
+    int dims;
+    int numThreads;
+};
+
+class TraceRecorder {
+public:
+    TraceRecorder() : origin_(omp_get_wtime()) {}
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // Recorder the engines called from this thread report to (nullptr: none)
+    static TraceRecorder*& active() {
+        static thread_local TraceRecorder* current = nullptr;
+        return current;
+    }
+
+    const std::vector<TraceRun>& runs() const { return runs_; }
+    const std::vector<TraceIteration>& iterations() const { return iterations_; }
+    const std::vector<TraceSpan>& spans() const { return spans_; }
+
+    void clear() {
+        runs_.clear();
+        iterations_.clear();
+        spans_.clear();
+    }
+
+    // Starts a run: the constant term of its inertia needs one pass over the data
+    template <int D, typename T>
+    void begin_run(const char* engine, const BasicDatasetView<T>& data, int k, int numThreads) {
+        runs_.push_back({engine, data.numPoints, k, data.dims, numThreads});
+        k_ = k;
+        dims_ = data.dims;
+        scatter_ = total_scatter<D>(data, mean_);
+        stamps_.assign(numThreads, ThreadStamps());
+        previous_.assign((size_t)k * data.dims, 0.0);
+    }
+
+    void begin_iteration(int iteration, bool incremental, const double* centroids) {
+        current_ = TraceIteration();
+        current_.run = (int)runs_.size() - 1;
+        current_.iteration = iteration;
+        current_.incremental = incremental;
+        memcpy(previous_.data(), centroids, sizeof(double) * previous_.size());
+        for (ThreadStamps& slot : stamps_) memset(slot.at, 0, sizeof(slot.at));
+        memset(phases_, 0, sizeof(phases_));
+        current_.start = omp_get_wtime();
+    }
+
+    // Called by thread t of the engine's team
+    void mark(int t, TraceStamp stamp) {
+        if (t < (int)stamps_.size()) stamps_[t].at[stamp] = omp_get_wtime();
+    }
+
+    // Called by the master around a serial phase
+    void phase_mark(TracePhase phase, bool begin) { phases_[phase][begin ? 0 : 1] = omp_get_wtime(); }
+
+    void end_iteration(long long int reassigned, const IncrementalCentroids& incremental, const double* centroids) {
+        TraceIteration& it = current_;
+        it.reassigned = reassigned;
+        it.inertia = inertia_from_sums(incremental, k_, dims_, scatter_, mean_.data());
+        for (int j = 0; j < k_; j++) {
+            double dist = 0.0;
+            for (int d = 0; d < dims_; d++) {
+                double diff = centroids[(long long int)j * dims_ + d] - previous_[(long long int)j * dims_ + d];
+                dist += diff * diff;
+            }
+            it.maxShift = sqrt(dist) > it.maxShift ? sqrt(dist) : it.maxShift;
+        }
+
+        // Threads that took part in the sweep
+        double firstBegin = 0.0, lastEnd = 0.0, lastReduce = 0.0, busy = 0.0, slowest = 0.0;
+        int active = 0;
+        for (int t = 0; t < (int)stamps_.size(); t++) {
+            const double* at = stamps_[t].at;
+            if (at[TRACE_ASSIGN_BEGIN] == 0.0) continue;
+            const double seconds = at[TRACE_ASSIGN_END] - at[TRACE_ASSIGN_BEGIN];
+            firstBegin = active == 0 || at[TRACE_ASSIGN_BEGIN] < firstBegin ? at[TRACE_ASSIGN_BEGIN] : firstBegin;
+            lastEnd = at[TRACE_ASSIGN_END] > lastEnd ? at[TRACE_ASSIGN_END] : lastEnd;
+            lastReduce = at[TRACE_REDUCE_END] > lastReduce ? at[TRACE_REDUCE_END] : lastReduce;
+            busy += seconds;
+            slowest = seconds > slowest ? seconds : slowest;
+            active++;
+            spans_.push_back({it.run, it.iteration, t, "assign", at[TRACE_ASSIGN_BEGIN], at[TRACE_ASSIGN_END]});
+            if (at[TRACE_REDUCE_END] > 0.0) {
+                spans_.push_back({it.run, it.iteration, t, "reduce", at[TRACE_REDUCE_BEGIN], at[TRACE_REDUCE_END]});
+            }
+        }
+        if (active > 0) {
+            it.assignSeconds = lastEnd - firstBegin;
+            it.imbalance = busy > 0.0 ? slowest * active / busy : 1.0;
+        }
+        // The reduction starts when the last thread is done with its blocks
+        if (lastReduce > 0.0) it.reductionSeconds = lastReduce - lastEnd;
+        static const char* const phaseNames[TRACE_PHASES] = {"reduce", "update"};
+        for (int p = 0; p < TRACE_PHASES; p++) {
+            if (phases_[p][1] <= 0.0) continue;
+            (p == TRACE_PHASE_REDUCE ? it.reductionSeconds : it.updateSeconds) += phases_[p][1] - phases_[p][0];
+            spans_.push_back({it.run, it.iteration, 0, phaseNames[p], phases_[p][0], phases_[p][1]});
+        }
+        iterations_.push_back(it);
+    }
+
+    /*
+        One row per iteration. Returns false (after reporting it) if the file can't be written.
+    */
+    bool write_csv(const std::string& file_name) const {
+        std::ofstream out(file_name);
+        if (!out.is_open()) {
+            std::cerr << "Error: Could not create " << file_name << "\n";
+            return false;
+        }
+        out << "Run,Engine,Iteration,Update,AssignSeconds,ReductionSeconds,UpdateSeconds,Reassigned,Inertia,"
+               "MaxShift,Imbalance\n";
+        out.precision(10);
+        for (const TraceIteration& it : iterations_) {
+            out << it.run << "," << runs_[it.run].engine << "," << it.iteration << ","
+                << (it.incremental ? "incremental" : "full") << "," << it.assignSeconds << "," << it.reductionSeconds
+                << "," << it.updateSeconds << "," << it.reassigned << "," << it.inertia << "," << it.maxShift << ","
+                << it.imbalance << "\n";
+        }
+        return true;
+    }
+
+    /*
+        Runs with their shape and iterations. Returns false (after reporting it) if the file
+        can't be written.
+    */
+    bool write_json(const std::string& file_name) const {
+        std::ofstream out(file_name);
+        if (!out.is_open()) {
+            std::cerr << "Error: Could not create " << file_name << "\n";
+            return false;
+        }
+        out.precision(10);
+        out << "{\"runs\": [";
+        for (size_t r = 0; r < runs_.size(); r++) {
+            const TraceRun& run = runs_[r];
+            out << (r > 0 ? ",\n" : "\n") << "  {\"engine\": \"" << run.engine << "\", \"numPoints\": " << run.numPoints
+                << ", \"k\": " << run.k << ", \"dims\": " << run.dims << ", \"threads\": " << run.numThreads
+                << ", \"iterations\": [";
+            bool first = true;
+            for (const TraceIteration& it : iterations_) {
+                if (it.run != (int)r) continue;
+                out << (first ? "\n" : ",\n") << "    {\"iteration\": " << it.iteration << ", \"update\": \""
+                    << (it.incremental ? "incremental" : "full") << "\", \"assignSeconds\": " << it.assignSeconds
+                    << ", \"reductionSeconds\": " << it.reductionSeconds << ", \"updateSeconds\": "
+                    << it.updateSeconds << ", \"reassigned\": " << it.reassigned << ", \"inertia\": " << it.inertia
+                    << ", \"maxShift\": " << it.maxShift << ", \"imbalance\": " << it.imbalance << "}";
+                first = false;
+            }
+            out << "]}";
+        }
+        out << "\n]}\n";
+        return true;
+    }
+
+    /*
+        Chrome trace event format (timestamps in microseconds since the recorder was created).
+        Returns false (after reporting it) if the file can't be written.
+    */
+    bool write_chrome_trace(const std::string& file_name) const {
+        std::ofstream out(file_name);
+        if (!out.is_open()) {
+            std::cerr << "Error: Could not create " << file_name << "\n";
+            return false;
+        }
+        out.precision(15);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        auto separator = [&]() -> std::ostream& {
+            out << (first ? "  " : ",\n  ");
+            first = false;
+            return out;
+        };
+        for (size_t r = 0; r < runs_.size(); r++) {
+            separator() << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << r
+                        << ", \"args\": {\"name\": \"" << runs_[r].engine << " run " << r << "\"}}";
+            for (int t = 0; t < runs_[r].numThreads; t++) {
+                separator() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << r << ", \"tid\": " << t
+                            << ", \"args\": {\"name\": \"thread " << t << "\"}}";
+            }
+        }
+        for (const TraceSpan& span : spans_) {
+            separator() << "{\"name\": \"" << span.name << "\", \"cat\": \"kmeans\", \"ph\": \"X\", \"pid\": "
+                        << span.run << ", \"tid\": " << span.thread << ", \"ts\": " << micros(span.begin)
+                        << ", \"dur\": " << (span.end - span.begin) * 1e6 << ", \"args\": {\"iteration\": "
+                        << span.iteration << "}}";
+        }
+        for (const TraceIteration& it : iterations_) {
+            separator() << "{\"name\": \"inertia\", \"ph\": \"C\", \"pid\": " << it.run << ", \"ts\": "
+                        << micros(it.start) << ", \"args\": {\"inertia\": " << it.inertia << "}}";
+            separator() << "{\"name\": \"reassigned\", \"ph\": \"C\", \"pid\": " << it.run << ", \"ts\": "
+                        << micros(it.start) << ", \"args\": {\"reassigned\": " << it.reassigned << "}}";
+        }
+        out << "\n]}\n";
+        return true;
+    }
+
+private:
+    double micros(double seconds) const { return (seconds - origin_) * 1e6; }
+
+    // Padded so threads stamping their own slot don't share a cache line
+    struct alignas(64) ThreadStamps {
+        double at[TRACE_STAMPS] = {0.0, 0.0, 0.0, 0.0};
+    };
+
+    double origin_;
+    std::vector<TraceRun> runs_;
+    std::vector<TraceIteration> iterations_;
+    std::vector<TraceSpan> spans_;
+
+    // State of the run in progress
+    int k_ = 0;
+    int dims_ = 0;
+    double scatter_ = 0.0;
+    std::vector<double> mean_;
+    std::vector<double> previous_;
+    std::vector<ThreadStamps> stamps_;
+    double phases_[TRACE_PHASES][2] = {{0.0, 0.0}, {0.0, 0.0}};
+    TraceIteration current_;
+};
+
+/*
+    Traces the engines called from this thread into recorder while alive
+*/
+class TraceScope {
+public:
+    explicit TraceScope(TraceRecorder& recorder) : previous_(TraceRecorder::active()) {
+        TraceRecorder::active() = &recorder;
+    }
+    ~TraceScope() { TraceRecorder::active() = previous_; }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceRecorder* previous_;
+};
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef KMEANS_YINYANG_H
+#define KMEANS_YINYANG_H
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <omp.h>
+
+#include "dataset.h"
+#include "dims.h"
+#include "kmeans.h"
+#include "pruning.h"
+
+#if !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/*
+    YINYANG
+
+    Lloyd iterations with grouped centroid bounds (Ding et al., 2015). The k centroids are split
+    once into t groups, and every point keeps an upper bound on the distance to its centroid and
+    one lower bound per group (the distance to the closest centroid of the group other than its
+    own). Memory is n * t bounds instead of Elkan's n * k, so t trades memory for pruning power:
+    t = 1 behaves like Hamerly's algorithm, t = k like Elkan's.
+
+    Per point and iteration:
+        global filter   skip the point if u(x) < every group bound (one extra bound per point
+                        keeps their minimum, moved by the largest shift of all centroids)
+        group filter    skip group g if u(x) < lb(x, g)
+        local filter    inside a group, skip centroid c if u(x) < lb_prev(x, g) - shift(c)
+    Group bounds move by the largest shift of the group, stored relative to the accumulated
+    group drift (see pruning.h). Distances that are compared are exact, so the labels are the
+    Lloyd labels.
+*/
+
+/*
+    Groups the initial centroids with a few Lloyd iterations over the centroids themselves,
+    seeded with evenly spaced centroids. Fills groupOf[k], groupStart[t + 1] and groupMembers[k]
+    (members of group g are groupMembers[groupStart[g]] ... in increasing centroid id).
+*/
+inline void group_centroids(const double* centroids, int k, int dims, int t,
+                            int* groupOf, int* groupStart, int* groupMembers) {
+    double* seeds = new double[t * dims];
+    int* counts = new int[t];
+    for (int g = 0; g < t; g++) {
+        memcpy(seeds + g * dims, centroids + (long long int)g * k / t * dims, sizeof(double) * dims);
+    }
+
+    for (int iter = 0; iter < 5; iter++) {
+        for (int j = 0; j < k; j++) {
+            double bestDist = 0.0;
+            for (int g = 0; g < t; g++) {
+                double dist = 0.0;
+                for (int d = 0; d < dims; d++) {
+                    double diff = centroids[j * dims + d] - seeds[g * dims + d];
+                    dist += diff * diff;
+                }
+                if (g == 0 || dist < bestDist) {
+                    bestDist = dist;
+                    groupOf[j] = g;
+                }
+            }
+        }
+        for (int g = 0; g < t; g++) counts[g] = 0;
+        for (int i = 0; i < t * dims; i++) seeds[i] = 0.0;
+        for (int j = 0; j < k; j++) {
+            counts[groupOf[j]]++;
+            for (int d = 0; d < dims; d++) seeds[groupOf[j] * dims + d] += centroids[j * dims + d];
+        }
+        for (int g = 0; g < t; g++) {
+            for (int d = 0; d < dims; d++) {
+                if (counts[g] > 0) seeds[g * dims + d] /= counts[g];
+            }
+        }
+    }
+
+    for (int g = 0; g <= t; g++) groupStart[g] = 0;
+    for (int j = 0; j < k; j++) groupStart[groupOf[j] + 1]++;
+    for (int g = 0; g < t; g++) groupStart[g + 1] += groupStart[g];
+    for (int g = 0; g < t; g++) counts[g] = groupStart[g];
+    for (int j = 0; j < k; j++) groupMembers[counts[groupOf[j]]++] = j;
+
+    delete[] counts;
+    delete[] seeds;
+}
+
+// Group bound of a group with no centroid other than the point's own (finite, see current_lower)
+const double NO_MEMBER = std::numeric_limits<double>::max();
+
+template <int D>
+inline void kmeans_yinyang_impl(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                                int numGroups, PruningStats* stats, InitMethod init) {
+    const int dims = dimensions<D>(data.dims);
+    const long long int numPoints = data.numPoints;
+    const int t = numGroups < 1 ? 1 : (numGroups > k ? k : numGroups);
+
+    double* centroids = new double[dims * k];
+    init_centroids<D>(data, k, centroids, init);
+
+    int* groupOf = new int[k];
+    int* groupStart = new int[t + 1];
+    int* groupMembers = new int[k];
+    group_centroids(centroids, k, dims, t, groupOf, groupStart, groupMembers);
+
+    double* oldCentroids = new double[dims * k];
+    ReductionWorkspace workspace(k, dims);
+    IncrementalCentroids incremental(k, dims, workspace.numThreads());
+    double* drift = new double[k]();
+    double* shift = new double[k]();
+    double* groupDrift = new double[t]();
+    double* groupShift = new double[t]();
+    double* upper = static_cast<double*>(aligned_malloc(sizeof(double) * numPoints));
+    double* lower = static_cast<double*>(aligned_malloc(sizeof(double) * numPoints * t));
+    double* global = static_cast<double*>(aligned_malloc(sizeof(double) * numPoints));
+    double maxDrift = 0.0;
+    // Per thread: coordinates of the current point, exact distance or local lower bound of
+    // every centroid for it, and the groups examined for it
+    ThreadScratch<double> points(dims);
+    ThreadScratch<double> values(k);
+    ThreadScratch<bool> examinedGroups(t);
+
+    if (stats != nullptr) *stats = PruningStats();
+
+    bool changed = true;
+    int iter = 0;
+
+    while (changed && iter < maxIterations) {
+        changed = false;
+        iter++;
+
+        long long int reassigned = 0;
+        long long int computed = 0;
+        const bool tracking = incremental.tracking(numPoints);
+
+        #pragma omp parallel reduction(+:reassigned, computed)
+        {
+            double* x = points.get(omp_get_thread_num());
+            double* value = values.get(omp_get_thread_num());
+            bool* examined = examinedGroups.get(omp_get_thread_num());
+
+            #pragma omp for schedule(static)
+            for (long long int i = 0; i < numPoints; i++) {
+                double* l = lower + i * t;
+
+                if (iter == 1) {
+                    // First pass: every distance, which initializes all the bounds
+                    gather_point<D>(data, i, x);
+                    double bestDist = 0.0;
+                    int best = 0;
+                    for (int j = 0; j < k; j++) {
+                        value[j] = squared_distance<D>(x, centroids, j, dims);
+                        if (j == 0 || value[j] < bestDist) {
+                            bestDist = value[j];
+                            best = j;
+                        }
+                    }
+                    double globalMin = NO_MEMBER;
+                    for (int g = 0; g < t; g++) {
+                        double groupMin = NO_MEMBER;
+                        for (int m = groupStart[g]; m < groupStart[g + 1]; m++) {
+                            int j = groupMembers[m];
+                            if (j != best && value[j] < groupMin) groupMin = value[j];
+                        }
+                        l[g] = store_lower(sqrt(groupMin), 0.0);
+                        if (groupMin < globalMin) globalMin = groupMin;
+                    }
+                    global[i] = store_lower(sqrt(globalMin), 0.0);
+                    upper[i] = store_upper(sqrt(bestDist), 0.0);
+                    computed += k;
+                    if (clusterAssignment[i] != best) {
+                        if (tracking) incremental.record(omp_get_thread_num(), i, clusterAssignment[i], best);
+                        clusterAssignment[i] = best;
+                        reassigned++;
+                    }
+                    continue;
+                }
+
+                const int a0 = clusterAssignment[i];
+                double u = current_upper(upper[i], drift[a0]);
+
+                // Global filter: first the single global bound, then the smallest group bound
+                if (u < current_lower(global[i], maxDrift)) continue;
+                double globalLower = NO_MEMBER;
+                for (int g = 0; g < t; g++) {
+                    double lg = current_lower(l[g], groupDrift[g]);
+                    if (lg < globalLower) globalLower = lg;
+                }
+                global[i] = store_lower(globalLower, maxDrift);
+                if (u < globalLower) continue;
+
+                // Tighten the upper bound
+                gather_point<D>(data, i, x);
+                double bestDist = squared_distance<D>(x, centroids, a0, dims);
+                computed++;
+                value[a0] = sqrt(bestDist);
+                u = upper_bound_of(value[a0]);
+                upper[i] = store_upper(value[a0], drift[a0]);
+                if (u < globalLower) continue;
+
+                // Group and local filters
+                int a = a0;
+                for (int g = 0; g < t; g++) {
+                    examined[g] = !(u < current_lower(l[g], groupDrift[g]));
+                    if (!examined[g]) continue;
+                    const double previousDrift = groupDrift[g] - groupShift[g];
+                    for (int m = groupStart[g]; m < groupStart[g + 1]; m++) {
+                        int j = groupMembers[m];
+                        if (j == a0) continue;
+                        double lj = current_lower(l[g], previousDrift + shift[j]);
+                        if (u < lj) {
+                            value[j] = lj;
+                            continue;
+                        }
+                        double dist = squared_distance<D>(x, centroids, j, dims);
+                        computed++;
+                        value[j] = sqrt(dist);
+                        if (closer_centroid(dist, j, bestDist, a)) {
+                            a = j;
+                            bestDist = dist;
+                            u = upper_bound_of(value[j]);
+                        }
+                    }
+                }
+
+                // New bounds: examined groups from their values, the old centroid's group
+                // also has to cover the old centroid when the point moved
+                for (int g = 0; g < t; g++) {
+                    if (!examined[g]) continue;
+                    double groupMin = NO_MEMBER;
+                    for (int m = groupStart[g]; m < groupStart[g + 1]; m++) {
+                        int j = groupMembers[m];
+                        if (j != a && value[j] < groupMin) groupMin = value[j];
+                    }
+                    l[g] = store_lower(groupMin, groupDrift[g]);
+                    if (groupMin < globalLower) globalLower = groupMin;
+                }
+                if (a != a0) {
+                    int g = groupOf[a0];
+                    if (!examined[g] && value[a0] < current_lower(l[g], groupDrift[g])) {
+                        l[g] = store_lower(value[a0], groupDrift[g]);
+                    }
+                    if (value[a0] < globalLower) globalLower = value[a0];
+                    upper[i] = store_upper(value[a], drift[a]);
+                    if (tracking) incremental.record(omp_get_thread_num(), i, a0, a);
+                    clusterAssignment[i] = a;
+                    reassigned++;
+                }
+                global[i] = store_lower(globalLower, maxDrift);
+            }
+        }
+
+        if (stats != nullptr) {
+            stats->skippedFraction.push_back(1.0 - (double)computed / ((double)numPoints * k));
+        }
+        changed = reassigned > 0;
+
+        if (!changed) break;
+
+        memcpy(oldCentroids, centroids, sizeof(double) * dims * k);
+        if (tracking) {
+            incremental.apply<D>(data, &workspace);
+            incremental.move_to_means(centroids);
+        } else {
+            update_centroids_paralelo<D>(data, clusterAssignment, centroids, workspace);
+            incremental.set(workspace.totalSums(), workspace.totalSizes());
+        }
+        incremental.end_iteration(reassigned);
+
+        // Shift of every centroid and largest shift of every group
+        for (int j = 0; j < k; j++) shift[j] = 0.0;
+        add_centroid_drift(oldCentroids, centroids, k, dims, shift);
+        for (int g = 0; g < t; g++) groupShift[g] = 0.0;
+        double maxShift = 0.0;
+        for (int j = 0; j < k; j++) {
+            drift[j] += shift[j];
+            if (shift[j] > groupShift[groupOf[j]]) groupShift[groupOf[j]] = shift[j];
+        }
+        for (int g = 0; g < t; g++) {
+            groupDrift[g] += groupShift[g];
+            if (groupShift[g] > maxShift) maxShift = groupShift[g];
+        }
+        maxDrift += maxShift;
+    }
+
+    if (stats != nullptr) stats->iterations = iter;
+
+    aligned_free(global);
+    aligned_free(lower);
+    aligned_free(upper);
+    delete[] groupShift;
+    delete[] groupDrift;
+    delete[] shift;
+    delete[] drift;
+    delete[] oldCentroids;
+    delete[] groupMembers;
+    delete[] groupStart;
+    delete[] groupOf;
+    delete[] centroids;
+}
+
+// Default number of groups: k / 10, as suggested by the Yinyang paper
+inline int yinyang_default_groups(int k) {
+    return k / 10 > 1 ? k / 10 : 1;
+}
+
+/** YINYANG VERSION
+ *  Performs the k-means algorithm using OMP, skipping distance computations with Yinyang's
+ *  grouped bounds. Same centroids, updates and labels as kmeans_paralelo.
+ *  Contiguous data set (any layout, any number of dimensions)
+ *  @param data
+ *  Number of desired clusters
+ *  @param k
+ *  Maximum number of iterations allowed for the algorithm
+ *  @param maxIterations
+ *  Output array with the cluster id of every point (size data.numPoints)
+ *  @param clusterAssignment
+ *  Number of centroid groups, i.e. lower bounds per point (0 = k / 10)
+ *  @param numGroups
+ *  Optional fraction of distance computations skipped per iteration
+ *  @param stats
+ *  Initial centroids (see init.h)
+ *  @param init
+ */
+inline void kmeans_yinyang(const DatasetView& data, int k, int maxIterations, int* clusterAssignment,
+                           int numGroups = 0, PruningStats* stats = nullptr,
+                           InitMethod init = INIT_KMEANS_PARALLEL) {
+    if (numGroups <= 0) numGroups = yinyang_default_groups(k);
+    dispatch_dims(data.dims, [&](auto dim) {
+        kmeans_yinyang_impl<decltype(dim)::value>(data, k, maxIterations, clusterAssignment, numGroups, stats, init);
+    });
+}
+
+#if !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -9,54 +9,24 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <memory>
 #include <random>
 #include <omp.h>
 
+#include "kmeans/dataset.h"
+#include "kmeans/csv.h"
+#include "kmeans/input.h"
+#include "kmeans/kmeans.h"
+#include "kmeans/elkan.h"
+#include "kmeans/yinyang.h"
+#include "kmeans/kdtree.h"
+#include "kmeans/minibatch.h"
+#include "kmeans/reorder.h"
+#include "kmeans/restarts.h"
+
 using namespace std;
 using namespace std::chrono;
 
-/*
-    CSV management functions
-
-    Reading data from a CSV file
-*/
-
-void load_CSV(string file_name, double** points, long long int size) {
-    ifstream in(file_name);
-    if (!in) {
-        cerr << "Couldn't read file: " << file_name << "\n";
-        return;
-    }
-
-    long long int point_number = 0;
-    string line;
-    while (getline(in, line) && point_number < size) {
-        istringstream iss(line);
-        char delimiter;
-        iss >> points[point_number][0] >> delimiter >> points[point_number][1];
-        point_number++;
-    }
-    in.close();
-}
-/*
-    Writing data to a CSV file
-*/
-void save_to_CSV(string file_name, double** data, long long int numPoints, int* clusterAssignment) {
-    ofstream out(file_name);
-
-    if (!out.is_open()){
-        // Priting message of unsucessful open file
-        cerr << "Couldn't write to file: " << file_name << "\n";
-        return;
-    } 
-
-    for (int i = 0; i < numPoints; i++) {
-        out << data[i][0] << "," << data[i][1] << "," << clusterAssignment[i] << "\n";
-    }
-    out.close();
-    
-}
-
 // Function to append speedup results to a CSV file
 void save_speedup_results(int data_size, int num_threads, double serial_time, double parallel_time) {
     ofstream out("output/speedups2.csv", ios::app); // Open file in append mode
@@ -70,232 +40,9 @@ void save_speedup_results(int data_size, int num_threads, double serial_time, do
     out.close();
 }
 
-/*
-    Euclidean distance
-*/
-double euclideanDistance(double* a, double* b) {
-    return sqrt(pow(a[0] - b[0], 2) + pow(a[1] - b[1], 2));
-}
-/* 
-    K_MEANS 
-*/
-
-/** SERIAL VERSION
- *  Performs the k-means algorithm for the given data points and returns the assigned cluster id.
- *  Array of data where each row represents a point with "x", "y" coordinates and its cluster assignment
- *  @param data  
- *  Number of desired clusters
- *  @param k 
- *  Data set size (number of points).    
- *  @param numPoints
- *  Maximum number of iterations allowed for the algorithm           
- *  @param maxIterations
- *  String file name for output result
- *  @param output_file
- */
-
- void kmeans_serial(double** data, int numPoints, int k, int maxIterations, int* clusterAssignment) {
-    double** centroids = new double*[k];
-    for (int i = 0; i < k; i++) {
-        centroids[i] = new double[2];
-    }
-
-    for (int i = 0; i < k; i++) {
-        int randIndex = rand() % numPoints;
-        centroids[i][0] = data[randIndex][0];
-        centroids[i][1] = data[randIndex][1];
-    }
-
-    bool changed = true;
-    int iter = 0;
-
-    int* clusterSizes = new int[k];
-    double** newCentroids = new double*[k];
-    for (int i = 0; i < k; i++) {
-        newCentroids[i] = new double[2];
-    }
-
-    while (changed && iter < maxIterations) {
-        changed = false;
-        iter++;
-
-        for (int i = 0; i < numPoints; i++) {
-            double minDist = euclideanDistance(data[i], centroids[0]);
-            int bestCluster = 0;
-            for (int j = 1; j < k; j++) {
-                double dist = euclideanDistance(data[i], centroids[j]);
-                if (dist < minDist) {
-                    minDist = dist;
-                    bestCluster = j;
-                }
-            }
-            if (clusterAssignment[i] != bestCluster) {
-                clusterAssignment[i] = bestCluster;
-                changed = true;
-            }
-        }
-
-        if (!changed) break;
-
-        for (int i = 0; i < k; i++) {
-            clusterSizes[i] = 0;
-            newCentroids[i][0] = 0.0;
-            newCentroids[i][1] = 0.0;
-        }
-
-        for (int i = 0; i < numPoints; i++) {
-            int cluster = clusterAssignment[i];
-            clusterSizes[cluster]++;
-            newCentroids[cluster][0] += data[i][0];
-            newCentroids[cluster][1] += data[i][1];
-        }
-
-        for (int i = 0; i < k; i++) {
-            if (clusterSizes[i] > 0) {
-                centroids[i][0] = newCentroids[i][0] / clusterSizes[i];
-                centroids[i][1] = newCentroids[i][1] / clusterSizes[i];
-            }
-        }
-    }
-    
-    for (int i = 0; i < k; i++) {
-        delete[] centroids[i];
-        delete[] newCentroids[i];
-    }
-    delete[] newCentroids;
-    delete[] clusterSizes;
-    delete[] centroids;
-}
-
-
- /** PARALLEL VERSION
- *  Performs the k-means algorithm using OMP.
- *  Array of data points where each row represents a point with "x", "y" coordinates and its assigned cluster
- *  @param data  
- *  Number of desired clusters
- *  @param k 
- *  Data set size (number of rows/points).    
- *  @param numPoints
- *  Maximum number of iterations allowed for the algorithm           
- *  @param maxIterations
- *  String file name for output result
- *  @param output_file
- */
-
- void kmeans_paralelo(double** data, int numPoints, int k, int maxIterations, int* clusterAssignment) {
-    // Initialize centroids (random)
-    double** centroids = new double*[k];
-    // #pragma omp parallel for
-    for (int i = 0; i < k; i++) {
-        centroids[i] = new double[2];
-    }
-    
-    for (int i = 0; i < k; i++) {
-        int randIndex = rand() % numPoints;
-        centroids[i][0] = data[randIndex][0];
-        centroids[i][1] = data[randIndex][1];
-    }
-    
-    // Pre-allocate memory for cluster updates
-    int* clusterSizes = new int[k];
-    double** newCentroids = new double*[k];
-    for (int i = 0; i < k; i++) {
-        newCentroids[i] = new double[2];
-    }
-
-    bool changed = true;
-    int iter = 0;
-
-    // Main loop - until convergance or max iterations are reached
-    while (changed && iter < maxIterations) {
-        changed = false;
-        iter++;
-
-        #pragma omp parallel for reduction(||:changed) schedule(static) //dynamic, 1000
-        for (int i = 0; i < numPoints; i++) {
-            double minDist = euclideanDistance(data[i], centroids[0]);
-            int bestCluster = 0;
-            for (int j = 1; j < k; j++) {
-                double dist = euclideanDistance(data[i], centroids[j]);
-                if (dist < minDist) {
-                    minDist = dist;
-                    bestCluster = j;
-                }
-            }
-            if (clusterAssignment[i] != bestCluster) {
-                clusterAssignment[i] = bestCluster;
-                changed = true;
-            }
-        }
-
-        if (!changed) break;
-
-        // (Re)set accumulators
-        for (int i = 0; i < k; i++) {
-            clusterSizes[i] = 0;
-            newCentroids[i][0] = 0.0;
-            newCentroids[i][1] = 0.0;
-        }
-
-        #pragma omp parallel
-        {
-            // Thread-local accumulators
-            int* localSizes = new int[k]();
-            double** localSums = new double*[k];
-            for (int i = 0; i < k; i++) {
-                localSums[i] = new double[2]{0.0, 0.0};
-            }
-
-            // Accumulate local sums
-            #pragma omp for schedule(dynamic, 1000)
-            for (int i = 0; i < numPoints; i++) {
-                int cluster = clusterAssignment[i];
-                localSizes[cluster]++;
-                localSums[cluster][0] += data[i][0];
-                localSums[cluster][1] += data[i][1];
-            }
-
-            // Combine results
-            #pragma omp critical
-            {
-                for (int i = 0; i < k; i++) {
-                    clusterSizes[i] += localSizes[i];
-                    newCentroids[i][0] += localSums[i][0];
-                    newCentroids[i][1] += localSums[i][1];
-                }
-            }
-
-            // Clean up thread-local memory
-            for (int i = 0; i < k; i++) {
-                delete[] localSums[i];
-            }
-            delete[] localSums;
-            delete[] localSizes;
-        }
-        
-        // update centroids
-        //#pragma omp parallel for
-        for (int i = 0; i < k; i++) {
-            if (clusterSizes[i] > 0) {
-                centroids[i][0] = newCentroids[i][0] / clusterSizes[i];
-                centroids[i][1] = newCentroids[i][1] / clusterSizes[i];
-            }
-        }
-
-    }
-
-    for (int i = 0; i < k; i++) {
-        delete[] centroids[i];
-        delete[] newCentroids[i];
-    }
-    delete[] newCentroids;
-    delete[] clusterSizes;
-    delete[] centroids;
-}
-
  int main(int argc, char** argv) {
     if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <max_iterations> <num_clusters> <seed>\n";
+        std::cerr << "Usage: " << argv[0] << " <max_iterations> <num_clusters> <seed> [lloyd|elkan|yinyang|kdtree|minibatch] [kmeans|| | kmeans++ | random] [none|morton|hilbert] [n_init]\n";
         return 1;
     }
     // // Create/Overwrite the CSV file and write headers
@@ -311,6 +58,8 @@ double euclideanDistance(double* a, double* b) {
     int max_threads = omp_get_max_threads();
     int num_threads[1] = {max_threads/2};
     int num_points[1] = {980000};
+    // Runs averaged per configuration (benchmarks/bench_harness.cpp does full statistics)
+    const int repetitions = 1;
     double start, serial_time, parallel_time;
 
     // Converting the first command-line argument (argv[1]) into an integer for maximum number of iterations
@@ -322,43 +71,89 @@ double euclideanDistance(double* a, double* b) {
     // User provided seed 
     const int seed = atoi(argv[3]);  
 
+    // Optional engine for the parallel runs (Lloyd by default)
+    const string algorithm = argc > 4 ? argv[4] : "lloyd";
+    if (algorithm != "lloyd" && algorithm != "elkan" && algorithm != "yinyang" && algorithm != "kdtree" &&
+        algorithm != "minibatch") {
+        std::cerr << "Unknown algorithm: " << algorithm << "\n";
+        return 1;
+    }
+
+    // Optional initialization of the centroids (k-means|| by default, see kmeans/init.h)
+    InitMethod init = INIT_KMEANS_PARALLEL;
+    if (argc > 5 && !parse_init_method(argv[5], init)) {
+        std::cerr << "Unknown initialization: " << argv[5] << "\n";
+        return 1;
+    }
+
+    // Optional reordering of the points along a space-filling curve (see kmeans/reorder.h)
+    SpatialCurve curve = CURVE_NONE;
+    if (argc > 6 && !parse_spatial_curve(argv[6], curve)) {
+        std::cerr << "Unknown curve: " << argv[6] << "\n";
+        return 1;
+    }
+
+    // Optional number of restarts of the Lloyd engine, run concurrently on the loaded points
+    // (see kmeans/restarts.h); only the labels of the lowest inertia are kept
+    const int n_init = argc > 7 ? atoi(argv[7]) : 1;
+    if (n_init < 1 || (n_init > 1 && algorithm != "lloyd")) {
+        std::cerr << "n_init must be at least 1 and needs the lloyd engine\n";
+        return 1;
+    }
+
     // Set the seed for reproducibility
     srand(seed);
     
     for (int data_size : num_points){
-        string input = "data/" + to_string(data_size) + "_data.csv";
-        char const *input_file_name = input.c_str();
-
-        // Parameters for each k means function
-        double** data = new double*[data_size];
-        int* clusterAssignment = new int[data_size];
+        string input = "data/" + to_string(data_size) + "_data";
+
+        // data/N_data.bin is mapped with no copy when it exists, otherwise the CSV is parsed
+        InputDataset input_data;
+        if (!input_data.open(input, data_size)) continue;
+        DatasetView data = input_data.view();
+        if (input_data.mapped()) {
+            cout << "Mapeo de " << input << ".bin: " << data.numPoints << " puntos, " << input_data.seconds() << " s\n";
+        } else {
+            cout << "Lectura de " << input << ".csv: " << data.numPoints << " puntos, "
+                 << input_data.megabytesPerSecond() << " MB/s\n";
+        }
 
-        for (long long int i = 0; i < data_size; i++) {
-            data[i] = new double[3]{0.0, 0.0, -1};  // Memory allocation for 2D points and cluster assignments
+        // The engines see the reordered copy; position keeps the results in file order
+        SpatialOrder reordered;
+        const long long int* position = nullptr;
+        if (curve != CURVE_NONE) {
+            start = omp_get_wtime();
+            reordered.build(data, curve);
+            data = reordered.view();
+            position = reordered.position();
+            cout << "Reordenamiento " << argv[6] << ": " << omp_get_wtime() - start << " s\n";
         }
+        char const *input_file_name = input.c_str();
 
-        load_CSV(input_file_name, data, data_size);
+        int* clusterAssignment = new int[data_size];
 
         // SERIAL execution
         cout << "Ejecutando kmeans serial para " << input_file_name << " de tamanio " << data_size << " buscando " << num_clusters << " clusters\n";
         string output_serial = "output/" + to_string(data_size) + "_results_serial_";
 
-        // Run the serial experiment 10 times and calculate the average time
+        // Run the serial experiment and calculate the average time
         double total_serial_time = 0.0;
-        for (int i = 0; i < 1; i++) {
+        for (int i = 0; i < repetitions; i++) {
+            // Fresh labels: leftovers from a previous run could make the first iteration look converged
+            fill(clusterAssignment, clusterAssignment + data.numPoints, -1);
             start = omp_get_wtime();
             
             // Execute the K-means Serial Algorithm
-            kmeans_serial(data, data_size, num_clusters, max_iterations, clusterAssignment);
+            kmeans_serial(data, num_clusters, max_iterations, clusterAssignment, init);
             
             // Measure Execution Time for Serial
             total_serial_time += omp_get_wtime() - start;
             
             // Write results to csv
-            save_to_CSV(output_serial + to_string(i) + ".csv", data, data_size, clusterAssignment);
+            save_to_CSV(output_serial + to_string(i) + ".csv", data, clusterAssignment, position);
             
         }
-        serial_time = total_serial_time / 10.0;
+        serial_time = total_serial_time / repetitions;
 
         // Report Execution Time for Serial
         cout << "Tiempo de ejecucion promedio en serial: " << serial_time << " segundos.\n";
@@ -366,38 +161,86 @@ double euclideanDistance(double* a, double* b) {
 
         string output_parallel = "output/" + to_string(data_size) + "_results_parallel_";
 
+        // The kd-tree doesn't depend on the centroids: built once, reused for every thread count
+        std::unique_ptr<KdTree> tree;
+        if (algorithm == "kdtree") {
+            start = omp_get_wtime();
+            tree.reset(new KdTree(data));
+            cout << "Arbol kd: " << tree->numNodes() << " nodos, " << omp_get_wtime() - start << " s\n";
+        }
+
         for (int threads : num_threads) {
             omp_set_num_threads(threads);
             cout << "\nRunning with " << threads << " threads:" << endl;
 
+            // Built with -DKMEANS_TRACE: per-iteration trace of the parallel runs (see kmeans/trace.h)
+            KMEANS_TRACE_ONLY(TraceRecorder trace; TraceScope trace_scope(trace);)
+
             // Parallel execution with the same data
             double total_parallel_time = 0.0;
-            for (int i = 0; i < 1; i++) {
+            for (int i = 0; i < repetitions; i++) {
+                fill(clusterAssignment, clusterAssignment + data.numPoints, -1);
                 start = omp_get_wtime();
 
                 // Execute the K-means Parallel Algorithm
-                kmeans_paralelo(data, data_size, num_clusters, max_iterations, clusterAssignment);
+                if (algorithm == "elkan") {
+                    PruningStats stats;
+                    kmeans_elkan(data, num_clusters, max_iterations, clusterAssignment, &stats, init);
+                    cout << "Elkan: " << stats.iterations << " iteraciones, " << 100.0 * stats.meanSkipped()
+                         << " % de distancias omitidas\n";
+                } else if (algorithm == "yinyang") {
+                    PruningStats stats;
+                    kmeans_yinyang(data, num_clusters, max_iterations, clusterAssignment, 0, &stats, init);
+                    cout << "Yinyang: " << stats.iterations << " iteraciones, " << 100.0 * stats.meanSkipped()
+                         << " % de distancias omitidas\n";
+                } else if (algorithm == "kdtree") {
+                    kmeans_kdtree(*tree, num_clusters, max_iterations, clusterAssignment, init);
+                } else if (algorithm == "minibatch") {
+                    MiniBatchStats stats;
+                    kmeans_minibatch(data, num_clusters, max_iterations, clusterAssignment, MiniBatchOptions(), &stats, init);
+                    cout << "Mini-batch: " << stats.iterations << " iteraciones, " << stats.sampledPoints
+                         << " puntos muestreados" << (stats.converged ? ", convergio" : "") << "\n";
+                } else if (n_init > 1) {
+                    KMeansOptions options;
+                    options.k = num_clusters;
+                    options.maxIterations = max_iterations;
+                    options.init = init;
+                    options.seed = (uint64_t)rand();
+                    RestartOptions restartOptions;
+                    restartOptions.nInit = n_init;
+                    RestartStats stats;
+                    vector<double> centroids((size_t)num_clusters * data.dims);
+                    if (!kmeans_restarts(data, options, restartOptions, clusterAssignment, centroids.data(), &stats)) {
+                        return 1;
+                    }
+                    cout << "Reinicios: " << n_init << " (" << stats.concurrent << " a la vez con "
+                         << stats.threadsPerRestart << " hilos), " << stats.abandoned << " abandonados, mejor "
+                         << stats.best << " con inercia " << stats.inertia[stats.best] << "\n";
+                } else {
+                    kmeans_paralelo(data, num_clusters, max_iterations, clusterAssignment, init);
+                }
 
                 total_parallel_time += (omp_get_wtime() - start);
 
                 // Write results to csv
-                save_to_CSV(output_parallel + to_string(i) + ".csv", data, data_size, clusterAssignment);
+                save_to_CSV(output_parallel + to_string(i) + ".csv", data, clusterAssignment, position);
             }
 
-            parallel_time = total_parallel_time / 10.0;
+            parallel_time = total_parallel_time / repetitions;
             
             cout << "Tiempo de ejecucion promedio paralelo con " << threads << " threads: " << parallel_time << " segundos" << endl;
             cout << "Speedup: " << serial_time / parallel_time << "x\n";
 
+            KMEANS_TRACE_ONLY(string trace_prefix = "output/" + to_string(data_size) + "_trace_" + to_string(threads);
+                              trace.write_csv(trace_prefix + ".csv");
+                              trace.write_json(trace_prefix + ".json");
+                              trace.write_chrome_trace(trace_prefix + ".trace.json");)
+
             // Save speedup results to CSV
             //save_speedup_results(data_size, threads, serial_time, parallel_time);
         }
 
-        // Clean up dynamically allocated memory
-        for (long long int i = 0; i < data_size; i++) {
-            delete[] data[i];
-        }
-        delete[] data;
+        // Clean up dynamically allocated memory (data is released by input_data)
         delete[] clusterAssignment;
     }
 
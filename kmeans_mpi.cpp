@@ -0,0 +1,83 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <mpi.h>
+#include <omp.h>
+
+#include "kmeans/distributed.h"
+
+using namespace std;
+
+/*
+    Distributed k-means: every MPI rank loads its shard of the data set (a block of rows of a
+    .bin file or a byte range of a .csv file) and clusters it with OMP threads; the centroid
+    sums and sizes are combined with MPI_Allreduce on every iteration. Optionally writes the
+    labels of all the points in file order as raw 32-bit integers.
+
+    Usage: mpirun -np <ranks> ./kmeans_mpi <data.bin|data.csv> <num_clusters> <max_iterations> <seed>
+                                           [output_labels.bin]
+*/
+
+int main(int argc, char** argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, numRanks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    if (argc < 5) {
+        if (rank == 0) {
+            cerr << "Usage: " << argv[0] << " <data.bin|data.csv> <num_clusters> <max_iterations> <seed>"
+                 << " [output_labels.bin]\n";
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    const string input_file = argv[1];
+    const int k = atoi(argv[2]);
+    const int max_iterations = atoi(argv[3]);
+    const int seed = atoi(argv[4]);
+
+    double start = omp_get_wtime();
+    Dataset points;
+    long long int globalOffset = 0, globalPoints = 0;
+    const bool binary = input_file.size() > 4 && input_file.compare(input_file.size() - 4, 4, ".bin") == 0;
+    bool ok = binary ? load_shard_binary(input_file, MPI_COMM_WORLD, points, globalOffset, globalPoints)
+                     : load_shard_CSV(input_file, MPI_COMM_WORLD, points, globalOffset, globalPoints);
+    if (!ok) {
+        MPI_Finalize();
+        return 1;
+    }
+    double loadTime = omp_get_wtime() - start;
+
+    vector<int> labels(points.size(), -1);
+    vector<double> centroids((size_t)k * points.dims());
+    DistributedStats stats;
+    srand(seed);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (!kmeans_distributed(points.view(), k, max_iterations, labels.data(), centroids.data(), MPI_COMM_WORLD, &stats)) {
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Slowest rank for the times, every rank for the load balance
+    double times[3] = {loadTime, stats.totalSeconds, stats.communicationSeconds};
+    MPI_Allreduce(MPI_IN_PLACE, times, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    long long int smallest = points.size(), largest = points.size();
+    MPI_Allreduce(MPI_IN_PLACE, &smallest, 1, MPI_LONG_LONG, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &largest, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+    if (rank == 0) {
+        cout << globalPoints << " puntos de " << points.dims() << " dimensiones en " << numRanks << " procesos ("
+             << smallest << " a " << largest << " puntos por proceso) x " << omp_get_max_threads() << " threads\n";
+        cout << "Lectura " << times[0] << " s; " << stats.iterations << " iteraciones en " << times[1]
+             << " s (comunicación " << times[2] << " s)\n";
+    }
+
+    if (argc > 5 && !save_distributed_labels(argv[5], MPI_COMM_WORLD, labels.data(), points.size(), globalOffset)) {
+        MPI_Finalize();
+        return 1;
+    }
+    MPI_Finalize();
+    return 0;
+}
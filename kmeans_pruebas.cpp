@@ -12,51 +12,13 @@
 #include <random>
 #include <omp.h>
 
+#include "kmeans/dataset.h"
+#include "kmeans/csv.h"
+#include "kmeans/input.h"
+
 using namespace std;
 using namespace std::chrono;
 
-/*
-    CSV management functions
-
-    Reading data from a CSV file
-*/
-
-void load_CSV(string file_name, double** points, long long int size) {
-    ifstream in(file_name);
-    if (!in) {
-        cerr << "Couldn't read file: " << file_name << "\n";
-        return;
-    }
-
-    long long int point_number = 0;
-    string line;
-    while (getline(in, line) && point_number < size) {
-        istringstream iss(line);
-        char delimiter;
-        iss >> points[point_number][0] >> delimiter >> points[point_number][1];
-        point_number++;
-    }
-    in.close();
-}
-/*
-    Writing data to a CSV file
-*/
-void save_to_CSV(string file_name, double** data, long long int numPoints, int* clusterAssignment) {
-    ofstream out(file_name);
-
-    if (!out.is_open()){
-        // Priting message of unsucessful open file
-        cerr << "Couldn't write to file: " << file_name << "\n";
-        return;
-    } 
-
-    for (int i = 0; i < numPoints; i++) {
-        out << data[i][0] << "," << data[i][1] << "," << clusterAssignment[i] << "\n";
-    }
-    out.close();
-    
-}
-
 // Function to append speedup results to a CSV file
 void save_speedup_results(int data_size, int num_threads, double serial_time, double parallel_time) {
     ofstream out("output/speedups.csv", ios::app); // Open file in append mode
@@ -73,8 +35,8 @@ void save_speedup_results(int data_size, int num_threads, double serial_time, do
 /*
     Euclidean distance
 */
-double euclideanDistance(double* a, double* b) {
-    return sqrt(pow(a[0] - b[0], 2) + pow(a[1] - b[1], 2));
+double euclideanDistance(const DatasetView& data, long long int i, double* b) {
+    return sqrt(pow(data.at(i, 0) - b[0], 2) + pow(data.at(i, 1) - b[1], 2));
 }
 /* 
     K_MEANS 
@@ -82,28 +44,27 @@ double euclideanDistance(double* a, double* b) {
 
 /** SERIAL VERSION
  *  Performs the k-means algorithm for the given data points and returns the assigned cluster id.
- *  Array of data where each row represents a point with "x", "y" coordinates and its cluster assignment
+ *  Contiguous data set (any layout) with the "x", "y" coordinates of each point
  *  @param data  
  *  Number of desired clusters
  *  @param k 
- *  Data set size (number of points).    
- *  @param numPoints
  *  Maximum number of iterations allowed for the algorithm           
  *  @param maxIterations
  *  String file name for output result
  *  @param output_file
  */
 
- void kmeans_serial(double** data, int numPoints, int k, int maxIterations, int* clusterAssignment) {
+ void kmeans_serial(const DatasetView& data, int k, int maxIterations, int* clusterAssignment) {
+    const long long int numPoints = data.numPoints;
     double** centroids = new double*[k];
     for (int i = 0; i < k; i++) {
         centroids[i] = new double[2];
     }
 
     for (int i = 0; i < k; i++) {
-        int randIndex = rand() % numPoints;
-        centroids[i][0] = data[randIndex][0];
-        centroids[i][1] = data[randIndex][1];
+        long long int randIndex = rand() % numPoints;
+        centroids[i][0] = data.at(randIndex, 0);
+        centroids[i][1] = data.at(randIndex, 1);
     }
 
     bool changed = true;
@@ -119,11 +80,11 @@ double euclideanDistance(double* a, double* b) {
         changed = false;
         iter++;
 
-        for (int i = 0; i < numPoints; i++) {
-            double minDist = euclideanDistance(data[i], centroids[0]);
+        for (long long int i = 0; i < numPoints; i++) {
+            double minDist = euclideanDistance(data, i, centroids[0]);
             int bestCluster = 0;
             for (int j = 1; j < k; j++) {
-                double dist = euclideanDistance(data[i], centroids[j]);
+                double dist = euclideanDistance(data, i, centroids[j]);
                 if (dist < minDist) {
                     minDist = dist;
                     bestCluster = j;
@@ -143,11 +104,11 @@ double euclideanDistance(double* a, double* b) {
             newCentroids[i][1] = 0.0;
         }
 
-        for (int i = 0; i < numPoints; i++) {
+        for (long long int i = 0; i < numPoints; i++) {
             int cluster = clusterAssignment[i];
             clusterSizes[cluster]++;
-            newCentroids[cluster][0] += data[i][0];
-            newCentroids[cluster][1] += data[i][1];
+            newCentroids[cluster][0] += data.at(i, 0);
+            newCentroids[cluster][1] += data.at(i, 1);
         }
 
         for (int i = 0; i < k; i++) {
@@ -170,19 +131,18 @@ double euclideanDistance(double* a, double* b) {
 
  /** PARALLEL VERSION
  *  Performs the k-means algorithm using OMP.
- *  Array of data points where each row represents a point with "x", "y" coordinates and its assigned cluster
+ *  Contiguous data set (any layout) with the "x", "y" coordinates of each point
  *  @param data  
  *  Number of desired clusters
  *  @param k 
- *  Data set size (number of rows/points).    
- *  @param numPoints
  *  Maximum number of iterations allowed for the algorithm           
  *  @param maxIterations
  *  String file name for output result
  *  @param output_file
  */
 
- void kmeans_paralelo(double** data, int numPoints, int k, int maxIterations, int* clusterAssignment) {
+ void kmeans_paralelo(const DatasetView& data, int k, int maxIterations, int* clusterAssignment) {
+    const long long int numPoints = data.numPoints;
     // Initialize centroids (random)
     double** centroids = new double*[k];
     // #pragma omp parallel for
@@ -191,9 +151,9 @@ double euclideanDistance(double* a, double* b) {
     }
     
     for (int i = 0; i < k; i++) {
-        int randIndex = rand() % numPoints;
-        centroids[i][0] = data[randIndex][0];
-        centroids[i][1] = data[randIndex][1];
+        long long int randIndex = rand() % numPoints;
+        centroids[i][0] = data.at(randIndex, 0);
+        centroids[i][1] = data.at(randIndex, 1);
     }
     
     // Pre-allocate memory for cluster updates
@@ -212,11 +172,11 @@ double euclideanDistance(double* a, double* b) {
         iter++;
 
         #pragma omp parallel for reduction(||:changed) schedule(static) //dynamic, 1000
-        for (int i = 0; i < numPoints; i++) {
-            double minDist = euclideanDistance(data[i], centroids[0]);
+        for (long long int i = 0; i < numPoints; i++) {
+            double minDist = euclideanDistance(data, i, centroids[0]);
             int bestCluster = 0;
             for (int j = 1; j < k; j++) {
-                double dist = euclideanDistance(data[i], centroids[j]);
+                double dist = euclideanDistance(data, i, centroids[j]);
                 if (dist < minDist) {
                     minDist = dist;
                     bestCluster = j;
@@ -238,15 +198,15 @@ double euclideanDistance(double* a, double* b) {
         }
 
         #pragma omp parallel for schedule(static)
-        for (int i = 0; i < numPoints; i++) {
+        for (long long int i = 0; i < numPoints; i++) {
             int cluster = clusterAssignment[i];
             #pragma omp atomic
             clusterSizes[cluster]++;
             
             #pragma omp critical
             {
-                newCentroids[cluster][0] += data[i][0];
-                newCentroids[cluster][1] += data[i][1];
+                newCentroids[cluster][0] += data.at(i, 0);
+                newCentroids[cluster][1] += data.at(i, 1);
             }
         }
         
@@ -303,19 +263,16 @@ double euclideanDistance(double* a, double* b) {
     srand(seed);
     
     for (int data_size : num_points){
-        string input = "data/" + to_string(data_size) + "_data.csv";
+        string input = "data/" + to_string(data_size) + "_data";
         char const *input_file_name = input.c_str();
 
         // Parameters for each k means function
-        double** data = new double*[data_size];
+        // data/N_data.bin is mapped with no copy when it exists, otherwise the CSV is parsed
+        InputDataset input_data;
+        if (!input_data.open(input, data_size)) continue;
+        DatasetView data = input_data.view();
         int* clusterAssignment = new int[data_size];
 
-        for (long long int i = 0; i < data_size; i++) {
-            data[i] = new double[3]{0.0, 0.0, -1};  // Memory allocation for 2D points and cluster assignments
-        }
-
-        load_CSV(input_file_name, data, data_size);
-
         // SERIAL execution
         cout << "Ejecutando kmeans serial para " << input_file_name << " de tamanio " << data_size << " buscando " << num_clusters << " clusters\n";
         string output_serial = "output/" + to_string(data_size) + "_results_serial_";
@@ -326,13 +283,13 @@ double euclideanDistance(double* a, double* b) {
             start = omp_get_wtime();
             
             // Execute the K-means Serial Algorithm
-            kmeans_serial(data, data_size, num_clusters, max_iterations, clusterAssignment);
+            kmeans_serial(data, num_clusters, max_iterations, clusterAssignment);
             
             // Measure Execution Time for Serial
             total_serial_time += omp_get_wtime() - start;
             
             // Write results to csv
-            save_to_CSV(output_serial + to_string(i) + ".csv", data, data_size, clusterAssignment);
+            save_to_CSV(output_serial + to_string(i) + ".csv", data, clusterAssignment);
             
         }
         serial_time = total_serial_time / 10.0;
@@ -353,12 +310,12 @@ double euclideanDistance(double* a, double* b) {
                 start = omp_get_wtime();
 
                 // Execute the K-means Parallel Algorithm
-                kmeans_paralelo(data, data_size, num_clusters, max_iterations, clusterAssignment);
+                kmeans_paralelo(data, num_clusters, max_iterations, clusterAssignment);
 
                 total_parallel_time += (omp_get_wtime() - start);
 
                 // Write results to csv
-                save_to_CSV(output_parallel + to_string(i) + ".csv", data, data_size, clusterAssignment);
+                save_to_CSV(output_parallel + to_string(i) + ".csv", data, clusterAssignment);
             }
 
             parallel_time = total_parallel_time / 10.0;
@@ -370,11 +327,7 @@ double euclideanDistance(double* a, double* b) {
             save_speedup_results(data_size, threads, serial_time, parallel_time);
         }
 
-        // Clean up dynamically allocated memory
-        for (long long int i = 0; i < data_size; i++) {
-            delete[] data[i];
-        }
-        delete[] data;
+        // Clean up dynamically allocated memory (data is released by input_data)
         delete[] clusterAssignment;
     }
 
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "kmeans/streaming.h"
+
+using namespace std;
+
+/*
+    Out-of-core k-means: the data set is streamed from a binary file on every iteration, so it
+    can be larger than the memory. Writes one cluster id per line (in file order) and reports
+    the block size, the resident memory and the read throughput.
+
+    Usage: kmeans_streaming <data.bin> <num_clusters> <max_iterations> <seed> [budget_MB] [packed]
+                            [output_labels]
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <data.bin> <num_clusters> <max_iterations> <seed> [budget_MB] [packed]"
+             << " [output_labels]\n";
+        return 1;
+    }
+    const string input_file = argv[1];
+    const int k = atoi(argv[2]);
+    const int max_iterations = atoi(argv[3]);
+    const int seed = atoi(argv[4]);
+
+    StreamingOptions options;
+    if (argc > 5) options.memoryBudget = (size_t)(atof(argv[5]) * (1 << 20));
+    options.compressLabels = argc > 6 && string(argv[6]) == "packed";
+    const string output_file = argc > 7 ? argv[7] : "output/results_streaming.csv";
+
+    BlockStream header;
+    if (!header.open(input_file)) return 1;
+    vector<double> centroids((size_t)k * header.dims());
+    header.close();
+
+    srand(seed);
+    LabelStore labels;
+    StreamingStats stats;
+    if (!kmeans_streaming(input_file, k, max_iterations, centroids.data(), labels, options, &stats)) return 1;
+
+    cout << "Bloques de " << stats.blockPoints << " puntos (" << stats.numBlocks << " bloques), memoria residente "
+         << stats.residentBytes / 1e6 << " MB, etiquetas de " << labels.bits() << " bits\n";
+    cout << stats.iterations << " iteraciones en " << stats.totalSeconds << " s; lectura " << stats.bytesRead / 1e6
+         << " MB a " << stats.readMegabytesPerSecond() << " MB/s (efectivo " << stats.effectiveMegabytesPerSecond()
+         << " MB/s), espera " << stats.waitSeconds << " s\n";
+
+    // Labels are written in blocks, never unpacked all at once
+    ofstream out(output_file);
+    if (!out.is_open()) {
+        cerr << "Couldn't write to file: " << output_file << "\n";
+        return 1;
+    }
+    vector<int> block(1 << 16);
+    for (long long int begin = 0; begin < labels.size(); begin += (long long int)block.size()) {
+        long long int count = begin + (long long int)block.size() < labels.size() ? block.size() : labels.size() - begin;
+        labels.unpack(begin, count, block.data());
+        for (long long int i = 0; i < count; i++) out << block[i] << "\n";
+    }
+    return 0;
+}
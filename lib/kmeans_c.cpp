@@ -0,0 +1,112 @@
+#include <new>
+
+#include "../kmeans/engine.h"
+#include "../kmeans/kmeans_c.h"
+
+/*
+    C ABI of the KMeans engine (see kmeans/kmeans_c.h). One engine per coordinate type, created
+    on the first fit of that type, so a caller that only uses doubles never allocates the float
+    workspace. No exception crosses the ABI.
+*/
+
+struct kmeans_engine {
+    KMeansOptions options;
+    std::unique_ptr<KMeans> doubleEngine;
+    std::unique_ptr<FloatKMeans> floatEngine;
+};
+
+template <typename T>
+static bool make_view(const T* values, long long num_points, int dims, long long point_stride, long long dim_stride,
+                      BasicDatasetView<T>& view) {
+    if (values == nullptr || num_points <= 0 || dims <= 0 || point_stride < 0 || dim_stride < 0) return false;
+    view.values = values;
+    view.numPoints = num_points;
+    view.dims = dims;
+    view.pointStride = point_stride;
+    view.dimStride = dim_stride;
+    view.layout = point_stride == 1 ? LAYOUT_SOA : LAYOUT_AOS;
+    return true;
+}
+
+static void copy_result(const KMeansResult& from, kmeans_result* to) {
+    if (to == nullptr) return;
+    to->centroids = from.centroids;
+    to->labels = from.labels;
+    to->num_points = from.numPoints;
+    to->k = from.k;
+    to->dims = from.dims;
+    to->inertia = from.inertia;
+    to->iterations = from.iterations;
+    to->converged = from.converged ? 1 : 0;
+    to->init_seconds = from.initSeconds;
+    to->iterate_seconds = from.iterateSeconds;
+    to->allocations = from.allocations;
+}
+
+template <typename T>
+static int fit(kmeans_engine* engine, std::unique_ptr<BasicKMeans<T>>& typed, const T* values, long long num_points,
+               int dims, long long point_stride, long long dim_stride, int* labels, kmeans_result* result) {
+    BasicDatasetView<T> view;
+    if (engine == nullptr || !make_view(values, num_points, dims, point_stride, dim_stride, view)) {
+        return KMEANS_INVALID_ARGUMENT;
+    }
+    try {
+        if (typed == nullptr) typed.reset(new BasicKMeans<T>(engine->options));
+        if (!typed->fit(view, labels)) return KMEANS_INVALID_ARGUMENT;
+    } catch (const std::bad_alloc&) {
+        return KMEANS_OUT_OF_MEMORY;
+    }
+    copy_result(typed->result(), result);
+    return KMEANS_OK;
+}
+
+template <typename T>
+static int predict(std::unique_ptr<BasicKMeans<T>>& typed, const T* values, long long num_points, int dims,
+                   long long point_stride, long long dim_stride, int* labels) {
+    BasicDatasetView<T> view;
+    if (typed == nullptr || labels == nullptr || !make_view(values, num_points, dims, point_stride, dim_stride, view)) {
+        return KMEANS_INVALID_ARGUMENT;
+    }
+    return typed->predict(view, labels) ? KMEANS_OK : KMEANS_INVALID_ARGUMENT;
+}
+
+extern "C" {
+
+kmeans_engine* kmeans_create(int k, int max_iterations, int init, uint64_t seed) {
+    if (k <= 0 || max_iterations <= 0 || init < KMEANS_INIT_RANDOM || init > KMEANS_INIT_PARALLEL) return nullptr;
+    kmeans_engine* engine = new (std::nothrow) kmeans_engine();
+    if (engine == nullptr) return nullptr;
+    engine->options.k = k;
+    engine->options.maxIterations = max_iterations;
+    engine->options.init = (InitMethod)init;
+    engine->options.seed = seed;
+    return engine;
+}
+
+void kmeans_destroy(kmeans_engine* engine) { delete engine; }
+
+int kmeans_fit(kmeans_engine* engine, const double* values, long long num_points, int dims, long long point_stride,
+               long long dim_stride, int* labels, kmeans_result* result) {
+    if (engine == nullptr) return KMEANS_INVALID_ARGUMENT;
+    return fit(engine, engine->doubleEngine, values, num_points, dims, point_stride, dim_stride, labels, result);
+}
+
+int kmeans_fit_f32(kmeans_engine* engine, const float* values, long long num_points, int dims,
+                   long long point_stride, long long dim_stride, int* labels, kmeans_result* result) {
+    if (engine == nullptr) return KMEANS_INVALID_ARGUMENT;
+    return fit(engine, engine->floatEngine, values, num_points, dims, point_stride, dim_stride, labels, result);
+}
+
+int kmeans_predict(kmeans_engine* engine, const double* values, long long num_points, int dims,
+                   long long point_stride, long long dim_stride, int* labels) {
+    if (engine == nullptr) return KMEANS_INVALID_ARGUMENT;
+    return predict(engine->doubleEngine, values, num_points, dims, point_stride, dim_stride, labels);
+}
+
+int kmeans_predict_f32(kmeans_engine* engine, const float* values, long long num_points, int dims,
+                       long long point_stride, long long dim_stride, int* labels) {
+    if (engine == nullptr) return KMEANS_INVALID_ARGUMENT;
+    return predict(engine->floatEngine, values, num_points, dims, point_stride, dim_stride, labels);
+}
+
+}
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/csv.h"
+#include "../kmeans/binary.h"
+
+using namespace std;
+
+/*
+    CSV to binary converter
+
+    Converts a data/N_data.csv file into the binary columnar format of kmeans/binary.h.
+    The drivers pick up data/N_data.bin automatically when it sits next to the CSV.
+
+    Usage: csv_to_binary <input.csv> <output.bin> [num_points]
+*/
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <input.csv> <output.bin> [num_points]\n";
+        return 1;
+    }
+    const string input = argv[1];
+    const string output = argv[2];
+
+    long long int numPoints = argc > 3 ? atoll(argv[3]) : CSV_rows(input);
+    int dims = CSV_dimensions(input);
+    if (numPoints <= 0 || dims == 0) return 1;
+
+    Dataset data(numPoints, dims, LAYOUT_SOA);
+    CSVLoadStats stats;
+    if (!load_CSV(input, data, &stats)) return 1;
+    cout << "Lectura de " << input << ": " << stats.rows << " puntos de " << dims << " dimensiones, "
+         << stats.megabytesPerSecond() << " MB/s\n";
+
+    // num_points may be more than the file holds: only the rows read are written
+    DatasetView rows = data.view();
+    rows.numPoints = stats.rows;
+
+    double start = omp_get_wtime();
+    if (!save_binary(output, rows)) return 1;
+    cout << "Escritura de " << output << ": " << omp_get_wtime() - start << " s\n";
+
+    // Verify the file maps back to the same values
+    BinaryDataset check;
+    if (!check.open(output)) return 1;
+    if (check.view().numPoints != rows.numPoints) {
+        cerr << "Wrong number of points in file: " << output << "\n";
+        return 1;
+    }
+    for (long long int i = 0; i < rows.numPoints; i++) {
+        for (int d = 0; d < dims; d++) {
+            if (check.view().at(i, d) != rows.at(i, d)) {
+                cerr << "Mismatch at point " << i << " in file: " << output << "\n";
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
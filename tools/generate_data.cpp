@@ -0,0 +1,252 @@
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "../kmeans/dataset.h"
+#include "../kmeans/binary.h"
+#include "../kmeans/synthetic.h"
+
+using namespace std;
+
+/*
+    Synthetic data set generator
+
+    Gaussian blob mixtures (kmeans/synthetic.h), the C++ replacement of
+    synthetic_clusters.ipynb for data sets too large for Python. k centers are drawn uniformly
+    in [0, box)^dims and every point either belongs to a blob (coordinates center + spread *
+    N(0, 1)) or, with probability noise, is uniform noise over the box widened by 3 * spread
+    (label -1). Blob sizes follow a geometric progression whose largest / smallest ratio is
+    imbalance (1 = equal sizes).
+
+    Every value is a pure function of (seed, point, dimension) through the counter-based
+    generator of kmeans/random.h, so the output doesn't depend on the number of threads and
+    nothing has to be kept in memory: the points are produced in parallel chunk by chunk and
+    written in order (row by row for CSV, column by column for the binary format).
+
+    Files, for output base B (default data/N_data, what the drivers read):
+        B.csv / B.bin      the points (CSV with decimals fixed digits, 0 to 17, or the shortest
+                           exact form with -1; or kmeans/binary.h format)
+        B_labels.csv/.bin  ground truth blob of every point, one per line / raw 32-bit integers
+        B_centers.csv      the k centers, one per line
+
+    Usage: generate_data <num_points> <dims> <num_clusters> [--spread s] [--imbalance r]
+                         [--noise f] [--box b] [--seed n] [--format csv|bin] [--decimals n]
+                         [--output B]
+*/
+
+// Points generated per chunk; each thread produces whole chunks
+const long long int GENERATOR_CHUNK = 1 << 15;
+
+// Fixed digits of the CSV values (-1: shortest form that reads back exactly)
+const int GENERATOR_MAX_DECIMALS = 17;
+
+// Longest shortest-form double ("-2.2250738585072014e-308")
+const int GENERATOR_SHORTEST_CHARS = 24;
+
+/*
+    Produces the chunks of [0, numPoints) in parallel, one per thread per round, and hands every
+    formatted buffer to write in chunk order. format(begin, end, out) fills out for its chunk.
+*/
+template <typename Format, typename Write>
+static void generate_in_order(long long int numPoints, Format format, Write write) {
+    const long long int numChunks = (numPoints + GENERATOR_CHUNK - 1) / GENERATOR_CHUNK;
+    const long long int perRound = omp_get_max_threads();
+    vector<vector<char>> buffers(perRound);
+    for (long long int first = 0; first < numChunks; first += perRound) {
+        const long long int count = first + perRound < numChunks ? perRound : numChunks - first;
+        #pragma omp parallel for schedule(static, 1)
+        for (long long int c = 0; c < count; c++) {
+            long long int begin = (first + c) * GENERATOR_CHUNK;
+            long long int end = begin + GENERATOR_CHUNK < numPoints ? begin + GENERATOR_CHUNK : numPoints;
+            format(begin, end, buffers[c]);
+        }
+        for (long long int c = 0; c < count; c++) write(buffers[c]);
+    }
+}
+
+/*
+    Characters of the longest CSV value plus its separator. Blob coordinates are at most
+    9 * spread away from a center in [0, box) (the Box-Muller radius of a 53-bit uniform is
+    below 8.6) and noise stays within 3 * spread of the box.
+*/
+static size_t csv_value_chars(const BlobMixture& mix, int decimals) {
+    if (decimals < 0) return GENERATOR_SHORTEST_CHARS + 1;
+    const double bound = fabs(mix.box) + 9.0 * fabs(mix.spread);
+    const int integerDigits = bound < 10.0 ? 1 : (int)floor(log10(bound)) + 1;
+    // Sign, integer digits, point, decimals and separator
+    return 1 + (size_t)integerDigits + 1 + (size_t)decimals + 1;
+}
+
+static bool write_csv(const BlobMixture& mix, const string& file_name, int decimals) {
+    ofstream out(file_name, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    const size_t valueChars = csv_value_chars(mix, decimals);
+    atomic<bool> overflow(false);
+    generate_in_order(
+        mix.numPoints,
+        [&](long long int begin, long long int end, vector<char>& buffer) {
+            buffer.resize((size_t)(end - begin) * mix.dims * valueChars);
+            char* p = buffer.data();
+            char* last = buffer.data() + buffer.size();
+            for (long long int i = begin; i < end; i++) {
+                int blob = mix.label(i);
+                for (int d = 0; d < mix.dims; d++) {
+                    double value = mix.coordinate(i, d, blob);
+                    to_chars_result r = decimals >= 0 ? to_chars(p, last, value, chars_format::fixed, decimals)
+                                                      : to_chars(p, last, value);
+                    if (r.ec != errc() || r.ptr == last) {
+                        // Doesn't happen within the bound above; nothing of the chunk is written
+                        overflow = true;
+                        buffer.clear();
+                        return;
+                    }
+                    p = r.ptr;
+                    *p++ = d + 1 < mix.dims ? ',' : '\n';
+                }
+            }
+            buffer.resize(p - buffer.data());
+        },
+        [&](const vector<char>& buffer) { out.write(buffer.data(), buffer.size()); });
+    out.close();
+    if (overflow) {
+        cerr << "Couldn't format the points of " << file_name << "\n";
+        return false;
+    }
+    if (!out) {
+        cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool write_binary(const BlobMixture& mix, const string& file_name) {
+    ofstream out(file_name, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    const BinaryHeader header = write_binary_header(out, mix.numPoints, mix.dims);
+    for (int d = 0; d < mix.dims; d++) {
+        generate_in_order(
+            mix.numPoints,
+            [&](long long int begin, long long int end, vector<char>& buffer) {
+                buffer.resize(sizeof(double) * (end - begin));
+                double* values = reinterpret_cast<double*>(buffer.data());
+                for (long long int i = begin; i < end; i++) values[i - begin] = mix.coordinate(i, d, mix.label(i));
+            },
+            [&](const vector<char>& buffer) { out.write(buffer.data(), buffer.size()); });
+        vector<double> tail(header.columnStride - mix.numPoints, 0.0);
+        out.write((const char*)tail.data(), sizeof(double) * tail.size());
+    }
+    out.close();
+    if (!out) {
+        cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool write_labels(const BlobMixture& mix, const string& file_name, bool binary) {
+    ofstream out(file_name, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    generate_in_order(
+        mix.numPoints,
+        [&](long long int begin, long long int end, vector<char>& buffer) {
+            if (binary) {
+                buffer.resize(sizeof(int32_t) * (end - begin));
+                int32_t* labels = reinterpret_cast<int32_t*>(buffer.data());
+                for (long long int i = begin; i < end; i++) labels[i - begin] = mix.label(i);
+                return;
+            }
+            buffer.resize((end - begin) * 12);
+            char* p = buffer.data();
+            for (long long int i = begin; i < end; i++) {
+                p = to_chars(p, buffer.data() + buffer.size(), mix.label(i)).ptr;
+                *p++ = '\n';
+            }
+            buffer.resize(p - buffer.data());
+        },
+        [&](const vector<char>& buffer) { out.write(buffer.data(), buffer.size()); });
+    out.close();
+    if (!out) {
+        cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool write_centers(const BlobMixture& mix, const string& file_name) {
+    ofstream out(file_name);
+    if (!out.is_open()) {
+        cerr << "Couldn't write to file: " << file_name << "\n";
+        return false;
+    }
+    out.precision(17);
+    for (int j = 0; j < mix.k; j++) {
+        for (int d = 0; d < mix.dims; d++) out << mix.centers[(size_t)j * mix.dims + d] << (d + 1 < mix.dims ? "," : "\n");
+    }
+    return (bool)out;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <num_points> <dims> <num_clusters> [--spread s] [--imbalance r] [--noise f]"
+             << " [--box b] [--seed n] [--format csv|bin] [--decimals n] [--output base]\n";
+        return 1;
+    }
+    BlobMixture mix;
+    mix.numPoints = atoll(argv[1]);
+    mix.dims = atoi(argv[2]);
+    mix.k = atoi(argv[3]);
+    string format = "csv";
+    int decimals = 3;
+    string output = "data/" + to_string(mix.numPoints) + "_data";
+
+    for (int a = 4; a + 1 < argc; a += 2) {
+        const string option = argv[a];
+        const char* value = argv[a + 1];
+        if (option == "--spread") mix.spread = atof(value);
+        else if (option == "--imbalance") mix.imbalance = atof(value);
+        else if (option == "--noise") mix.noise = atof(value);
+        else if (option == "--box") mix.box = atof(value);
+        else if (option == "--seed") mix.seed = strtoull(value, nullptr, 10);
+        else if (option == "--format") format = value;
+        else if (option == "--decimals") decimals = atoi(value);
+        else if (option == "--output") output = value;
+        else {
+            cerr << "Unknown option: " << option << "\n";
+            return 1;
+        }
+    }
+    if (mix.numPoints <= 0 || mix.dims <= 0 || mix.k <= 0 || mix.imbalance < 1.0 || (format != "csv" && format != "bin") ||
+        decimals < -1 || decimals > GENERATOR_MAX_DECIMALS) {
+        cerr << "Invalid parameters\n";
+        return 1;
+    }
+    mix.setup();
+
+    const bool binary = format == "bin";
+    double start = omp_get_wtime();
+    if (binary ? !write_binary(mix, output + ".bin") : !write_csv(mix, output + ".csv", decimals)) return 1;
+    double pointsTime = omp_get_wtime() - start;
+    if (!write_labels(mix, output + (binary ? "_labels.bin" : "_labels.csv"), binary)) return 1;
+    if (!write_centers(mix, output + "_centers.csv")) return 1;
+
+    cout << "Generados " << mix.numPoints << " puntos de " << mix.dims << " dimensiones en " << mix.k << " clusters ("
+         << output << (binary ? ".bin" : ".csv") << "): " << pointsTime << " s, "
+         << mix.numPoints / pointsTime / 1e6 << " millones de puntos/s con " << omp_get_max_threads() << " threads\n";
+    return 0;
+}